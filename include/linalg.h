@@ -5,6 +5,18 @@
 #define LINALG_H
 
 #include "linalg_error.h"
+#include "linalg_expr.h"
+#include "linalg_fixed.h"
+#include "linalg_matrix.h"
+#include "linalg_memory.h"
+#include "linalg_numa.h"
+#include "linalg_parallel.h"
+#include "linalg_random.h"
+#include "linalg_stream.h"
+#include "linalg_task.h"
+#include "linalg_tile.h"
+#include "linalg_trace.h"
+#include "linalg_tune.h"
 #include "linalg_vector.h"
 
 #endif
\ No newline at end of file
@@ -4,15 +4,37 @@
 #ifndef LINALG_BASE_H
 #define LINALG_BASE_H
 
+#include <stdatomic.h>  // atomic_int
 #include <stdbool.h>  // bool
 #include <stddef.h>   // size_t
 #include <stdlib.h>   // malloc
 
-/** Reference counted container object. */
+/** Storage class of the small functions defined in `linalg_*_inline.h`.
+ *
+ *  By default they are compiled into the library like every other function.
+ *  Defining `LINALG_HEADER_ONLY` before including the linalg headers makes
+ *  them `static inline` in the including translation unit, so calls in hot
+ *  loops can be inlined and vectorized with the caller. Only define it in
+ *  code using the library, never when building the library itself.
+ */
+#ifndef LINALG_INLINE
+#ifdef LINALG_HEADER_ONLY
+#define LINALG_INLINE static inline
+#else
+#define LINALG_INLINE
+#endif
+#endif
+
+/** Reference counted container object.
+ *
+ *  `ref_count` is atomic so views of a shared object may be created and freed
+ *  from several threads at once.
+ */
 typedef struct linalg_t {
   bool owns_memory;
+  bool copy_on_write;
   struct linalg_t* memory_owner;
-  int ref_count;
+  atomic_int ref_count;
   double* data;
 } linalg_t;
 
@@ -20,6 +42,10 @@ typedef struct linalg_t {
 #define OWNS_MEMORY(obj) (((linalg_t*)obj)->owns_memory)
 #endif
 
+#ifndef COPY_ON_WRITE
+#define COPY_ON_WRITE(obj) (((linalg_t*)obj)->copy_on_write)
+#endif
+
 #ifndef MEMORY_OWNER
 #define MEMORY_OWNER(obj) (((linalg_t*)obj)->memory_owner)
 #endif
@@ -28,8 +54,44 @@ typedef struct linalg_t {
 #define REF_COUNT(obj) (((linalg_t*)obj)->ref_count)
 #endif
 
+#ifndef REF_COUNT_INIT
+#define REF_COUNT_INIT(obj) (atomic_init(&REF_COUNT(obj), 0))
+#endif
+
+/** Taking a reference only needs atomicity, not ordering. */
+#ifndef REF_COUNT_INCREMENT
+#define REF_COUNT_INCREMENT(obj) \
+  (atomic_fetch_add_explicit(&REF_COUNT(obj), 1, memory_order_relaxed))
+#endif
+
+/** Releasing a reference publishes the view's accesses to the owner's free. */
+#ifndef REF_COUNT_DECREMENT
+#define REF_COUNT_DECREMENT(obj) \
+  (atomic_fetch_sub_explicit(&REF_COUNT(obj), 1, memory_order_acq_rel))
+#endif
+
+#ifndef REF_COUNT_LOAD
+#define REF_COUNT_LOAD(obj) \
+  (atomic_load_explicit(&REF_COUNT(obj), memory_order_acquire))
+#endif
+
 #ifndef DATA
 #define DATA(obj) (((linalg_t*)obj)->data)
 #endif
 
+/** Enables or disables copy-on-write copies library-wide.
+ *
+ *  While enabled, a copy and its source both become holders of one
+ *  reference counted buffer, which the last holder to be freed releases, so
+ *  either may be freed first. Whichever holder is written to first, through
+ *  a `*_into` call, `VECTOR_IDX_INTO`, `MATRIX_IDX_INTO`, a setter or a
+ *  view, first gets a private buffer (or keeps the shared one if it is the
+ *  last holder); `*_materialize` does so explicitly. Only raw writes through
+ *  `DATA` bypass this. Sources that views point into are copied eagerly.
+ *  Disabled by default.
+ */
+void linalg_set_copy_on_write(bool enabled);
+/** Returns true if copy-on-write copies are enabled. */
+bool linalg_copy_on_write(void);
+
 #endif
\ No newline at end of file
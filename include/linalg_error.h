@@ -17,21 +17,13 @@ typedef enum {
   LINALG_ALLOCATION_ERROR,
   /** Reference count error. */
   LINALG_NONZERO_REFERENCE_ERROR,
+  /** Operation is not supported on a view. */
+  LINALG_VIEW_ERROR,
+  /** Operation is not supported for the matrix storage order. */
+  LINALG_LAYOUT_ERROR,
 } linalg_error_t;
 
 /** Prints an error code's message then exits. */
-void raise_error(linalg_error_t error) {
-  switch (error) {
-  LINALG_SUCCESS:
-    exit(EXIT_SUCCESS);
-  LINALG_UNKNOWN_ERROR:
-    printf("encountered unknown error");
-  LINALG_ALLOCATION_ERROR:
-    printf("memory allocation error");
-  LINALG_NONZERO_REFERENCE_ERROR:
-    printf("cannot free memory with non-zero reference count");
-  }
-  exit(EXIT_FAILURE);
-}
+void raise_error(linalg_error_t error);
 
 #endif
\ No newline at end of file
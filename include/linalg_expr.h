@@ -0,0 +1,65 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_EXPR_H
+#define LINALG_EXPR_H
+
+#include "linalg_matrix.h"
+#include "linalg_vector.h"
+
+/** Number of elements a fused kernel computes per step, sized so that
+ *  every intermediate of a step stays in L1. */
+#ifndef EXPR_CHUNK
+#define EXPR_CHUNK 256
+#endif
+
+/** Length from which fused kernels are split across threads. */
+#ifndef EXPR_PARALLEL_THRESHOLD
+#define EXPR_PARALLEL_THRESHOLD (1 << 15)
+#endif
+
+/** A node of a deferred vector expression. */
+typedef struct expr_t expr_t;
+/** Owner of the nodes of one or more expressions. */
+typedef struct expr_graph_t expr_graph_t;
+
+/** Returns a new, empty expression graph. */
+expr_graph_t* expr_graph_new(void);
+/** Frees a graph, its nodes and its pooled temporaries. Leaf vectors and
+ *  matrices are not freed. */
+void expr_graph_free(expr_graph_t* g);
+
+/** Returns a leaf referring to `v`, read when the expression is
+ *  evaluated. */
+expr_t* expr_vector(expr_graph_t* g, vector_t* v);
+/** Returns the element-wise sum `a + b`. */
+expr_t* expr_add(expr_graph_t* g, expr_t* a, expr_t* b);
+/** Returns the element-wise difference `a - b`. */
+expr_t* expr_sub(expr_graph_t* g, expr_t* a, expr_t* b);
+/** Returns the element-wise product of `a` and `b`. */
+expr_t* expr_mul(expr_graph_t* g, expr_t* a, expr_t* b);
+/** Returns `a` scaled by `s`. */
+expr_t* expr_scale(expr_graph_t* g, expr_t* a, double s);
+/** Returns `fn` applied to every element of `a`. */
+expr_t* expr_map(expr_graph_t* g, expr_t* a, double (*fn)(double));
+/** Returns `a` divided by its L2 norm. */
+expr_t* expr_normalize(expr_graph_t* g, expr_t* a);
+/** Returns the product of matrix `m` and the vector expression `a`. */
+expr_t* expr_matrix_vector_mul(expr_graph_t* g, matrix_t* m, expr_t* a);
+
+/** Evaluates `e` into `dst`.
+ *
+ *  Maximal chains of element-wise nodes are fused into single-pass kernels
+ *  that stream their inputs once and keep intermediates in per-chunk
+ *  scratch buffers. Only the inputs of `expr_normalize` and
+ *  `expr_matrix_vector_mul`, which need a whole vector, are materialized.
+ *  Those temporaries are returned to a pool in the graph once consumed and
+ *  reused by later temporaries and later evaluations. `normalize(a + b*s -
+ *  c)` thus takes one fused pass into `dst`, one norm pass and one scaling
+ *  pass, without any temporary vector. `dst` may be a leaf of `e`.
+ */
+void expr_eval_into(expr_graph_t* g, expr_t* e, vector_t* dst);
+/** Evaluates `e` into a new vector. */
+vector_t* expr_eval(expr_graph_t* g, expr_t* e);
+
+#endif
@@ -0,0 +1,57 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_FIXED_H
+#define LINALG_FIXED_H
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+
+/* Fully unrolled kernels for N x N matrices with N from 2 to 8.
+ *
+ * Operands are packed row-major arrays of N * N doubles. The generic
+ * `matrix_mul_into`, `matrix_vector_mul` and `matrix_transpose` dispatch to
+ * these automatically for packed square operands of a matching size. */
+
+/** Smallest size with a fixed-size kernel. */
+#define MATRIX_FIXED_MIN 2
+/** Largest size with a fixed-size kernel. */
+#define MATRIX_FIXED_MAX 8
+
+#ifndef _FIXED_MACROS
+#define _FIXED_MACROS
+/** Declares the fixed-size kernels for one size `N`. */
+#define MATRIX_FIXED_DECLARE(N)                                             \
+  /** Writes the product of `a` and `b` into `c`, which must not alias. */  \
+  void matrix_mul_##N##x##N(double* c, const double* a, const double* b);   \
+  /** Writes the product of `a` and vector `x` into `y`. */                 \
+  void matrix_vector_mul_##N##x##N(double* y, const double* a,              \
+                                   const double* x);                        \
+  /** Transposes `a` in place. */                                           \
+  void matrix_transpose_##N##x##N(double* a);                               \
+  /** Returns the determinant of `a`. */                                    \
+  double matrix_determinant_##N##x##N(const double* a);                     \
+  /** Writes the inverse of `a` into `inv`, returning false if singular. */ \
+  bool matrix_inverse_##N##x##N(double* inv, const double* a);
+#endif
+
+MATRIX_FIXED_DECLARE(2)
+MATRIX_FIXED_DECLARE(3)
+MATRIX_FIXED_DECLARE(4)
+MATRIX_FIXED_DECLARE(5)
+MATRIX_FIXED_DECLARE(6)
+MATRIX_FIXED_DECLARE(7)
+MATRIX_FIXED_DECLARE(8)
+
+/** Fixed-size product kernel for size `n`, or NULL if there is none. */
+typedef void (*matrix_fixed_mul_t)(double*, const double*, const double*);
+matrix_fixed_mul_t matrix_fixed_mul(size_t n);
+/** Fixed-size matrix-vector kernel for size `n`, or NULL if there is none. */
+typedef void (*matrix_fixed_vector_mul_t)(double*, const double*,
+                                          const double*);
+matrix_fixed_vector_mul_t matrix_fixed_vector_mul(size_t n);
+/** Fixed-size transpose kernel for size `n`, or NULL if there is none. */
+typedef void (*matrix_fixed_transpose_t)(double*);
+matrix_fixed_transpose_t matrix_fixed_transpose(size_t n);
+
+#endif
@@ -6,30 +6,158 @@
 
 #ifndef _MATRIX_MACROS
 #define _MATRIX_MACROS
-#define MATRIX_ROW(m, i) ((i) / (m->nrows))
-#define MATRIX_COL(m, i) ((i) % (m->nrows))
-#define MATRIX_IDX(m, i, j) (((i) * (m->ncols)) + (j))
-#define MATRIX_IDX_INTO(m, i, j) (DATA(m)[MATRIX_IDX(m, i, j)])
+#define MATRIX_ROW(m, i) \
+  ((m)->order == MATRIX_COL_MAJOR ? (i) % (m)->ld : (i) / (m)->ld)
+#define MATRIX_COL(m, i) \
+  ((m)->order == MATRIX_COL_MAJOR ? (i) / (m)->ld : (i) % (m)->ld)
+/** Offset of element (i, j) of `m`. This checks the order on every use, so
+ *  loops resolve it once with `MATRIX_ROW_STRIDE` and `MATRIX_COL_STRIDE`,
+ *  or use `MATRIX_IDX_ROW` where `m` is known to be row-major. */
+#define MATRIX_IDX(m, i, j)                                \
+  ((m)->order == MATRIX_COL_MAJOR ? (j) * (m)->ld + (i) \
+                                  : (i) * (m)->ld + (j))
+/** Offset of element (i, j) of the row-major `m`. */
+#define MATRIX_IDX_ROW(m, i, j) ((i) * (m)->ld + (j))
+/** Distance between consecutive rows of `m`. */
+#define MATRIX_ROW_STRIDE(m) ((m)->order == MATRIX_COL_MAJOR ? 1 : (m)->ld)
+/** Distance between consecutive columns of `m`. */
+#define MATRIX_COL_STRIDE(m) ((m)->order == MATRIX_COL_MAJOR ? (m)->ld : 1)
+/** Element (i, j) of `m` as an lvalue, giving a copy-on-write matrix its
+ *  own data first. */
+#define MATRIX_IDX_INTO(m, i, j) \
+  ((COPY_ON_WRITE(m) ? matrix_data_into(m) : DATA(m))[MATRIX_IDX(m, i, j)])
+/** Value of element (i, j) of `m`. Reading never detaches a shared copy. */
+#define MATRIX_AT(m, i, j) ((double)DATA(m)[MATRIX_IDX(m, i, j)])
+#endif
+
+/** Row widths (in doubles) that are a multiple of this stride get padded. */
+#ifndef MATRIX_PAD_STRIDE
+#define MATRIX_PAD_STRIDE 64
+#endif
+
+/** Number of doubles added to a padded row, one cache line. */
+#ifndef MATRIX_PAD_LENGTH
+#define MATRIX_PAD_LENGTH 8
+#endif
+
+/** Default dimension at or below which Strassen recursion stops. */
+#ifndef MATRIX_STRASSEN_CROSSOVER
+#define MATRIX_STRASSEN_CROSSOVER 512
+#endif
+
+/** Default tile size of `matrix_cholesky`. */
+#ifndef MATRIX_CHOLESKY_TILE
+#define MATRIX_CHOLESKY_TILE 128
+#endif
+
+/** Tile size of the symmetric rank-k updates. */
+#ifndef MATRIX_RANK_TILE
+#define MATRIX_RANK_TILE 64
+#endif
+
+/** Number of multiply-adds from which rank updates use the worker pool. */
+#ifndef MATRIX_RANK_THRESHOLD
+#define MATRIX_RANK_THRESHOLD (1 << 18)
+#endif
+
+/** Block size of the triangular solves. */
+#ifndef MATRIX_TRSM_BLOCK
+#define MATRIX_TRSM_BLOCK 64
+#endif
+
+/** Number of multiply-adds from which triangular solves use the pool. */
+#ifndef MATRIX_TRSM_THRESHOLD
+#define MATRIX_TRSM_THRESHOLD (1 << 18)
 #endif
 
 #include "linalg_base.h"
 #include "linalg_vector.h"
 
+/** Triangle of a symmetric matrix that an operation references. */
+typedef enum {
+  MATRIX_LOWER,
+  MATRIX_UPPER,
+} matrix_uplo_t;
+
+/** Whether an operand is used as is or transposed. */
+typedef enum {
+  MATRIX_NO_TRANS,
+  MATRIX_TRANS,
+} matrix_trans_t;
+
+/** Side of the unknown on which a triangular matrix is applied. */
+typedef enum {
+  MATRIX_LEFT,
+  MATRIX_RIGHT,
+} matrix_side_t;
+
+/** Whether a triangular matrix has an implicit unit diagonal. */
+typedef enum {
+  MATRIX_NON_UNIT,
+  MATRIX_UNIT,
+} matrix_diag_t;
+
+/** Storage order of a matrix. */
+typedef enum {
+  /** Rows are contiguous. */
+  MATRIX_ROW_MAJOR,
+  /** Columns are contiguous, as in Fortran. */
+  MATRIX_COL_MAJOR,
+} matrix_order_t;
+
+/** Dense matrix.
+ *
+ *  Element (i, j) lives at `data[i * ld + j]` in a row-major matrix and at
+ *  `data[j * ld + i]` in a column-major one. The leading dimension `ld` is
+ *  at least the length of a contiguous row (column); it is larger for
+ *  padded allocations and for block views into a wider parent.
+ */
 typedef struct {
   linalg_t obj;
   size_t nrows;
   size_t ncols;
+  size_t ld;
+  matrix_order_t order;
 } matrix_t;
 
+/** Returns the leading dimension `matrix_new` uses for `ncols` columns.
+ *
+ *  Rows whose width is a multiple of `MATRIX_PAD_STRIDE` doubles map onto the
+ *  same cache sets, so they are padded by `MATRIX_PAD_LENGTH` doubles.
+ */
+size_t matrix_leading_dimension(size_t ncols);
+
 /** Returns a new matrix. */
 matrix_t* matrix_new(size_t nrows, size_t ncols);
+/** Returns a new matrix with an explicit leading dimension `ld >= ncols`. */
+matrix_t* matrix_new_padded(size_t nrows, size_t ncols, size_t ld);
 /** Returns a matrix initialized with the elements of a 1D array. */
 matrix_t* matrix_from_array(double* data, size_t nrows, size_t ncols);
 /** Returns a matrix initialized with the elements of a 2D array. */
 matrix_t* matrix_from_2d_array(double** data, size_t nrows, size_t ncols);
+/** Returns a new column-major matrix, padded like `matrix_new` with the
+ *  roles of rows and columns exchanged. */
+matrix_t* matrix_new_col_major(size_t nrows, size_t ncols);
+/** Returns a column-major matrix initialized with the elements of a
+ *  column-major 1D array, such as one produced by Fortran code. */
+matrix_t* matrix_from_col_major_array(double* data, size_t nrows,
+                                      size_t ncols);
+/** Returns a new matrix which is a view into a block of an existing matrix.
+ *
+ *  The view covers rows `i0` to `i0 + nrows` and columns `j0` to `j0 + ncols`
+ *  of `m` and shares its data. Mutating either one will mutate both.
+ */
+matrix_t* matrix_block_view(matrix_t* m, size_t i0, size_t j0, size_t nrows,
+                            size_t ncols);
 /** Frees the memory of a matrix. */
 void matrix_free(matrix_t* m);
 
+/** Returns element (i, j) of `m`. */
+LINALG_INLINE double matrix_get(matrix_t* m, size_t i, size_t j);
+/** Sets element (i, j) of `m` to `x`, giving a copy-on-write matrix its
+ *  own data first. */
+LINALG_INLINE void matrix_set(matrix_t* m, size_t i, size_t j, double x);
+
 /** Returns a matrix with all elements initialized to the same constant. */
 matrix_t* matrix_constant(size_t nrows, size_t ncols, double c);
 /** Returns a matrix with all elements initialized to 0. */
@@ -38,14 +166,51 @@ matrix_t* matrix_zeros(size_t nrows, size_t ncols);
 matrix_t* matrix_ones(size_t nrows, size_t ncols);
 /** Returns a square identity matrix. */
 matrix_t* matrix_identity(size_t n);
+/** Returns a matrix of independent uniform samples from [min, max).
+ *
+ *  Element (i, j) takes the value a vector from `vector_random_uniform`
+ *  with the same seed has at index `i * ncols + j`, whatever the padding.
+ */
+matrix_t* matrix_random_uniform(size_t nrows, size_t ncols, double min,
+                                double max, uint64_t seed);
+/** Returns a matrix of independent normal samples, laid out like
+ *  `matrix_random_uniform`. */
+matrix_t* matrix_random_normal(size_t nrows, size_t ncols, double mean,
+                               double stddev, uint64_t seed);
 
-/** Returns a copy of the matrix. */
+/** Returns a copy of the matrix.
+ *
+ *  With copy-on-write enabled the copy shares `m`'s data until it is first
+ *  mutated, see `linalg_set_copy_on_write`.
+ */
 matrix_t* matrix_copy(matrix_t* m);
-/** Returns a vector view into a matrix row. */
+/** Returns a copy of the matrix stored in `order`. */
+matrix_t* matrix_copy_order(matrix_t* m, matrix_order_t order);
+/** Copies matrix `m` into matrix `dst`.
+ *
+ *  The two may have different storage orders, in which case the copy is
+ *  done by tiles so that both sides are accessed in cache-sized blocks.
+ */
+void matrix_copy_into(matrix_t* dst, matrix_t* m);
+/** Gives a copy-on-write matrix its own private data. No-op otherwise. */
+void matrix_materialize(matrix_t* m);
+/** Materializes `m` and returns its data, for writing. The leading
+ *  dimension is unchanged. */
+double* matrix_data_into(matrix_t* m);
+/** Returns a vector view into a row of a row-major matrix.
+ *
+ *  Rows of a column-major matrix are not contiguous, so viewing one raises
+ *  `LINALG_LAYOUT_ERROR`.
+ */
 vector_t* matrix_row_view(matrix_t*, size_t row);
 /** Returns a vector copy of a matrix row. */
 vector_t* matrix_row_copy(matrix_t*, size_t row);
-/* No column view, columns are not contiguous memory. */
+/** Returns a vector view into a column of a column-major matrix.
+ *
+ *  Columns of a row-major matrix are not contiguous, so viewing one raises
+ *  `LINALG_LAYOUT_ERROR`.
+ */
+vector_t* matrix_col_view(matrix_t*, size_t col);
 /** Returns a vector copy of a matrix column. */
 vector_t* matrix_col_copy(matrix_t*, size_t col);
 
@@ -63,20 +228,139 @@ void matrix_copy_vector_into_col(matrix_t* m, vector_t* v, size_t col);
 /** Returns a vector copy of the matrix diagonal. */
 vector_t* matrix_diagonal(matrix_t* m);
 
-/** Transposes the matrix in place. */
+/** Transposes the matrix in place, keeping its storage order.
+ *
+ *  Square matrices are transposed within their own storage. Non-square
+ *  matrices are moved into a new buffer, which is an error for views and
+ *  for matrices that still have views into them.
+ */
 void matrix_transpose(matrix_t* m);
 
 /** Compute the matrix product of two aligned matrices.
  *
  *  Iteration order is chosen to be i-k-j to optimize memory access.
  *  In this order, the innermost loop is accessing contiguous memory.
+ *  Operands may have any storage order: a column-major `dst` is computed
+ *  as the row-major product `m2^T * m1^T`, and an operand stored the other
+ *  way round is read through the packing of the kernel, without
+ *  converting it. The result has `m1`'s storage order.
  */
 matrix_t* matrix_mul(matrix_t* m1, matrix_t* m2);
 /** Reads the result of the matrix product of two aligned matrices into `dst`.
  */
 matrix_t* matrix_mul_into(matrix_t* dst, matrix_t* m1, matrix_t* m2);
 
-/** Returns the product of an aligned matrix vector pair. */
+/** Reads the products `m1[i] * m2[i]` into `dst[i]` for every `i < count`.
+ *
+ *  Shapes may differ between entries. The products are handed out one at a
+ *  time to the worker pool, each thread reusing its own packing buffer, and
+ *  every `dst[i]` must be preallocated and distinct.
+ */
+void matrix_mul_batch_into(matrix_t** dst, matrix_t** m1, matrix_t** m2,
+                           size_t count);
+
+/** Reads the product of two aligned matrices into `dst` using the
+ *  Strassen-Winograd algorithm.
+ *
+ *  Each level of recursion replaces one block product by seven half-sized
+ *  products and fifteen additions. Recursion stops once any dimension is at
+ *  most `crossover` (0 selects `MATRIX_STRASSEN_CROSSOVER`), below which the
+ *  conventional kernel is used. Odd dimensions are handled by peeling the
+ *  last row, column or inner index and fixing them up with rank-1 and
+ *  matrix-vector updates. All temporaries come from one workspace allocated
+ *  per call.
+ *
+ *  The result is not as accurate as `matrix_mul_into`, whose error is
+ *  bounded elementwise by n u |A| |B|. Strassen-Winograd only satisfies a
+ *  normwise bound, for n x n operands
+ *  ||C - fl(C)|| <= [(n/n0)^log2(18) (n0^2 + 6 n0) - 6n] u ||A|| ||B||
+ *  + O(u^2), that is c n^log2(18) u ||A|| ||B||, with ||X|| = max |x_ij|,
+ *  n0 the crossover and u the unit roundoff (Higham, "Accuracy and
+ *  Stability of Numerical Algorithms", ch. 23). Small elements of C may
+ *  therefore carry large relative errors; raising the crossover tightens
+ *  the bound.
+ */
+matrix_t* matrix_mul_strassen_into(matrix_t* dst, matrix_t* m1, matrix_t* m2,
+                                   size_t crossover);
+
+/** Computes the Cholesky factorization of a symmetric positive definite
+ *  matrix in place.
+ *
+ *  On return `m` holds the lower triangular factor L with `m = L L^T`.
+ *  Returns false if `m` is not positive definite. Equivalent to
+ *  `matrix_cholesky_tiled` with `MATRIX_CHOLESKY_TILE`.
+ */
+bool matrix_cholesky(matrix_t* m);
+/** Computes the Cholesky factorization as a graph of tile tasks.
+ *
+ *  The matrix is split into `tile` x `tile` blocks and every tile kernel
+ *  (factor, triangular solve, symmetric and general update) becomes a task
+ *  whose dependencies are inferred from the tiles it touches. Run on the
+ *  work-stealing task runtime, the panel of step k+1 starts as soon as its
+ *  own inputs are updated rather than after the whole trailing update of
+ *  step k.
+ */
+bool matrix_cholesky_tiled(matrix_t* m, size_t tile);
+
+/** Adds the outer product `alpha * x * y^T` to `m` in place.
+ *
+ *  `x` must have `m->nrows` elements and `y` `m->ncols`.
+ */
+void matrix_ger(matrix_t* m, double alpha, vector_t* x, vector_t* y);
+/** Computes the symmetric rank-k update `c = alpha * a * a^T + beta * c`
+ *  (`MATRIX_NO_TRANS`) or `c = alpha * a^T * a + beta * c` (`MATRIX_TRANS`)
+ *  in place.
+ *
+ *  Only the `uplo` triangle of `c` is referenced and written, which halves
+ *  the work of `matrix_mul` and needs no explicit transpose of `a`. The
+ *  triangle is split into `MATRIX_RANK_TILE` tiles: off-diagonal tiles go
+ *  through the packed product kernel and diagonal tiles are computed on
+ *  their own triangle. Operands of either storage order are read in place.
+ *  With `mirror` set the result is also copied into the other triangle so
+ *  that `c` holds the full symmetric matrix. With `beta == 0` the initial
+ *  contents of `c` are ignored.
+ */
+void matrix_syrk(matrix_t* c, matrix_uplo_t uplo, matrix_trans_t trans,
+                 double alpha, matrix_t* a, double beta, bool mirror);
+/** Computes the symmetric rank-2k update
+ *  `c = alpha * (a * b^T + b * a^T) + beta * c` (`MATRIX_NO_TRANS`) or
+ *  `c = alpha * (a^T * b + b^T * a) + beta * c` (`MATRIX_TRANS`) in place.
+ *
+ *  `a` and `b` have the same shape. Otherwise behaves like `matrix_syrk`.
+ */
+void matrix_syr2k(matrix_t* c, matrix_uplo_t uplo, matrix_trans_t trans,
+                  double alpha, matrix_t* a, matrix_t* b, double beta,
+                  bool mirror);
+
+/** Solves `op(a) * x = b` in place, overwriting `x` (holding `b` on entry)
+ *  with the solution.
+ *
+ *  `a` is square and only its `uplo` triangle is referenced; with
+ *  `MATRIX_UNIT` its diagonal is taken to be 1 and not read. A zero on the
+ *  diagonal is not detected and yields infinities.
+ */
+void matrix_trsv(matrix_t* a, matrix_uplo_t uplo, matrix_trans_t trans,
+                 matrix_diag_t diag, vector_t* x);
+/** Solves `op(a) * x = alpha * b` (`MATRIX_LEFT`) or
+ *  `x * op(a) = alpha * b` (`MATRIX_RIGHT`) in place, overwriting `b` with
+ *  `x`.
+ *
+ *  The solve walks the triangle in `MATRIX_TRSM_BLOCK` steps: each step
+ *  solves one diagonal block directly and then removes it from the rest of
+ *  `b` with a single call to the packed product kernel, so for many
+ *  right-hand sides nearly all the work is GEMM. Independent right-hand
+ *  sides are split across the worker pool. Otherwise behaves like
+ *  `matrix_trsv`.
+ */
+void matrix_trsm(matrix_t* b, matrix_side_t side, matrix_uplo_t uplo,
+                 matrix_trans_t trans, matrix_diag_t diag, double alpha,
+                 matrix_t* a);
+
+/** Returns the product of an aligned matrix vector pair.
+ *
+ *  Row-major matrices are swept as dot products of rows, column-major ones
+ *  as sums of scaled columns, so that both stream contiguous memory.
+ */
 vector_t* matrix_vector_mul(matrix_t* m, vector_t* v);
 
 /** Returns true if the matrix is upper triangular to within a given tolerance.
@@ -85,9 +369,13 @@ bool matrix_is_upper_triangular(matrix_t* m, double tol);
 
 /** Returns true if matrices `m1` and `m2` are equal to within a given
  * tolerance. */
-bool matrix_equal(matrix_t* m1, matrix_t* m2, double tol);
+LINALG_INLINE bool matrix_equal(matrix_t* m1, matrix_t* m2, double tol);
 
 /** Returns the string representation of matrix `m`. */
 char* matrix_to_string(matrix_t* m);
 
-#endif
\ No newline at end of file
+#ifdef LINALG_HEADER_ONLY
+#include "linalg_matrix_inline.h"
+#endif
+
+#endif
@@ -0,0 +1,39 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_MATRIX_INLINE_H
+#define LINALG_MATRIX_INLINE_H
+
+/** Definitions of the small matrix functions, see `LINALG_INLINE`. */
+
+#include <math.h>  // fabs
+
+#include "linalg_matrix.h"
+
+LINALG_INLINE double matrix_get(matrix_t* m, size_t i, size_t j) {
+  return MATRIX_AT(m, i, j);
+}
+
+LINALG_INLINE void matrix_set(matrix_t* m, size_t i, size_t j, double x) {
+  MATRIX_IDX_INTO(m, i, j) = x;
+}
+
+LINALG_INLINE bool matrix_equal(matrix_t* m1, matrix_t* m2, double tol) {
+  size_t rs1 = MATRIX_ROW_STRIDE(m1), cs1 = MATRIX_COL_STRIDE(m1);
+  size_t rs2 = MATRIX_ROW_STRIDE(m2), cs2 = MATRIX_COL_STRIDE(m2);
+  size_t i, j;
+  if (m1->nrows != m2->nrows || m1->ncols != m2->ncols) {
+    return false;
+  }
+  for (i = 0; i < m1->nrows; i++) {
+    for (j = 0; j < m1->ncols; j++) {
+      if (fabs(DATA(m1)[i * rs1 + j * cs1] - DATA(m2)[i * rs2 + j * cs2]) >
+          tol) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,123 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_MEMORY_H
+#define LINALG_MEMORY_H
+
+#include <stdio.h>  // FILE
+
+#include "linalg_base.h"
+
+/** Size from which vector and matrix data is mapped directly from the
+ *  kernel, page-aligned, when a NUMA policy other than `NUMA_DEFAULT` or
+ *  the huge-page threshold applies to it. Other buffers come from malloc. */
+#ifndef MEMORY_MMAP_THRESHOLD
+#define MEMORY_MMAP_THRESHOLD (1 << 21)
+#endif
+
+/** Size of the huge pages requested for large buffers. */
+#ifndef MEMORY_HUGE_PAGE_SIZE
+#define MEMORY_HUGE_PAGE_SIZE (1 << 21)
+#endif
+
+/** Records the caller's file and line for the next allocation on this thread.
+ *
+ *  Wrap a constructor call to have leaks attributed to the wrapping line:
+ *  `vector_t* v = LINALG_TRACKED(vector_zeros(3));`
+ */
+#ifndef LINALG_TRACKED
+#define LINALG_TRACKED(expr) (memory_set_callsite(__FILE__, __LINE__), (expr))
+#endif
+
+/** Library-wide memory usage. */
+typedef struct {
+  /** Vectors and matrices (including views and buffers shared by
+   *  copy-on-write copies) not yet freed. */
+  size_t live_objects;
+  /** Bytes of object headers and owned data not yet freed. */
+  size_t live_bytes;
+  /** High-water mark of `live_bytes` since the last reset. */
+  size_t peak_bytes;
+  /** Objects created since the last reset. */
+  size_t allocations;
+  /** Seconds elapsed since the last reset. */
+  double elapsed;
+  /** Objects created per second since the last reset. */
+  double allocation_rate;
+  /** Bytes of live buffers for which huge pages were requested. */
+  size_t huge_page_bytes;
+  /** Bytes of those buffers actually backed by huge pages, as reported by
+   *  /proc/self/smaps; 0 where it is unavailable. */
+  size_t huge_page_resident;
+} memory_stats_t;
+
+/** Memory activity of the calling thread.
+ *
+ *  Objects may be freed by a different thread than the one that created
+ *  them, so only the raw totals are tracked per thread.
+ */
+typedef struct {
+  size_t allocations;
+  size_t frees;
+  size_t bytes_allocated;
+  size_t bytes_freed;
+} memory_thread_stats_t;
+
+/** Reads the library-wide memory usage into `stats`. */
+void memory_stats(memory_stats_t* stats);
+/** Reads the calling thread's memory activity into `stats`. */
+void memory_thread_stats(memory_thread_stats_t* stats);
+/** Restarts the peak, allocation count and rate clock from the current state.
+ */
+void memory_stats_reset(void);
+
+/** Starts recording every live object and prints the leftovers at exit. */
+void memory_enable_leak_report(void);
+/** Prints every live recorded object to `f` and returns how many there are. */
+size_t memory_report_leaks(FILE* f);
+/** Sets the call site attributed to the next allocation on this thread. */
+void memory_set_callsite(const char* file, int line);
+
+/** Requests huge pages for vector and matrix buffers of at least `bytes`
+ *  bytes, and returns the previous threshold.
+ *
+ *  Such buffers are mapped from hugetlbfs when pages are reserved there
+ *  (`vm.nr_hugepages`), and otherwise aligned to `MEMORY_HUGE_PAGE_SIZE`
+ *  and advised for transparent huge pages. Buffers under
+ *  `MEMORY_MMAP_THRESHOLD` never use huge pages. The threshold starts at
+ *  `LINALG_HUGE_PAGE_THRESHOLD` from the environment, otherwise `SIZE_MAX`,
+ *  which disables huge pages.
+ */
+size_t memory_set_huge_page_threshold(size_t bytes);
+
+/** Allocates the data of a vector or matrix of `rows` rows of `row_length`
+ *  doubles. Buffers of at least `MEMORY_MMAP_THRESHOLD` bytes that get huge
+ *  pages or a NUMA placement are mapped and placed with `numa_place`; all
+ *  others come from malloc. The contents are unspecified. */
+double* memory_alloc_data(size_t rows, size_t row_length);
+/** Frees data of `count` doubles from `memory_alloc_data`. */
+void memory_free_data(double* data, size_t count);
+
+/** Returns the buffer `obj` shares with its copy-on-write copies, taking
+ *  no reference.
+ *
+ *  If `obj`, a vector or matrix whose header is `header` bytes, still owns
+ *  its `count` doubles, they are first moved into a new reference counted
+ *  buffer of which `obj` becomes the only holder, and `obj` is accounted as
+ *  `kind` without its data.
+ */
+linalg_t* memory_share(linalg_t* obj, const char* kind, size_t header,
+                       size_t count);
+/** Drops one holder's reference to a buffer from `memory_share`.
+ *
+ *  Returns the data if the caller held the last reference, in which case
+ *  the buffer is gone and the caller owns the data, and NULL otherwise.
+ */
+double* memory_release_shared(linalg_t* shared);
+
+/** Accounts for a newly created object of `bytes` total size. */
+void memory_track_alloc(linalg_t* obj, const char* kind, size_t bytes);
+/** Accounts for an object of `bytes` total size about to be freed. */
+void memory_track_free(linalg_t* obj, size_t bytes);
+
+#endif
@@ -0,0 +1,62 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_NUMA_H
+#define LINALG_NUMA_H
+
+#include <stddef.h>  // size_t
+
+/** Largest node number placement policies can refer to. */
+#ifndef NUMA_MAX_NODES
+#define NUMA_MAX_NODES 256
+#endif
+
+/** Where the pages of new vector and matrix buffers are placed.
+ *
+ *  Policies apply to buffers of at least `MEMORY_MMAP_THRESHOLD` bytes;
+ *  smaller buffers come from malloc and are placed by the allocator.
+ */
+typedef enum {
+  /** Leave placement to the kernel: each page lands on the node of the
+   *  thread that first writes it. */
+  NUMA_DEFAULT,
+  /** Spread pages round-robin over every online node. */
+  NUMA_INTERLEAVE,
+  /** Zero the buffer with `parallel_for` when it is allocated, so each
+   *  worker's pages land on its own node. Rows are split exactly as
+   *  `parallel_for` splits them for the kernels, so a thread later finds
+   *  its share of an operand in local memory as long as it runs on the
+   *  same node; pin the process's threads (e.g. with numactl or taskset)
+   *  to keep it so. Where the pool cannot take the loop (one thread, an
+   *  allocation from inside a parallel loop, or while another thread owns
+   *  the pool) the buffer is interleaved as by `NUMA_INTERLEAVE` instead of
+   *  being touched by the allocating thread alone. */
+  NUMA_FIRST_TOUCH,
+  /** Place every page on the node set with `numa_set_node`. */
+  NUMA_BIND,
+} numa_policy_t;
+
+/** Sets the calling thread's placement policy and returns the previous one.
+ *
+ *  Like `parallel_set_policy`, the policy is per thread so that a single
+ *  constructor call can be wrapped in a set/restore pair. Threads start
+ *  with the policy named by `LINALG_NUMA_POLICY` (`default`, `interleave`,
+ *  `first-touch` or `bind`), or `NUMA_DEFAULT`.
+ */
+numa_policy_t numa_set_policy(numa_policy_t policy);
+/** Returns the calling thread's placement policy. */
+numa_policy_t numa_policy(void);
+/** Sets the node used by `NUMA_BIND` on the calling thread and returns the
+ *  previous one. Threads start with `LINALG_NUMA_NODE`, or node 0. */
+int numa_set_node(int node);
+/** Returns the number of online NUMA nodes, 1 where NUMA is not supported.
+ */
+size_t numa_node_count(void);
+
+/** Applies the calling thread's policy to the pages of `data`, a fresh
+ *  page-aligned buffer of `rows` rows of `row_length` doubles, before it is
+ *  first written. Placement is a hint: it is silently skipped where the
+ *  system does not support it. */
+void numa_place(double* data, size_t rows, size_t row_length);
+
+#endif
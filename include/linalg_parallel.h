@@ -0,0 +1,69 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_PARALLEL_H
+#define LINALG_PARALLEL_H
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+
+/** How size-thresholded kernels decide whether to use the worker pool. */
+typedef enum {
+  /** Split work once it exceeds the kernel's threshold. */
+  PARALLEL_AUTO,
+  /** Always run on the calling thread. */
+  PARALLEL_SERIAL,
+  /** Always split work, regardless of size. */
+  PARALLEL_ALWAYS,
+} parallel_policy_t;
+
+/** Body of a parallel loop, called on the half-open item range [begin, end).
+ */
+typedef void (*parallel_fn_t)(void* ctx, size_t begin, size_t end);
+
+/** Sets the number of threads used by parallel kernels, the caller included.
+ *
+ *  0 selects `LINALG_NUM_THREADS` from the environment if set, otherwise the
+ *  number of online CPUs. 1 disables the worker pool.
+ */
+void parallel_set_threads(size_t nthreads);
+/** Returns the number of threads used by parallel kernels. */
+size_t parallel_threads(void);
+
+/** Runs `fn` over [0, n) split into one contiguous chunk per thread.
+ *
+ *  Thread t always receives the t-th chunk, so the partition depends only on
+ *  `n` and the thread count. The caller works on chunk 0 and returns once
+ *  every chunk is done. Calls made from inside a parallel loop, or while
+ *  another thread owns the pool, run serially on the caller.
+ */
+void parallel_for(size_t n, parallel_fn_t fn, void* ctx);
+/** Runs `fn` like `parallel_for` if the pool can take the loop and returns
+ *  true. Returns false without calling `fn` where `parallel_for` would run
+ *  serially: with one thread, inside a parallel loop, or while another
+ *  thread owns the pool. */
+bool parallel_try_for(size_t n, parallel_fn_t fn, void* ctx);
+/** Returns true if the caller is running items of a parallel loop, where
+ *  further parallel loops run serially. */
+bool parallel_nested(void);
+/** Runs `fn` over [0, n) in chunks of `grain` items handed out on demand.
+ *
+ *  Suited to items of uneven cost. Otherwise behaves like `parallel_for`.
+ */
+void parallel_for_dynamic(size_t n, size_t grain, parallel_fn_t fn, void* ctx);
+
+/** Sets the calling thread's policy and returns the previous one.
+ *
+ *  The policy is per thread, so wrapping a single call in a set/restore pair
+ *  overrides the thresholds for that call only.
+ */
+parallel_policy_t parallel_set_policy(parallel_policy_t policy);
+/** Returns true if a kernel over `n` items with the given threshold should
+ *  use the worker pool under the calling thread's policy. */
+bool parallel_should_split(size_t n, size_t threshold);
+
+/** Returns the range of chunk `t` of `nchunks` when [0, n) is split evenly. */
+void parallel_chunk(size_t n, size_t nchunks, size_t t, size_t* begin,
+                    size_t* end);
+
+#endif
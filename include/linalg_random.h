@@ -0,0 +1,33 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_RANDOM_H
+#define LINALG_RANDOM_H
+
+#include <stdint.h>  // uint32_t
+
+/** Number of elements from which random fills use the worker pool. */
+#ifndef RANDOM_PARALLEL_THRESHOLD
+#define RANDOM_PARALLEL_THRESHOLD (1 << 15)
+#endif
+
+/** Number of Philox blocks a fill generates and converts per step, two
+ *  doubles each. */
+#ifndef RANDOM_BATCH
+#define RANDOM_BATCH 64
+#endif
+
+/** Computes one Philox4x32-10 block: `out` is the encryption of `counter`
+ *  under `key`.
+ *
+ *  Philox (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+ *  is a counter-based generator: any block can be computed directly from
+ *  its counter, without stepping through the ones before it. The random
+ *  constructors of vectors and matrices use the element index as the
+ *  counter and the seed as the key, so their output depends only on the
+ *  seed and the shape, never on how the work was split between threads.
+ */
+void random_philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                       uint32_t out[4]);
+
+#endif
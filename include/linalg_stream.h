@@ -0,0 +1,63 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_STREAM_H
+#define LINALG_STREAM_H
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+
+#include "linalg_matrix.h"
+#include "linalg_vector.h"
+
+/** Body of a stream operation, called with the operation's private copy of
+ *  its context. The return value becomes the result of its future. */
+typedef void* (*stream_fn_t)(void* ctx);
+
+/** An in-order queue of operations executed by its own worker thread.
+ *
+ *  Operations submitted to one stream run one at a time in submission
+ *  order, so later operations may consume the results of earlier ones.
+ *  Different streams run concurrently. Operands must stay alive, and must
+ *  not be modified by the caller, until the operation's future completes.
+ */
+typedef struct stream_t stream_t;
+/** Completion handle of one submitted operation. */
+typedef struct future_t future_t;
+
+/** Returns a new stream and starts its worker thread. */
+stream_t* stream_new(void);
+/** Waits for every submitted operation, then stops and frees the stream.
+ *  Futures stay valid until freed. */
+void stream_free(stream_t* s);
+/** Waits until every operation submitted so far has completed. */
+void stream_synchronize(stream_t* s);
+
+/** Enqueues `fn` on a copy of the `ctx_size` bytes at `ctx` and returns
+ *  its future without waiting. */
+future_t* stream_submit(stream_t* s, stream_fn_t fn, const void* ctx,
+                        size_t ctx_size);
+
+/** Returns true if the operation has completed, without blocking. */
+bool future_poll(future_t* f);
+/** Waits for the operation to complete and returns its result. */
+void* future_wait(future_t* f);
+/** Releases the caller's handle. The operation still runs if pending. */
+void future_free(future_t* f);
+
+/** Enqueues `matrix_mul_into(dst, m1, m2)`. The result is `dst`. */
+future_t* stream_matrix_mul_into(stream_t* s, matrix_t* dst, matrix_t* m1,
+                                 matrix_t* m2);
+/** Enqueues `matrix_vector_mul(m, v)`. The result is the new vector. */
+future_t* stream_matrix_vector_mul(stream_t* s, matrix_t* m, vector_t* v);
+/** Enqueues `vector_add_into(dst, v1, v2)`. The result is `dst`. */
+future_t* stream_vector_add_into(stream_t* s, vector_t* dst, vector_t* v1,
+                                 vector_t* v2);
+/** Enqueues `vector_sub_into(dst, v1, v2)`. The result is `dst`. */
+future_t* stream_vector_sub_into(stream_t* s, vector_t* dst, vector_t* v1,
+                                 vector_t* v2);
+/** Enqueues `vector_scalar_mul_into(dst, v, k)`. The result is `dst`. */
+future_t* stream_vector_scalar_mul_into(stream_t* s, vector_t* dst,
+                                        vector_t* v, double k);
+
+#endif
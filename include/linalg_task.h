@@ -0,0 +1,46 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_TASK_H
+#define LINALG_TASK_H
+
+#include <stddef.h>  // size_t
+
+/** Body of a task, called with the task's private copy of its context. */
+typedef void (*task_fn_t)(void* ctx);
+
+typedef struct task_t task_t;
+typedef struct task_graph_t task_graph_t;
+
+/** Returns a new, empty task graph. */
+task_graph_t* task_graph_new(void);
+/** Frees a task graph and all of its tasks. */
+void task_graph_free(task_graph_t* g);
+
+/** Adds a task running `fn` on a copy of the `ctx_size` bytes at `ctx`. */
+task_t* task_graph_add(task_graph_t* g, task_fn_t fn, const void* ctx,
+                       size_t ctx_size);
+/** Declares that task `t` reads the data identified by `key`.
+ *
+ *  Dependencies are inferred from the order tasks are added in: a reader
+ *  waits for the previous writer of the same key, and a writer waits for the
+ *  previous writer and every reader since. Keys are typically tile pointers.
+ */
+void task_reads(task_graph_t* g, task_t* t, const void* key);
+/** Declares that task `t` reads and writes the data identified by `key`. */
+void task_writes(task_graph_t* g, task_t* t, const void* key);
+/** Makes `after` wait for `before` to finish. */
+void task_depend(task_t* before, task_t* after);
+
+/** Returns the number of tasks in the graph. */
+size_t task_graph_size(task_graph_t* g);
+/** Runs every task of the graph on the worker pool and waits for them.
+ *
+ *  Each thread owns a deque of ready tasks. A finished task pushes the
+ *  successors it released onto its own thread's deque and that thread runs
+ *  the newest one next, while idle threads steal the oldest tasks of the
+ *  others. A graph can only be run once.
+ */
+void task_graph_run(task_graph_t* g);
+
+#endif
@@ -0,0 +1,79 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_TILE_H
+#define LINALG_TILE_H
+
+#ifndef _TILE_MATRIX_MACROS
+#define _TILE_MATRIX_MACROS
+#define TILE_MATRIX_IDX(m, i, j)                                          \
+  ((((i) / (m)->tile) * (m)->tile_cols + (j) / (m)->tile) * (m)->tile *   \
+       (m)->tile +                                                        \
+   ((i) % (m)->tile) * (m)->tile + (j) % (m)->tile)
+#define TILE_MATRIX_IDX_INTO(m, i, j) (DATA(m)[TILE_MATRIX_IDX(m, i, j)])
+#endif
+
+/** Default tile edge length. */
+#ifndef TILE_MATRIX_TILE
+#define TILE_MATRIX_TILE 64
+#endif
+
+#include "linalg_base.h"
+#include "linalg_matrix.h"
+
+/** Matrix stored as contiguous square tiles.
+ *
+ *  Tiles are laid out row-major by tile index and each tile is a packed
+ *  row-major `tile` x `tile` block, so every tile is one contiguous run of
+ *  memory. Edge tiles are padded to full size and the padding is kept at
+ *  zero.
+ */
+typedef struct {
+  linalg_t obj;
+  size_t nrows;
+  size_t ncols;
+  size_t tile;
+  size_t tile_rows;
+  size_t tile_cols;
+} tile_matrix_t;
+
+/** Returns a new tile-major matrix with all elements initialized to 0.
+ *
+ *  The data comes from `memory_alloc_data` with one row of tiles per row,
+ *  so the NUMA policy and huge-page threshold apply as for `matrix_new`.
+ */
+tile_matrix_t* tile_matrix_zeros(size_t nrows, size_t ncols, size_t tile);
+/** Frees the memory of a tile-major matrix. */
+void tile_matrix_free(tile_matrix_t* m);
+
+/** Returns a tile-major copy of row-major matrix `m`. */
+tile_matrix_t* tile_matrix_from_matrix(matrix_t* m, size_t tile);
+/** Returns a row-major copy of tile-major matrix `m`. */
+matrix_t* tile_matrix_to_matrix(tile_matrix_t* m);
+
+/** Returns a pointer to the first element of tile (ti, tj). */
+double* tile_matrix_tile(tile_matrix_t* m, size_t ti, size_t tj);
+
+/** Reads the product of two aligned tile-major matrices into `dst`.
+ *
+ *  All three must share a tile size and have compatible shapes, otherwise
+ *  `LINALG_LAYOUT_ERROR` is raised. Each output tile is accumulated from
+ *  whole contiguous tiles, so no packing is needed, and output tiles are
+ *  spread over the worker pool.
+ */
+void tile_matrix_mul_into(tile_matrix_t* dst, tile_matrix_t* m1,
+                          tile_matrix_t* m2);
+/** Reads the transpose of `m` into `dst`, tile by tile. `dst` must have the
+ *  tile size of `m` and the transposed shape, otherwise
+ *  `LINALG_LAYOUT_ERROR` is raised. */
+void tile_matrix_transpose_into(tile_matrix_t* dst, tile_matrix_t* m);
+/** Computes the lower Cholesky factor of `m` in place, as with
+ *  `matrix_cholesky_tiled`, using the storage tiles as task tiles. Raises
+ *  `LINALG_LAYOUT_ERROR` if `m` is not square. */
+bool tile_matrix_cholesky(tile_matrix_t* m);
+
+/** Returns true if tile-major matrices `m1` and `m2` are equal to within a
+ * given tolerance. */
+bool tile_matrix_equal(tile_matrix_t* m1, tile_matrix_t* m2, double tol);
+
+#endif
@@ -0,0 +1,72 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_TRACE_H
+#define LINALG_TRACE_H
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+
+/** Number of events each thread's ring buffer holds before wrapping. The
+ *  ring of a thread that exits is kept and reused by the next new thread. */
+#ifndef TRACE_BUFFER_CAPACITY
+#define TRACE_BUFFER_CAPACITY 4096
+#endif
+
+/** Instrumentation hooks compiled into the library with `-DLINALG_TRACE`.
+ *
+ *  Without the flag the hooks expand to nothing and tracing costs nothing.
+ */
+#ifndef _TRACE_MACROS
+#define _TRACE_MACROS
+#ifdef LINALG_TRACE
+#define TRACE_BEGIN(rows, cols) trace_begin(__func__, rows, cols)
+#define TRACE_END() trace_end(__func__)
+#else
+#define TRACE_BEGIN(rows, cols)
+#define TRACE_END()
+#endif
+#endif
+
+/** A single begin ('B') or end ('E') timeline event. */
+typedef struct {
+  const char* name;
+  char phase;
+  unsigned tid;
+  double ts;
+  size_t rows;
+  size_t cols;
+} trace_event_t;
+
+/** Starts recording events. Tracing is disabled by default. */
+void trace_enable(void);
+/** Stops recording events. Recorded events are kept until `trace_reset`. */
+void trace_disable(void);
+/** Returns true if events are currently being recorded. */
+bool trace_enabled(void);
+
+/** Records the beginning of operation `name` on an operand of the given shape.
+ *
+ *  Each thread writes into its own ring buffer so recording never takes a
+ *  lock. Vectors are recorded with `cols` equal to 1.
+ */
+void trace_begin(const char* name, size_t rows, size_t cols);
+/** Records the end of operation `name`. */
+void trace_end(const char* name);
+
+/** Returns the number of events currently held across all threads. */
+size_t trace_event_count(void);
+/** Discards all recorded events.
+ *
+ *  Must not run concurrently with threads that are recording.
+ */
+void trace_reset(void);
+/** Writes all recorded events to `path` as Chrome trace-event JSON.
+ *
+ *  The output loads directly in Perfetto or chrome://tracing. Must not run
+ *  concurrently with threads that are recording. Returns false if the file
+ *  could not be written.
+ */
+bool trace_flush(const char* path);
+
+#endif
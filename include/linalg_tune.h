@@ -0,0 +1,74 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_TUNE_H
+#define LINALG_TUNE_H
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+
+#include "linalg_vector.h"
+
+/** Environment variable naming the profile file loaded at startup. */
+#ifndef TUNE_PROFILE_ENV
+#define TUNE_PROFILE_ENV "LINALG_TUNE_PROFILE"
+#endif
+
+/** Environment variable that, when set, runs `tune_run` at startup if the
+ *  profile has no entry for this CPU and saves the result. */
+#ifndef TUNE_AUTOTUNE_ENV
+#define TUNE_AUTOTUNE_ENV "LINALG_AUTOTUNE"
+#endif
+
+/** Block sizes and thresholds that depend on the machine. */
+typedef struct {
+  /** Depth of the packed panel of `b` in the blocked matrix product. */
+  size_t gemm_kc;
+  /** Width of the packed panel of `b` in the blocked matrix product. */
+  size_t gemm_nc;
+  /** Edge length of the tiles swapped by `matrix_transpose`. */
+  size_t transpose_block;
+  /** Number of columns `matrix_vector_mul` sweeps at a time. */
+  size_t gemv_block;
+  /** Lengths from which each `vector_op_t` is split across threads. */
+  size_t vector_thresholds[VECTOR_OP_COUNT];
+} tune_params_t;
+
+/** Returns the parameters in use.
+ *
+ *  The first call initializes them: from the entry for this CPU in the
+ *  file named by `TUNE_PROFILE_ENV` if there is one, otherwise from
+ *  `tune_defaults`.
+ */
+const tune_params_t* tune_params(void);
+/** Replaces the parameters in use. Must not race with running kernels. */
+void tune_set_params(const tune_params_t* params);
+/** Reads parameters derived from the cache sizes in sysfs into `params`,
+ *  or the compile-time defaults where sysfs is unavailable. */
+void tune_defaults(tune_params_t* params);
+/** Benchmarks candidate block sizes and thresholds and reads the fastest
+ *  into `params`. Takes a few seconds; the parameters in use are left
+ *  unchanged.
+ *
+ *  Returns false, leaving `params` unchanged, when called from inside a
+ *  parallel loop, where the pool cannot be measured.
+ */
+bool tune_run(tune_params_t* params);
+
+/** Returns the CPU model name from /proc/cpuinfo, or "unknown". */
+const char* tune_cpu_model(void);
+/** Reads the entry for this CPU in profile `path` into `params`.
+ *
+ *  Returns false, leaving `params` unchanged, if the file or the entry does
+ *  not exist. Keys missing from the entry keep their value in `params`.
+ */
+bool tune_load(const char* path, tune_params_t* params);
+/** Writes `params` as the entry for this CPU in profile `path`, keeping the
+ *  entries of other CPUs. Returns false if the file cannot be written.
+ *
+ *  A profile is plain text: a `[model name]` line opens each entry and is
+ *  followed by one `key value` line per parameter.
+ */
+bool tune_save(const char* path, const tune_params_t* params);
+
+#endif
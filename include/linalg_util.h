@@ -20,7 +20,7 @@
 /** Raises LINALG_NONZERO_REFERENCE_ERROR if `obj` has more than 0 references to it. */
 #define CHECK_REF_COUNT(obj)                       \
   {                                                \
-    if (REF_COUNT(obj) != 0) {                     \
+    if (REF_COUNT_LOAD(obj) != 0) {                \
       raise_error(LINALG_NONZERO_REFERENCE_ERROR); \
     }                                              \
   }
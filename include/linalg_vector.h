@@ -6,9 +6,36 @@
 
 #ifndef _VECTOR_MACROS
 #define _VECTOR_MACROS
-#define VECTOR_IDX_INTO(v, i) (DATA(v)[i])
+/** Element `i` of `v` as an lvalue, giving a copy-on-write vector its own
+ *  data first. */
+#define VECTOR_IDX_INTO(v, i) \
+  ((COPY_ON_WRITE(v) ? vector_data_into(v) : DATA(v))[(i)])
+/** Value of element `i` of `v`. Reading never detaches a shared copy. */
+#define VECTOR_AT(v, i) ((double)DATA(v)[(i)])
 #endif
 
+/** Elements per chunk of a map, sized to stay in the L1 cache. */
+#ifndef VECTOR_MAP_CHUNK
+#define VECTOR_MAP_CHUNK 2048
+#endif
+
+/** Length from which reductions are split across threads. */
+#ifndef VECTOR_REDUCE_THRESHOLD
+#define VECTOR_REDUCE_THRESHOLD (1 << 16)
+#endif
+
+/** Number of elements per block in reproducible reductions. */
+#ifndef VECTOR_REPRODUCIBLE_BLOCK
+#define VECTOR_REPRODUCIBLE_BLOCK 1024
+#endif
+
+/** Length from which maps are split across threads. */
+#ifndef VECTOR_MAP_THRESHOLD
+#define VECTOR_MAP_THRESHOLD (1 << 15)
+#endif
+
+#include <stdint.h>  // uint64_t
+
 #include "linalg_base.h"
 
 typedef struct {
@@ -16,6 +43,37 @@ typedef struct {
   size_t length;
 } vector_t;
 
+/** Element-wise operations that can run on the worker pool. */
+typedef enum {
+  VECTOR_OP_CONSTANT,
+  VECTOR_OP_LINSPACE,
+  VECTOR_OP_COPY,
+  VECTOR_OP_ADD,
+  VECTOR_OP_SUB,
+  VECTOR_OP_SCALAR_MUL,
+  VECTOR_OP_COUNT,
+} vector_op_t;
+
+/** Sets the length from which operation `op` is split across threads. */
+void vector_set_parallel_threshold(vector_op_t op, size_t length);
+/** Returns the length from which operation `op` is split across threads. */
+size_t vector_parallel_threshold(vector_op_t op);
+/** Measures every operation serially and in parallel over doubling
+ *  lengths and sets each threshold to the first length from which parallel
+ *  wins at two consecutive lengths, so that one noisy timing cannot set it.
+ *  Takes on the order of a second. */
+void vector_calibrate_parallel_thresholds(void);
+
+/** Enables or disables reproducible reductions.
+ *
+ *  When enabled, `vector_dot`, `vector_sum` and `vector_norm` go through
+ *  their `_reproducible` variants, and the other reductions run serially,
+ *  so results are bitwise identical for any thread count. Off by default.
+ */
+void vector_set_reproducible(bool enabled);
+/** Returns whether reproducible reductions are enabled. */
+bool vector_reproducible(void);
+
 /** Returns a new vector. */
 vector_t* vector_new(size_t length);
 /** Returns a new vector which is a view into an existing vector.
@@ -38,6 +96,26 @@ vector_t* vector_ones(size_t length);
 /** Returns a new vector with each element equally spaced bewteen the closed
  * interval [min, max]. */
 vector_t* vector_linspace(size_t length, double min, double max);
+/** Returns a vector of independent uniform samples from [min, max).
+ *
+ *  Element i depends only on `seed` and i (see `random_philox4x32`), so the
+ *  result is the same for any thread count.
+ */
+vector_t* vector_random_uniform(size_t length, double min, double max,
+                                uint64_t seed);
+/** Returns a vector of independent normal samples.
+ *
+ *  Pairs of elements come from the Box-Muller transform of one Philox
+ *  block. Otherwise behaves like `vector_random_uniform`.
+ */
+vector_t* vector_random_normal(size_t length, double mean, double stddev,
+                               uint64_t seed);
+
+/** Returns element `i` of `v`. */
+LINALG_INLINE double vector_get(vector_t* v, size_t i);
+/** Sets element `i` of `v` to `x`, giving a copy-on-write vector its own
+ *  data first. */
+LINALG_INLINE void vector_set(vector_t* v, size_t i, double x);
 
 /** Returns a view into a segment of an existing vector.
  *
@@ -45,8 +123,16 @@ vector_t* vector_linspace(size_t length, double min, double max);
  *  from indices `start` to `end`.
  */
 vector_t* vector_slice(vector_t* v, size_t start, size_t end);
-/** Returns a copy of vector `v`. */
+/** Returns a copy of vector `v`.
+ *
+ *  With copy-on-write enabled the copy shares `v`'s data until it is first
+ *  mutated, see `linalg_set_copy_on_write`.
+ */
 vector_t* vector_copy(vector_t* v);
+/** Gives a copy-on-write vector its own private data. No-op otherwise. */
+void vector_materialize(vector_t* v);
+/** Materializes `v` and returns its data, for writing. */
+double* vector_data_into(vector_t* v);
 /** Copies vector `v` into vector `dst`. */
 void vector_copy_into(vector_t* dst, vector_t* v);
 
@@ -71,16 +157,106 @@ vector_t* vector_normalize(vector_t* v);
 /** Reads the result of the normalization of vector `v` into `dst`. */
 void vector_normalize_into(vector_t* dst, vector_t* v);
 
+/** Reads `fn` applied to every element of `v` into `dst`.
+ *
+ *  Elements are processed in chunks of `VECTOR_MAP_CHUNK` that are spread
+ *  over the worker pool for long vectors. `dst` may be `v`. The specialized
+ *  maps below use inlined, branch-free approximations instead of a call per
+ *  element, so their loops vectorize when built with -O3 -fno-math-errno
+ *  (`make vectorize-check` verifies this); their worst errors against
+ *  correctly rounded results were measured over their whole useful domain.
+ */
+void vector_map_into(vector_t* dst, vector_t* v, double (*fn)(double));
+/** Reads e^x of every element into `dst`. Within 1.5 ULP; results below the
+ *  smallest normal double are flushed to 0. */
+void vector_map_exp_into(vector_t* dst, vector_t* v);
+/** Reads the natural logarithm of every element into `dst`. Within 1 ULP. */
+void vector_map_log_into(vector_t* dst, vector_t* v);
+/** Reads the square root of every element into `dst`. Correctly rounded. */
+void vector_map_sqrt_into(vector_t* dst, vector_t* v);
+/** Reads tanh of every element into `dst`. Within 2.5 ULP. */
+void vector_map_tanh_into(vector_t* dst, vector_t* v);
+/** Reads the logistic sigmoid 1 / (1 + e^-x) of every element into `dst`.
+ *  Within 2.5 ULP. */
+void vector_map_sigmoid_into(vector_t* dst, vector_t* v);
+
 /** Returns the dot product of vectors `v1` and `v2`. */
-double vector_dot(vector_t* v1, vector_t* v2);
-/** Returns the L2 norm of vector `v`. */
-double vector_norm(vector_t* v);
+LINALG_INLINE double vector_dot(vector_t* v1, vector_t* v2);
+/** Returns the L2 norm of vector `v`.
+ *
+ *  Falls back to `vector_norm_scaled` if the sum of squares overflows or
+ *  underflows.
+ */
+LINALG_INLINE double vector_norm(vector_t* v);
+
+/** Returns the sum of the elements of `v`. */
+double vector_sum(vector_t* v);
+/** Returns the product of the elements of `v`. */
+double vector_prod(vector_t* v);
+/** Returns the smallest element of `v`.
+ *
+ *  NaN propagates: if any element is NaN the result is NaN, wherever the
+ *  NaN sits and however the vector is split between threads.
+ */
+double vector_min(vector_t* v);
+/** Returns the largest element of `v`. NaN propagates as in `vector_min`. */
+double vector_max(vector_t* v);
+/** Returns the index of the first smallest element of `v`, or of the first
+ *  NaN if `v` holds one. */
+size_t vector_argmin(vector_t* v);
+/** Returns the index of the first largest element of `v`, or of the first
+ *  NaN if `v` holds one. */
+size_t vector_argmax(vector_t* v);
+/** Returns the L1 norm (sum of absolute values) of vector `v`. */
+double vector_norm_l1(vector_t* v);
+/** Returns the L-infinity norm (largest absolute value) of vector `v`, NaN
+ *  if `v` holds a NaN. */
+double vector_norm_inf(vector_t* v);
+/** Returns the L2 norm of vector `v` without intermediate overflow or
+ *  underflow.
+ *
+ *  Uses Blue's algorithm: one pass with three accumulators for small,
+ *  medium and large magnitudes, combined at the end. Chunks whose plain sum
+ *  of squares is in range skip the scaling, so it runs at the speed of a
+ *  plain sum of squares.
+ */
+double vector_norm_scaled(vector_t* v);
+/** Reads the mean and population variance of `v` in a single pass.
+ *
+ *  Each block is accumulated with Welford's update and blocks are merged
+ *  with Chan's pairwise formula, so the result stays accurate for data with
+ *  a large mean.
+ */
+void vector_mean_variance(vector_t* v, double* mean, double* variance);
+/** Returns the mean of the elements of `v`. */
+double vector_mean(vector_t* v);
+/** Returns the population variance of the elements of `v`. */
+double vector_variance(vector_t* v);
+
+/** Returns the dot product of `v1` and `v2`, bitwise identical for any
+ *  thread count.
+ *
+ *  The input is cut into blocks of `VECTOR_REPRODUCIBLE_BLOCK` elements,
+ *  each block is summed into 8 interleaved lanes combined by a fixed tree,
+ *  and the block sums are combined by a fixed pairwise tree. Only the
+ *  assignment of blocks to threads varies between runs.
+ */
+double vector_dot_reproducible(vector_t* v1, vector_t* v2);
+/** Returns the sum of the elements of `v`, bitwise identical for any
+ *  thread count. */
+double vector_sum_reproducible(vector_t* v);
+/** Returns the L2 norm of `v`, bitwise identical for any thread count. */
+double vector_norm_reproducible(vector_t* v);
 
 /** Returns the string representation of vector `v`. */
 char* vector_to_string(vector_t* v);
 
 /** Returns true if vectors v1 and v2 are equal to within a given tolerance.
  */
-bool vector_equal(vector_t* v1, vector_t* v2, double tol);
+LINALG_INLINE bool vector_equal(vector_t* v1, vector_t* v2, double tol);
+
+#ifdef LINALG_HEADER_ONLY
+#include "linalg_vector_inline.h"
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_VECTOR_INLINE_H
+#define LINALG_VECTOR_INLINE_H
+
+/** Definitions of the small vector functions, see `LINALG_INLINE`. */
+
+#include <float.h>  // DBL_MIN
+#include <math.h>   // fabs, sqrt
+
+#include "linalg_trace.h"
+#include "linalg_vector.h"
+
+LINALG_INLINE double vector_get(vector_t* v, size_t i) {
+  return VECTOR_AT(v, i);
+}
+
+LINALG_INLINE void vector_set(vector_t* v, size_t i, double x) {
+  VECTOR_IDX_INTO(v, i) = x;
+}
+
+LINALG_INLINE double vector_dot(vector_t* v1, vector_t* v2) {
+  double prod = 0;
+  size_t i;
+  if (vector_reproducible()) {
+    return vector_dot_reproducible(v1, v2);
+  }
+  TRACE_BEGIN(v1->length, 1);
+  for (i = 0; i < v1->length; i++) {
+    prod += VECTOR_AT(v1, i) * VECTOR_AT(v2, i);
+  }
+  TRACE_END();
+  return prod;
+}
+
+LINALG_INLINE double vector_norm(vector_t* v) {
+  double norm;
+  if (vector_reproducible()) {
+    return vector_norm_reproducible(v);
+  }
+  TRACE_BEGIN(v->length, 1);
+  norm = vector_dot(v, v);
+  if (isfinite(norm) && norm >= DBL_MIN / DBL_EPSILON) {
+    norm = sqrt(norm);
+  } else {
+    norm = vector_norm_scaled(v);
+  }
+  TRACE_END();
+  return norm;
+}
+
+LINALG_INLINE bool vector_equal(vector_t* v1, vector_t* v2, double tol) {
+  size_t i;
+  if (v1->length != v2->length) {
+    return false;
+  }
+  for (i = 0; i < v1->length; i++) {
+    if (fabs(VECTOR_AT(v1, i) - VECTOR_AT(v2, i)) > tol) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
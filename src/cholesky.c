@@ -0,0 +1,214 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+#include <stdatomic.h>
+
+#include "kernels.h"
+#include "linalg_matrix.h"
+#include "linalg_task.h"
+#include "linalg_trace.h"
+
+bool kernel_potrf(double *a, size_t lda, size_t n) {
+  size_t i, j, p;
+  double d, sum;
+  for (j = 0; j < n; j++) {
+    d = a[j * lda + j];
+    for (p = 0; p < j; p++) {
+      d -= a[j * lda + p] * a[j * lda + p];
+    }
+    if (!(d > 0)) {
+      return false;
+    }
+    d = sqrt(d);
+    a[j * lda + j] = d;
+    for (i = j + 1; i < n; i++) {
+      sum = a[i * lda + j];
+      for (p = 0; p < j; p++) {
+        sum -= a[i * lda + p] * a[j * lda + p];
+      }
+      a[i * lda + j] = sum / d;
+    }
+  }
+  return true;
+}
+
+void kernel_trsm_rlt(double *b, size_t ldb, const double *l, size_t ldl,
+                     size_t m, size_t n) {
+  size_t r, j, p;
+  double sum;
+  for (r = 0; r < m; r++) {
+    for (j = 0; j < n; j++) {
+      sum = b[r * ldb + j];
+      for (p = 0; p < j; p++) {
+        sum -= b[r * ldb + p] * l[j * ldl + p];
+      }
+      b[r * ldb + j] = sum / l[j * ldl + j];
+    }
+  }
+}
+
+void kernel_syrk_ln(double *c, size_t ldc, const double *a, size_t lda,
+                    size_t n, size_t k) {
+  size_t i, j, p;
+  double sum;
+  for (i = 0; i < n; i++) {
+    for (j = 0; j <= i; j++) {
+      sum = 0;
+      for (p = 0; p < k; p++) {
+        sum += a[i * lda + p] * a[j * lda + p];
+      }
+      c[i * ldc + j] -= sum;
+    }
+  }
+}
+
+void kernel_gemm_nt(double *c, size_t ldc, const double *a, size_t lda,
+                    const double *b, size_t ldb, size_t m, size_t n,
+                    size_t k) {
+  size_t i, j, p;
+  double sum;
+  for (i = 0; i < m; i++) {
+    for (j = 0; j < n; j++) {
+      sum = 0;
+      for (p = 0; p < k; p++) {
+        sum += a[i * lda + p] * b[j * ldb + p];
+      }
+      c[i * ldc + j] -= sum;
+    }
+  }
+}
+
+/** Arguments of one tile task. Tile (i, j) starts at
+ *  `a + i * row_stride + j * col_stride`. */
+typedef struct {
+  double *a;
+  size_t ld;
+  size_t row_stride;
+  size_t col_stride;
+  size_t n;
+  size_t tile;
+  size_t i;
+  size_t j;
+  size_t k;
+  atomic_bool *failed;
+} cholesky_task_t;
+
+static double *cholesky_tile(cholesky_task_t *t, size_t i, size_t j) {
+  return t->a + i * t->row_stride + j * t->col_stride;
+}
+
+static size_t cholesky_extent(cholesky_task_t *t, size_t i) {
+  size_t rest = t->n - i * t->tile;
+  return rest < t->tile ? rest : t->tile;
+}
+
+static void cholesky_potrf(void *ctx) {
+  cholesky_task_t *t = ctx;
+  if (!kernel_potrf(cholesky_tile(t, t->k, t->k), t->ld,
+                    cholesky_extent(t, t->k))) {
+    atomic_store(t->failed, true);
+  }
+}
+
+static void cholesky_trsm(void *ctx) {
+  cholesky_task_t *t = ctx;
+  kernel_trsm_rlt(cholesky_tile(t, t->i, t->k), t->ld,
+                  cholesky_tile(t, t->k, t->k), t->ld, cholesky_extent(t, t->i),
+                  cholesky_extent(t, t->k));
+}
+
+static void cholesky_syrk(void *ctx) {
+  cholesky_task_t *t = ctx;
+  kernel_syrk_ln(cholesky_tile(t, t->i, t->i), t->ld,
+                 cholesky_tile(t, t->i, t->k), t->ld, cholesky_extent(t, t->i),
+                 cholesky_extent(t, t->k));
+}
+
+static void cholesky_gemm(void *ctx) {
+  cholesky_task_t *t = ctx;
+  kernel_gemm_nt(cholesky_tile(t, t->i, t->j), t->ld,
+                 cholesky_tile(t, t->i, t->k), t->ld,
+                 cholesky_tile(t, t->j, t->k), t->ld, cholesky_extent(t, t->i),
+                 cholesky_extent(t, t->j), cholesky_extent(t, t->k));
+}
+
+/** Adds the task `fn` on tile (i, j) of step k with its tile accesses. */
+static void cholesky_add(task_graph_t *g, task_fn_t fn, cholesky_task_t *args,
+                         size_t i, size_t j, size_t k) {
+  task_t *task;
+  args->i = i;
+  args->j = j;
+  args->k = k;
+  task = task_graph_add(g, fn, args, sizeof(cholesky_task_t));
+  if (fn == cholesky_trsm) {
+    task_reads(g, task, cholesky_tile(args, k, k));
+  } else if (fn != cholesky_potrf) {
+    task_reads(g, task, cholesky_tile(args, i, k));
+    task_reads(g, task, cholesky_tile(args, j, k));
+  }
+  task_writes(g, task, cholesky_tile(args, i, j));
+}
+
+bool kernel_cholesky_tiles(double *a, size_t ld, size_t row_stride,
+                           size_t col_stride, size_t n, size_t tile) {
+  size_t nt = (n + tile - 1) / tile;
+  size_t i, j, k;
+  atomic_bool failed = false;
+  cholesky_task_t args;
+  task_graph_t *g = task_graph_new();
+  args.a = a;
+  args.ld = ld;
+  args.row_stride = row_stride;
+  args.col_stride = col_stride;
+  args.n = n;
+  args.tile = tile;
+  args.failed = &failed;
+  for (k = 0; k < nt; k++) {
+    cholesky_add(g, cholesky_potrf, &args, k, k, k);
+    for (i = k + 1; i < nt; i++) {
+      cholesky_add(g, cholesky_trsm, &args, i, k, k);
+    }
+    for (i = k + 1; i < nt; i++) {
+      cholesky_add(g, cholesky_syrk, &args, i, i, k);
+      for (j = k + 1; j < i; j++) {
+        cholesky_add(g, cholesky_gemm, &args, i, j, k);
+      }
+    }
+  }
+  task_graph_run(g);
+  task_graph_free(g);
+  return !atomic_load(&failed);
+}
+
+bool matrix_cholesky_tiled(matrix_t *m, size_t tile) {
+  matrix_t *row;
+  size_t i, j;
+  bool ok;
+  if (m->order != MATRIX_ROW_MAJOR) {
+    // The tile kernels factor the lower triangle of row-major storage.
+    row = matrix_copy_order(m, MATRIX_ROW_MAJOR);
+    ok = matrix_cholesky_tiled(row, tile);
+    matrix_copy_into(m, row);
+    matrix_free(row);
+    return ok;
+  }
+  matrix_materialize(m);
+  TRACE_BEGIN(m->nrows, m->ncols);
+  if (tile == 0) {
+    tile = MATRIX_CHOLESKY_TILE;
+  }
+  ok = kernel_cholesky_tiles(DATA(m), m->ld, tile * m->ld, tile, m->nrows,
+                             tile);
+  for (i = 0; i < m->nrows; i++) {
+    for (j = i + 1; j < m->ncols; j++) {
+      DATA(m)[MATRIX_IDX_ROW(m, i, j)] = 0;
+    }
+  }
+  TRACE_END();
+  return ok;
+}
+
+bool matrix_cholesky(matrix_t *m) {
+  return matrix_cholesky_tiled(m, MATRIX_CHOLESKY_TILE);
+}
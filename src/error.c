@@ -0,0 +1,27 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include "linalg_error.h"
+
+void raise_error(linalg_error_t error) {
+  switch (error) {
+  case LINALG_SUCCESS:
+    exit(EXIT_SUCCESS);
+  case LINALG_UNKNOWN_ERROR:
+    printf("encountered unknown error");
+    break;
+  case LINALG_ALLOCATION_ERROR:
+    printf("memory allocation error");
+    break;
+  case LINALG_NONZERO_REFERENCE_ERROR:
+    printf("cannot free memory with non-zero reference count");
+    break;
+  case LINALG_VIEW_ERROR:
+    printf("operation would reallocate the memory of a view");
+    break;
+  case LINALG_LAYOUT_ERROR:
+    printf("operation is not supported for the matrix storage order");
+    break;
+  }
+  exit(EXIT_FAILURE);
+}
@@ -0,0 +1,527 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <stdlib.h>
+
+#include "kernels.h"
+#include "linalg_expr.h"
+#include "linalg_parallel.h"
+#include "linalg_trace.h"
+#include "linalg_tune.h"
+#include "linalg_util.h"
+
+typedef enum {
+  EXPR_LEAF,
+  EXPR_ADD,
+  EXPR_SUB,
+  EXPR_MUL,
+  EXPR_SCALE,
+  EXPR_MAP,
+  EXPR_COPY,
+  EXPR_NORMALIZE,
+  EXPR_MATVEC,
+} expr_op_t;
+
+struct expr_t {
+  expr_op_t op;
+  expr_t *a;
+  expr_t *b;
+  double s;
+  double (*fn)(double);
+  vector_t *v;
+  matrix_t *m;
+  size_t length;
+  /** Number of nodes using this one as an operand. */
+  size_t uses;
+  /** Whole-vector value of a barrier node during an evaluation. */
+  vector_t *buffer;
+  bool pooled;
+  /** Whether the barriers below the node have been computed during the
+   *  current evaluation. */
+  bool prepared;
+  /** Consumers not yet emitted in the kernel being compiled, and the
+   *  operand holding the node's value once it has been emitted there. */
+  size_t pending;
+  int operand;
+  bool emitted;
+};
+
+struct expr_graph_t {
+  expr_t **nodes;
+  size_t nnodes;
+  size_t capacity;
+  /** Temporaries free for reuse. */
+  vector_t **pool;
+  size_t npool;
+  size_t pool_capacity;
+};
+
+/** One step of a fused kernel. Operands below `ninputs` are input vectors,
+ *  the others scratch slots; an output of -1 is the destination. */
+typedef struct {
+  expr_op_t op;
+  int out;
+  int a;
+  int b;
+  double s;
+  double (*fn)(double);
+} expr_instr_t;
+
+/** A fused element-wise kernel. */
+typedef struct {
+  expr_instr_t *code;
+  size_t ncode;
+  size_t code_capacity;
+  const double **inputs;
+  vector_t **input_vectors;
+  size_t ninputs;
+  size_t input_capacity;
+  /** Free-list of scratch slots and the number ever allocated. */
+  bool *slot_used;
+  size_t nslots;
+  double *dst;
+  size_t length;
+} expr_kernel_t;
+
+static void *expr_grow(void *p, size_t *capacity, size_t count, size_t size) {
+  if (count < *capacity) {
+    return p;
+  }
+  *capacity = *capacity > 0 ? 2 * *capacity : 8;
+  p = realloc(p, *capacity * size);
+  CHECK_MEMORY(p);
+  return p;
+}
+
+expr_graph_t *expr_graph_new(void) {
+  expr_graph_t *g = calloc(1, sizeof(expr_graph_t));
+  CHECK_MEMORY(g);
+  return g;
+}
+
+void expr_graph_free(expr_graph_t *g) {
+  size_t i;
+  for (i = 0; i < g->nnodes; i++) {
+    free(g->nodes[i]);
+  }
+  for (i = 0; i < g->npool; i++) {
+    vector_free(g->pool[i]);
+  }
+  free(g->nodes);
+  free(g->pool);
+  free(g);
+}
+
+static expr_t *expr_node(expr_graph_t *g, expr_op_t op, expr_t *a,
+                         expr_t *b) {
+  expr_t *e = calloc(1, sizeof(expr_t));
+  CHECK_MEMORY(e);
+  e->op = op;
+  e->a = a;
+  e->b = b;
+  if (a != NULL) {
+    a->uses++;
+    e->length = a->length;
+  }
+  if (b != NULL) {
+    b->uses++;
+  }
+  g->nodes = expr_grow(g->nodes, &g->capacity, g->nnodes, sizeof(expr_t *));
+  g->nodes[g->nnodes++] = e;
+  return e;
+}
+
+expr_t *expr_vector(expr_graph_t *g, vector_t *v) {
+  expr_t *e = expr_node(g, EXPR_LEAF, NULL, NULL);
+  e->v = v;
+  e->length = v->length;
+  return e;
+}
+
+expr_t *expr_add(expr_graph_t *g, expr_t *a, expr_t *b) {
+  return expr_node(g, EXPR_ADD, a, b);
+}
+
+expr_t *expr_sub(expr_graph_t *g, expr_t *a, expr_t *b) {
+  return expr_node(g, EXPR_SUB, a, b);
+}
+
+expr_t *expr_mul(expr_graph_t *g, expr_t *a, expr_t *b) {
+  return expr_node(g, EXPR_MUL, a, b);
+}
+
+expr_t *expr_scale(expr_graph_t *g, expr_t *a, double s) {
+  expr_t *e = expr_node(g, EXPR_SCALE, a, NULL);
+  e->s = s;
+  return e;
+}
+
+expr_t *expr_map(expr_graph_t *g, expr_t *a, double (*fn)(double)) {
+  expr_t *e = expr_node(g, EXPR_MAP, a, NULL);
+  e->fn = fn;
+  return e;
+}
+
+expr_t *expr_normalize(expr_graph_t *g, expr_t *a) {
+  return expr_node(g, EXPR_NORMALIZE, a, NULL);
+}
+
+expr_t *expr_matrix_vector_mul(expr_graph_t *g, matrix_t *m, expr_t *a) {
+  expr_t *e = expr_node(g, EXPR_MATVEC, a, NULL);
+  e->m = m;
+  e->length = m->nrows;
+  return e;
+}
+
+/** Returns a pooled temporary of `length` elements. */
+static vector_t *expr_acquire(expr_graph_t *g, size_t length) {
+  size_t i;
+  vector_t *v;
+  for (i = 0; i < g->npool; i++) {
+    if (g->pool[i]->length == length) {
+      v = g->pool[i];
+      g->pool[i] = g->pool[--g->npool];
+      return v;
+    }
+  }
+  return vector_new(length);
+}
+
+static void expr_release(expr_graph_t *g, vector_t *v) {
+  g->pool = expr_grow(g->pool, &g->pool_capacity, g->npool,
+                      sizeof(vector_t *));
+  g->pool[g->npool++] = v;
+}
+
+static int expr_input(expr_kernel_t *k, vector_t *v) {
+  size_t i;
+  for (i = 0; i < k->ninputs; i++) {
+    if (k->input_vectors[i] == v) {
+      return (int)i;
+    }
+  }
+  k->input_vectors = expr_grow(k->input_vectors, &k->input_capacity,
+                               k->ninputs, sizeof(vector_t *));
+  k->input_vectors[k->ninputs] = v;
+  return (int)k->ninputs++;
+}
+
+/** Returns a free scratch slot. Inputs are numbered first, so slots are
+ *  only numbered once every input is known; see `expr_compile`. */
+static int expr_slot(expr_kernel_t *k) {
+  size_t i;
+  for (i = 0; i < k->nslots; i++) {
+    if (!k->slot_used[i]) {
+      k->slot_used[i] = true;
+      return -2 - (int)i;
+    }
+  }
+  k->slot_used = realloc(k->slot_used, (k->nslots + 1) * sizeof(bool));
+  CHECK_MEMORY(k->slot_used);
+  k->slot_used[k->nslots] = true;
+  return -2 - (int)k->nslots++;
+}
+
+static void expr_free_slot(expr_kernel_t *k, int operand) {
+  if (operand <= -2) {
+    k->slot_used[-2 - operand] = false;
+  }
+}
+
+static int expr_emit(expr_kernel_t *k, expr_op_t op, int a, int b, double s,
+                     double (*fn)(double)) {
+  expr_instr_t *instr;
+  k->code = expr_grow(k->code, &k->code_capacity, k->ncode,
+                      sizeof(expr_instr_t));
+  instr = &k->code[k->ncode++];
+  instr->op = op;
+  instr->a = a;
+  instr->b = b;
+  instr->s = s;
+  instr->fn = fn;
+  instr->out = expr_slot(k);
+  return instr->out;
+}
+
+/** Counts the consumers of every node of the element-wise region rooted
+ *  at `e`, visiting each node once. */
+static void expr_count(expr_t *e) {
+  if (e->op == EXPR_LEAF || e->op == EXPR_MATVEC ||
+      e->op == EXPR_NORMALIZE) {
+    return;
+  }
+  if (e->a->pending++ == 0) {
+    expr_count(e->a);
+  }
+  if (e->b != NULL && e->b->pending++ == 0) {
+    expr_count(e->b);
+  }
+}
+
+/** Marks one consumer of `e` as emitted, freeing its slot after the last. */
+static void expr_drop(expr_kernel_t *k, expr_t *e) {
+  if (--e->pending == 0) {
+    expr_free_slot(k, e->operand);
+    e->emitted = false;
+  }
+}
+
+/** Emits the element-wise code of `e`, returning the operand holding its
+ *  value. Leaves and prepared barriers are read as inputs. A node shared by
+ *  several consumers is emitted once and its slot kept until the last of
+ *  them has been emitted. Slots are numbered from -2 downwards until
+ *  `expr_compile` renumbers them after the inputs. */
+static int expr_emit_node(expr_kernel_t *k, expr_t *e) {
+  int a, b;
+  if (e->emitted) {
+    return e->operand;
+  }
+  switch (e->op) {
+  case EXPR_LEAF:
+    e->operand = expr_input(k, e->v);
+    break;
+  case EXPR_MATVEC:
+    e->operand = expr_input(k, e->buffer);
+    break;
+  case EXPR_NORMALIZE:
+    e->operand = expr_emit(k, EXPR_SCALE, expr_input(k, e->buffer), 0, e->s,
+                           NULL);
+    break;
+  case EXPR_SCALE:
+  case EXPR_MAP:
+    a = expr_emit_node(k, e->a);
+    expr_drop(k, e->a);
+    e->operand = expr_emit(k, e->op, a, 0, e->s, e->fn);
+    break;
+  default:
+    a = expr_emit_node(k, e->a);
+    b = expr_emit_node(k, e->b);
+    expr_drop(k, e->a);
+    expr_drop(k, e->b);
+    e->operand = expr_emit(k, e->op, a, b, 0, NULL);
+    break;
+  }
+  e->emitted = true;
+  return e->operand;
+}
+
+/** Compiles the element-wise region rooted at `e` to write into `dst`. */
+static void expr_compile(expr_kernel_t *k, expr_t *e, vector_t *dst) {
+  int result;
+  size_t i, ninputs;
+  expr_count(e);
+  result = expr_emit_node(k, e);
+  e->emitted = false;
+  ninputs = k->ninputs;
+  if (result >= 0) {
+    result = expr_emit(k, EXPR_COPY, result, 0, 0, NULL);
+  }
+  k->code[k->ncode - 1].out = -1;
+  for (i = 0; i < k->ncode; i++) {
+    if (k->code[i].a <= -2) {
+      k->code[i].a = (int)ninputs - 2 - k->code[i].a;
+    }
+    if (k->code[i].b <= -2) {
+      k->code[i].b = (int)ninputs - 2 - k->code[i].b;
+    }
+    if (k->code[i].out <= -2) {
+      k->code[i].out = (int)ninputs - 2 - k->code[i].out;
+    }
+  }
+  k->inputs = malloc(sizeof(double *) * (ninputs > 0 ? ninputs : 1));
+  CHECK_MEMORY(k->inputs);
+  for (i = 0; i < ninputs; i++) {
+    k->inputs[i] = DATA(k->input_vectors[i]);
+  }
+  k->dst = DATA(dst);
+  k->length = dst->length;
+}
+
+/** Runs chunks [begin, end) of a fused kernel. */
+static void expr_kernel_range(void *ctx, size_t begin, size_t end) {
+  const expr_kernel_t *k = ctx;
+  double *scratch = malloc(sizeof(double) * EXPR_CHUNK *
+                           (k->nslots > 0 ? k->nslots : 1));
+  const expr_instr_t *instr;
+  const double *x, *y;
+  double *out;
+  size_t c, base, n, i, p;
+  CHECK_MEMORY(scratch);
+  for (c = begin; c < end; c++) {
+    base = c * EXPR_CHUNK;
+    n = base + EXPR_CHUNK < k->length ? EXPR_CHUNK : k->length - base;
+    for (p = 0; p < k->ncode; p++) {
+      instr = &k->code[p];
+      x = instr->a < (int)k->ninputs
+              ? k->inputs[instr->a] + base
+              : scratch + (instr->a - k->ninputs) * EXPR_CHUNK;
+      y = instr->b < (int)k->ninputs
+              ? k->inputs[instr->b] + base
+              : scratch + (instr->b - k->ninputs) * EXPR_CHUNK;
+      out = instr->out < 0 ? k->dst + base
+                           : scratch + (instr->out - k->ninputs) * EXPR_CHUNK;
+      switch (instr->op) {
+      case EXPR_ADD:
+        for (i = 0; i < n; i++) {
+          out[i] = x[i] + y[i];
+        }
+        break;
+      case EXPR_SUB:
+        for (i = 0; i < n; i++) {
+          out[i] = x[i] - y[i];
+        }
+        break;
+      case EXPR_MUL:
+        for (i = 0; i < n; i++) {
+          out[i] = x[i] * y[i];
+        }
+        break;
+      case EXPR_SCALE:
+        for (i = 0; i < n; i++) {
+          out[i] = instr->s * x[i];
+        }
+        break;
+      case EXPR_MAP:
+        for (i = 0; i < n; i++) {
+          out[i] = instr->fn(x[i]);
+        }
+        break;
+      default:
+        for (i = 0; i < n; i++) {
+          out[i] = x[i];
+        }
+        break;
+      }
+    }
+  }
+  free(scratch);
+}
+
+/** Evaluates the element-wise region rooted at `e` into `dst` in one pass. */
+static void expr_run(expr_t *e, vector_t *dst) {
+  expr_kernel_t k = {0};
+  size_t nchunks = (dst->length + EXPR_CHUNK - 1) / EXPR_CHUNK;
+  expr_compile(&k, e, dst);
+  if (parallel_should_split(dst->length, EXPR_PARALLEL_THRESHOLD)) {
+    parallel_for(nchunks, expr_kernel_range, &k);
+  } else {
+    expr_kernel_range(&k, 0, nchunks);
+  }
+  free(k.code);
+  free(k.inputs);
+  free(k.input_vectors);
+  free(k.slot_used);
+}
+
+static void expr_prepare(expr_graph_t *g, expr_t *e);
+
+/** Releases the buffers of the barriers read by the region rooted at `e`
+ *  that have no other consumer. Shared nodes may still be emitted by
+ *  another region, so the barriers below them are kept until the end of
+ *  the evaluation. */
+static void expr_consume(expr_graph_t *g, expr_t *e) {
+  if (e == NULL || e->op == EXPR_LEAF || e->uses > 1) {
+    return;
+  }
+  if (e->op == EXPR_NORMALIZE || e->op == EXPR_MATVEC) {
+    if (e->uses <= 1 && e->pooled) {
+      expr_release(g, e->buffer);
+      e->buffer = NULL;
+      e->pooled = false;
+    }
+    return;
+  }
+  expr_consume(g, e->a);
+  expr_consume(g, e->b);
+}
+
+/** Evaluates the operand of barrier `e` into a whole vector: the leaf
+ *  itself if it is one, otherwise a pooled temporary. */
+static vector_t *expr_operand(expr_graph_t *g, expr_t *e, bool *pooled) {
+  vector_t *t;
+  expr_prepare(g, e->a);
+  if (e->a->op == EXPR_LEAF) {
+    *pooled = false;
+    return e->a->v;
+  }
+  if (e->a->op == EXPR_MATVEC && e->a->uses <= 1) {
+    *pooled = e->a->pooled;
+    e->a->pooled = false;
+    return e->a->buffer;
+  }
+  t = expr_acquire(g, e->a->length);
+  expr_run(e->a, t);
+  expr_consume(g, e->a);
+  *pooled = true;
+  return t;
+}
+
+/** Computes the whole-vector values of every barrier below `e`. */
+static void expr_prepare(expr_graph_t *g, expr_t *e) {
+  vector_t *t;
+  bool pooled;
+  double norm;
+  if (e == NULL || e->op == EXPR_LEAF || e->buffer != NULL || e->prepared) {
+    return;
+  }
+  if (e->op == EXPR_NORMALIZE) {
+    e->buffer = expr_operand(g, e, &e->pooled);
+    norm = vector_norm(e->buffer);
+    e->s = 1 / norm;
+  } else if (e->op == EXPR_MATVEC) {
+    t = expr_operand(g, e, &pooled);
+    e->buffer = expr_acquire(g, e->m->nrows);
+    e->pooled = true;
+    if (e->m->order == MATRIX_COL_MAJOR) {
+      kernel_gemv_t(DATA(e->buffer), DATA(e->m), e->m->ld, DATA(t),
+                    e->m->ncols, e->m->nrows);
+    } else {
+      kernel_gemv(DATA(e->buffer), DATA(e->m), e->m->ld, DATA(t),
+                  e->m->nrows, e->m->ncols, tune_params()->gemv_block);
+    }
+    if (pooled) {
+      expr_release(g, t);
+    }
+  } else {
+    e->prepared = true;
+    expr_prepare(g, e->a);
+    expr_prepare(g, e->b);
+  }
+}
+
+/** Forgets every barrier value after an evaluation. */
+static void expr_reset(expr_graph_t *g) {
+  size_t i;
+  for (i = 0; i < g->nnodes; i++) {
+    if (g->nodes[i]->pooled) {
+      expr_release(g, g->nodes[i]->buffer);
+    }
+    g->nodes[i]->buffer = NULL;
+    g->nodes[i]->pooled = false;
+    g->nodes[i]->prepared = false;
+  }
+}
+
+void expr_eval_into(expr_graph_t *g, expr_t *e, vector_t *dst) {
+  double norm;
+  vector_materialize(dst);
+  TRACE_BEGIN(dst->length, 1);
+  if (e->op == EXPR_NORMALIZE) {
+    // Evaluate the operand straight into dst and scale it there.
+    expr_prepare(g, e->a);
+    expr_run(e->a, dst);
+    norm = vector_norm(dst);
+    vector_scalar_mul_into(dst, dst, 1 / norm);
+  } else {
+    expr_prepare(g, e);
+    expr_run(e, dst);
+  }
+  expr_reset(g);
+  TRACE_END();
+}
+
+vector_t *expr_eval(expr_graph_t *g, expr_t *e) {
+  vector_t *v = vector_new(e->length);
+  expr_eval_into(g, e, v);
+  return v;
+}
@@ -0,0 +1,177 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+
+#include "linalg_fixed.h"
+
+/* Every loop bound below is the constant N, so with the unroll pragma each
+ * kernel compiles to straight-line code. */
+#if defined(__GNUC__) && !defined(__clang__)
+#define FIXED_UNROLL _Pragma("GCC unroll 8")
+#elif defined(__clang__)
+#define FIXED_UNROLL _Pragma("clang loop unroll(full)")
+#else
+#define FIXED_UNROLL
+#endif
+
+#define MATRIX_FIXED_DEFINE(N)                                               \
+  void matrix_mul_##N##x##N(double *c, const double *a, const double *b) {   \
+    int i, j, k;                                                             \
+    FIXED_UNROLL for (i = 0; i < N; i++) {                                   \
+      FIXED_UNROLL for (j = 0; j < N; j++) { c[i * N + j] = 0; }             \
+      FIXED_UNROLL for (k = 0; k < N; k++) {                                 \
+        FIXED_UNROLL for (j = 0; j < N; j++) {                               \
+          c[i * N + j] += a[i * N + k] * b[k * N + j];                       \
+        }                                                                    \
+      }                                                                      \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  void matrix_vector_mul_##N##x##N(double *y, const double *a,               \
+                                   const double *x) {                        \
+    int i, j;                                                                \
+    double sum;                                                              \
+    FIXED_UNROLL for (i = 0; i < N; i++) {                                   \
+      sum = 0;                                                               \
+      FIXED_UNROLL for (j = 0; j < N; j++) { sum += a[i * N + j] * x[j]; }   \
+      y[i] = sum;                                                            \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  void matrix_transpose_##N##x##N(double *a) {                               \
+    int i, j;                                                                \
+    double tmp;                                                              \
+    FIXED_UNROLL for (i = 0; i < N; i++) {                                   \
+      FIXED_UNROLL for (j = i + 1; j < N; j++) {                             \
+        tmp = a[i * N + j];                                                  \
+        a[i * N + j] = a[j * N + i];                                         \
+        a[j * N + i] = tmp;                                                  \
+      }                                                                      \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  double matrix_determinant_##N##x##N(const double *a) {                     \
+    double t[N * N];                                                         \
+    double det = 1, f, tmp;                                                  \
+    int i, j, k, p;                                                          \
+    FIXED_UNROLL for (i = 0; i < N * N; i++) { t[i] = a[i]; }                \
+    FIXED_UNROLL for (k = 0; k < N; k++) {                                   \
+      p = k;                                                                 \
+      for (i = k + 1; i < N; i++) {                                          \
+        if (fabs(t[i * N + k]) > fabs(t[p * N + k])) {                       \
+          p = i;                                                             \
+        }                                                                    \
+      }                                                                      \
+      if (t[p * N + k] == 0) {                                               \
+        return 0;                                                            \
+      }                                                                      \
+      if (p != k) {                                                          \
+        det = -det;                                                          \
+        FIXED_UNROLL for (j = 0; j < N; j++) {                               \
+          tmp = t[k * N + j];                                                \
+          t[k * N + j] = t[p * N + j];                                       \
+          t[p * N + j] = tmp;                                                \
+        }                                                                    \
+      }                                                                      \
+      det *= t[k * N + k];                                                   \
+      for (i = k + 1; i < N; i++) {                                          \
+        f = t[i * N + k] / t[k * N + k];                                     \
+        FIXED_UNROLL for (j = 0; j < N; j++) {                               \
+          t[i * N + j] -= f * t[k * N + j];                                  \
+        }                                                                    \
+      }                                                                      \
+    }                                                                        \
+    return det;                                                              \
+  }                                                                          \
+                                                                             \
+  bool matrix_inverse_##N##x##N(double *inv, const double *a) {              \
+    double t[N * N];                                                         \
+    double f, tmp;                                                           \
+    int i, j, k, p;                                                          \
+    FIXED_UNROLL for (i = 0; i < N; i++) {                                   \
+      FIXED_UNROLL for (j = 0; j < N; j++) {                                 \
+        t[i * N + j] = a[i * N + j];                                         \
+        inv[i * N + j] = i == j ? 1 : 0;                                     \
+      }                                                                      \
+    }                                                                        \
+    FIXED_UNROLL for (k = 0; k < N; k++) {                                   \
+      p = k;                                                                 \
+      for (i = k + 1; i < N; i++) {                                          \
+        if (fabs(t[i * N + k]) > fabs(t[p * N + k])) {                       \
+          p = i;                                                             \
+        }                                                                    \
+      }                                                                      \
+      if (t[p * N + k] == 0) {                                               \
+        return false;                                                        \
+      }                                                                      \
+      if (p != k) {                                                          \
+        FIXED_UNROLL for (j = 0; j < N; j++) {                               \
+          tmp = t[k * N + j];                                                \
+          t[k * N + j] = t[p * N + j];                                       \
+          t[p * N + j] = tmp;                                                \
+          tmp = inv[k * N + j];                                              \
+          inv[k * N + j] = inv[p * N + j];                                   \
+          inv[p * N + j] = tmp;                                              \
+        }                                                                    \
+      }                                                                      \
+      f = 1 / t[k * N + k];                                                  \
+      FIXED_UNROLL for (j = 0; j < N; j++) {                                 \
+        t[k * N + j] *= f;                                                   \
+        inv[k * N + j] *= f;                                                 \
+      }                                                                      \
+      FIXED_UNROLL for (i = 0; i < N; i++) {                                 \
+        if (i != k) {                                                        \
+          f = t[i * N + k];                                                  \
+          FIXED_UNROLL for (j = 0; j < N; j++) {                             \
+            t[i * N + j] -= f * t[k * N + j];                                \
+            inv[i * N + j] -= f * inv[k * N + j];                            \
+          }                                                                  \
+        }                                                                    \
+      }                                                                      \
+    }                                                                        \
+    return true;                                                             \
+  }
+
+MATRIX_FIXED_DEFINE(2)
+MATRIX_FIXED_DEFINE(3)
+MATRIX_FIXED_DEFINE(4)
+MATRIX_FIXED_DEFINE(5)
+MATRIX_FIXED_DEFINE(6)
+MATRIX_FIXED_DEFINE(7)
+MATRIX_FIXED_DEFINE(8)
+
+static const matrix_fixed_mul_t fixed_mul[] = {
+    matrix_mul_2x2, matrix_mul_3x3, matrix_mul_4x4, matrix_mul_5x5,
+    matrix_mul_6x6, matrix_mul_7x7, matrix_mul_8x8};
+
+static const matrix_fixed_vector_mul_t fixed_vector_mul[] = {
+    matrix_vector_mul_2x2, matrix_vector_mul_3x3, matrix_vector_mul_4x4,
+    matrix_vector_mul_5x5, matrix_vector_mul_6x6, matrix_vector_mul_7x7,
+    matrix_vector_mul_8x8};
+
+static const matrix_fixed_transpose_t fixed_transpose[] = {
+    matrix_transpose_2x2, matrix_transpose_3x3, matrix_transpose_4x4,
+    matrix_transpose_5x5, matrix_transpose_6x6, matrix_transpose_7x7,
+    matrix_transpose_8x8};
+
+matrix_fixed_mul_t matrix_fixed_mul(size_t n) {
+  if (n < MATRIX_FIXED_MIN || n > MATRIX_FIXED_MAX) {
+    return NULL;
+  }
+  return fixed_mul[n - MATRIX_FIXED_MIN];
+}
+
+matrix_fixed_vector_mul_t matrix_fixed_vector_mul(size_t n) {
+  if (n < MATRIX_FIXED_MIN || n > MATRIX_FIXED_MAX) {
+    return NULL;
+  }
+  return fixed_vector_mul[n - MATRIX_FIXED_MIN];
+}
+
+matrix_fixed_transpose_t matrix_fixed_transpose(size_t n) {
+  if (n < MATRIX_FIXED_MIN || n > MATRIX_FIXED_MAX) {
+    return NULL;
+  }
+  return fixed_transpose[n - MATRIX_FIXED_MIN];
+}
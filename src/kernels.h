@@ -0,0 +1,108 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_KERNELS_H
+#define LINALG_KERNELS_H
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+
+/** Depth of the packed panel of `b`. */
+#ifndef KERNEL_GEMM_KC
+#define KERNEL_GEMM_KC 128
+#endif
+
+/** Width of the packed panel of `b`. */
+#ifndef KERNEL_GEMM_NC
+#define KERNEL_GEMM_NC 256
+#endif
+
+/** Edge length of the tiles swapped by the in-place transpose. */
+#ifndef KERNEL_TRANSPOSE_BLOCK
+#define KERNEL_TRANSPOSE_BLOCK 32
+#endif
+
+/** Number of columns the matrix-vector product sweeps at a time. */
+#ifndef KERNEL_GEMV_BLOCK
+#define KERNEL_GEMV_BLOCK 2048
+#endif
+
+/* These are compile-time defaults; the values in use come from
+ * `tune_params`. */
+
+/* Raw row-major kernels shared between translation units. Every operand is
+ * a pointer to its first element plus a leading dimension. */
+
+/** Overwrites the m x n block `c` with the product of `a` (m x k) and `b`
+ * (k x n). */
+void kernel_gemm(double* c, size_t ldc, const double* a, size_t lda,
+                 const double* b, size_t ldb, size_t m, size_t k, size_t n);
+
+/** Like `kernel_gemm`, but streams `b` through a packed kc x nc panel.
+ *
+ *  The panel is copied into `pack`, which must hold `kc * nc` doubles, so
+ *  that each row of `a` sweeps a contiguous block of `b` that stays in
+ *  cache.
+ */
+void kernel_gemm_packed(double* c, size_t ldc, const double* a, size_t lda,
+                        const double* b, size_t ldb, size_t m, size_t k,
+                        size_t n, size_t kc, size_t nc, double* pack);
+/** c = alpha * a * b + beta * c, packed like `kernel_gemm_packed`, with
+ *  operands of any storage order: element (i, p) of `a` is
+ *  `a[i * ars + p * acs]` and likewise for `b`. `c` is row-major. With
+ *  `beta == 0` the initial contents of `c` are ignored. */
+void kernel_gemm_strided(double* c, size_t ldc, const double* a, size_t ars,
+                         size_t acs, const double* b, size_t brs, size_t bcs,
+                         size_t m, size_t k, size_t n, double alpha,
+                         double beta, size_t kc, size_t nc, double* pack);
+/** Returns the calling thread's packing buffer, holding at least `size`
+ *  doubles.
+ *
+ *  The buffer is allocated on first use and reused by every later product
+ *  on the same thread, growing when a larger panel is requested. It is
+ *  freed when the thread exits.
+ */
+double* kernel_pack_buffer(size_t size);
+/** Transposes the n x n block `a` within its own storage, swapping
+ *  `block` x `block` tiles. */
+void kernel_transpose_square(double* a, size_t lda, size_t n, size_t block);
+/** Writes the transpose of the m x n block `a` into the n x m block `b`,
+ *  copying `block` x `block` tiles. */
+void kernel_transpose_copy(double* b, size_t ldb, const double* a,
+                           size_t lda, size_t m, size_t n, size_t block);
+/** y = a * x with `a` m x n, summing `block` columns at a time so that the
+ *  segment of `x` in use stays in cache. */
+void kernel_gemv(double* y, const double* a, size_t lda, const double* x,
+                 size_t m, size_t n, size_t block);
+/** y = a^T * x with `a` m x n, adding one scaled row of `a` at a time. */
+void kernel_gemv_t(double* y, const double* a, size_t lda, const double* x,
+                   size_t m, size_t n);
+
+/** Overwrites the lower triangle of the n x n block `a` with its Cholesky
+ *  factor, returning false if `a` is not positive definite. */
+bool kernel_potrf(double* a, size_t lda, size_t n);
+/** b = b * l^-T with `l` (n x n) lower triangular and `b` m x n. */
+void kernel_trsm_rlt(double* b, size_t ldb, const double* l, size_t ldl,
+                     size_t m, size_t n);
+/** Lower triangle of c -= a * a^T with `c` n x n and `a` n x k. */
+void kernel_syrk_ln(double* c, size_t ldc, const double* a, size_t lda,
+                    size_t n, size_t k);
+/** c -= a * b^T with `c` m x n, `a` m x k and `b` n x k. */
+void kernel_gemm_nt(double* c, size_t ldc, const double* a, size_t lda,
+                    const double* b, size_t ldb, size_t m, size_t n, size_t k);
+
+/** Cholesky-factors the n x n matrix at `a` as a graph of tile tasks.
+ *
+ *  Tile (i, j) starts at `a + i * row_stride + j * col_stride` and has
+ *  leading dimension `ld`, which covers both row-major and tile-major
+ *  storage. Only the lower triangle is referenced. Returns false if the
+ *  matrix is not positive definite.
+ */
+bool kernel_cholesky_tiles(double* a, size_t ld, size_t row_stride,
+                           size_t col_stride, size_t n, size_t tile);
+/** c += a * b with `c` m x n, `a` m x k and `b` k x n. */
+void kernel_gemm_acc(double* c, size_t ldc, const double* a, size_t lda,
+                     const double* b, size_t ldb, size_t m, size_t k,
+                     size_t n);
+
+#endif
@@ -0,0 +1,182 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_MAP_H
+#define LINALG_MAP_H
+
+#include <math.h>     // copysign, fabs, HUGE_VAL, NAN
+#include <stdbool.h>  // bool
+#include <stdint.h>   // uint64_t
+#include <string.h>   // memcpy
+
+/* Branch-free scalar approximations shared by the element-wise maps and the
+ * random fills. They are inlined into chunk loops, where the compiler can
+ * vectorize them (with -O3 and -fno-math-errno, see `make
+ * vectorize-check`), instead of calling libm element by element. Special
+ * cases are computed alongside the ordinary result and picked with
+ * selects, so every loop body is straight-line code. */
+
+#define MAP_LN2_HI 6.93147180369123816490e-01
+#define MAP_LN2_LO 1.90821492927058770002e-10
+#define MAP_LOG2E 1.44269504088896338700e+00
+/** 1.5 * 2^52: adding and subtracting it rounds to the nearest integer,
+ *  which ends up in the low bits of the sum. */
+#define MAP_ROUND 6755399441055744.0
+/** 2^52: OR-ing a small integer into its mantissa converts it exactly. */
+#define MAP_TWO52 4503599627370496.0
+#define MAP_EXP_MAX 709.782712893384
+#define MAP_EXP_MIN -708.3964185322641
+
+static inline double map_from_bits(uint64_t bits) {
+  double x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+static inline uint64_t map_to_bits(double x) {
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+/** `c ? a : b` as bit operations. Plain conditionals let the compiler
+ *  skip computing the arm it does not need, which turns the loop body into
+ *  control flow that cannot be vectorized while FP operations may trap. */
+static inline double map_select(bool c, double a, double b) {
+  uint64_t mask = -(uint64_t)c;
+  return map_from_bits((map_to_bits(a) & mask) | (map_to_bits(b) & ~mask));
+}
+
+/** 2^k for an integer-valued k in [-1022, 1023]. */
+static inline double map_pow2(double k) {
+  return map_from_bits((map_to_bits(k + MAP_ROUND) + 1023) << 52);
+}
+
+/** e^x by reduction to r = x - n ln2 with |r| <= ln2 / 2 and a degree 13
+ *  Taylor polynomial. Results below 2^-1022 are flushed to zero. */
+static inline double map_exp(double x) {
+  double c, n, h, r, p, y;
+  // Clamping keeps 2^n finite; NaN passes through both compares.
+  c = map_select(x > MAP_EXP_MAX, MAP_EXP_MAX, x);
+  c = map_select(c < MAP_EXP_MIN, MAP_EXP_MIN, c);
+  n = (c * MAP_LOG2E + MAP_ROUND) - MAP_ROUND;
+  r = (c - n * MAP_LN2_HI) - n * MAP_LN2_LO;
+  p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = 1.0 + p * r;
+  // 2^n is not representable at the top of the range, so scale in halves.
+  h = (n * 0.5 + MAP_ROUND) - MAP_ROUND;
+  y = p * map_pow2(h) * map_pow2(n - h);
+  y = map_select(x > MAP_EXP_MAX, HUGE_VAL, y);
+  return map_select(x < MAP_EXP_MIN, 0.0, y);
+}
+
+/** log(x) from x = m 2^e with m in [sqrt(1/2), sqrt(2)) and
+ *  log(m) = 2 atanh(s), s = f / (2 + f), f = m - 1, summed to s^19 and
+ *  rearranged as in fdlibm to keep the leading terms exact. */
+static inline double map_log(double x) {
+  uint64_t bits;
+  double a, m, f, hfsq, s, s2, r, e, y;
+  bool sub = x < 2.2250738585072014e-308;
+  a = map_select(sub, x * 18014398509481984.0, x); /* 2^54 */
+  bits = map_to_bits(a);
+  // The biased exponent, converted through the mantissa of 2^52; negative
+  // inputs get a garbage exponent that the selects below discard.
+  e = map_from_bits((bits >> 52) | map_to_bits(MAP_TWO52)) - MAP_TWO52 -
+      1023 - map_select(sub, 54, 0);
+  m = map_from_bits((bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL);
+  e = map_select(m > 1.4142135623730951, e + 1, e);
+  m = map_select(m > 1.4142135623730951, m * 0.5, m);
+  f = m - 1;
+  hfsq = 0.5 * f * f;
+  s = f / (2 + f);
+  s2 = s * s;
+  r = 2.0 / 19.0;
+  r = r * s2 + 2.0 / 17.0;
+  r = r * s2 + 2.0 / 15.0;
+  r = r * s2 + 2.0 / 13.0;
+  r = r * s2 + 2.0 / 11.0;
+  r = r * s2 + 2.0 / 9.0;
+  r = r * s2 + 2.0 / 7.0;
+  r = r * s2 + 2.0 / 5.0;
+  r = r * s2 + 2.0 / 3.0;
+  r = r * s2;
+  y = e * MAP_LN2_HI + (f - (hfsq - (s * (hfsq + r) + e * MAP_LN2_LO)));
+  y = map_select(x < 0, NAN, y);
+  y = map_select(x == 0, -HUGE_VAL, y);
+  y = map_select(x == HUGE_VAL, x, y);
+  return map_select(x != x, x, y);
+}
+
+/** tanh(x) from its odd Taylor series below |x| = 0.3 and from
+ *  1 - 2 / (e^2|x| + 1) above, which rounds to 1 from |x| = 19.1. */
+static inline double map_tanh(double x) {
+  double a = fabs(x);
+  double x2, p, t;
+  x2 = x * x;
+  p = 18888466084.0 / 194896477400625.0;
+  p = p * x2 - 443861162.0 / 1856156927625.0;
+  p = p * x2 + 6404582.0 / 10854718875.0;
+  p = p * x2 - 929569.0 / 638512875.0;
+  p = p * x2 + 21844.0 / 6081075.0;
+  p = p * x2 - 1382.0 / 155925.0;
+  p = p * x2 + 62.0 / 2835.0;
+  p = p * x2 - 17.0 / 315.0;
+  p = p * x2 + 2.0 / 15.0;
+  p = p * x2 - 1.0 / 3.0;
+  t = copysign(1 - 2 / (map_exp(2 * a) + 1), x);
+  // The copysign keeps tanh(-0) = -0.
+  return map_select(a < 0.3, copysign(x + x * x2 * p, x), t);
+}
+
+static inline double map_sigmoid(double x) { return 1 / (1 + map_exp(-x)); }
+
+/** sin(2 pi t) and cos(2 pi t), from the quarter turn k nearest to 4t and
+ *  Taylor polynomials of degree 17 and 16 in x = (4t - k) pi / 2, where
+ *  |x| <= pi / 4. The quadrant is applied with selects. */
+static inline void map_sincos_turn(double t, double *sin_out,
+                                   double *cos_out) {
+  double k, x, x2, s, c, a, b;
+  uint64_t q;
+  k = (4 * t + MAP_ROUND) - MAP_ROUND;
+  // The low bits of k + 1.5 * 2^52 hold k modulo 4.
+  q = map_to_bits(k + MAP_ROUND);
+  x = (4 * t - k) * 1.57079632679489661923;
+  x2 = x * x;
+  s = -1.0 / 355687428096000.0;
+  s = s * x2 + 1.0 / 1307674368000.0;
+  s = s * x2 - 1.0 / 6227020800.0;
+  s = s * x2 + 1.0 / 39916800.0;
+  s = s * x2 - 1.0 / 362880.0;
+  s = s * x2 + 1.0 / 5040.0;
+  s = s * x2 - 1.0 / 120.0;
+  s = s * x2 + 1.0 / 6.0;
+  s = x - x * x2 * s;
+  c = 1.0 / 20922789888000.0;
+  c = c * x2 - 1.0 / 87178291200.0;
+  c = c * x2 + 1.0 / 479001600.0;
+  c = c * x2 - 1.0 / 3628800.0;
+  c = c * x2 + 1.0 / 40320.0;
+  c = c * x2 - 1.0 / 720.0;
+  c = c * x2 + 1.0 / 24.0;
+  c = c * x2 - 0.5;
+  c = 1.0 + x2 * c;
+  // Quarter turn q maps (sin, cos) to (s, c), (c, -s), (-s, -c), (-c, s).
+  a = map_select((q & 1) != 0, c, s);
+  b = map_select((q & 1) != 0, s, c);
+  *sin_out = map_select((q & 2) != 0, -a, a);
+  *cos_out = map_select(((q + 1) & 2) != 0, -b, b);
+}
+
+#endif
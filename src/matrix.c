@@ -0,0 +1,747 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "linalg_fixed.h"
+#include "linalg_matrix.h"
+#include "linalg_matrix_inline.h"
+#include "linalg_memory.h"
+#include "linalg_parallel.h"
+#include "linalg_trace.h"
+#include "linalg_tune.h"
+#include "linalg_util.h"
+
+size_t matrix_leading_dimension(size_t ncols) {
+  if (ncols >= MATRIX_PAD_STRIDE && ncols % MATRIX_PAD_STRIDE == 0) {
+    return ncols + MATRIX_PAD_LENGTH;
+  }
+  return ncols;
+}
+
+matrix_t *matrix_new(size_t nrows, size_t ncols) {
+  return matrix_new_padded(nrows, ncols, matrix_leading_dimension(ncols));
+}
+
+/** Returns the number of contiguous rows (columns) in `m`'s storage. */
+static size_t matrix_outer(const matrix_t *m) {
+  return m->order == MATRIX_COL_MAJOR ? m->ncols : m->nrows;
+}
+
+/** Returns the length of a contiguous row (column) of `m`. */
+static size_t matrix_inner(const matrix_t *m) {
+  return m->order == MATRIX_COL_MAJOR ? m->nrows : m->ncols;
+}
+
+static matrix_t *matrix_alloc(size_t nrows, size_t ncols, size_t ld,
+                              matrix_order_t order) {
+  matrix_t *m = malloc(sizeof(matrix_t));
+  CHECK_MEMORY(m);
+  m->nrows = nrows;
+  m->ncols = ncols;
+  m->ld = ld;
+  m->order = order;
+  DATA(m) = memory_alloc_data(matrix_outer(m), ld);
+  CHECK_MEMORY(DATA(m));
+  OWNS_MEMORY(m) = true;
+  COPY_ON_WRITE(m) = false;
+  MEMORY_OWNER(m) = NULL;
+  REF_COUNT_INIT(m);
+  memory_track_alloc((linalg_t *)m, "matrix",
+                     sizeof(matrix_t) +
+                         sizeof(double) * matrix_outer(m) * ld);
+  return m;
+}
+
+matrix_t *matrix_new_padded(size_t nrows, size_t ncols, size_t ld) {
+  return matrix_alloc(nrows, ncols, ld, MATRIX_ROW_MAJOR);
+}
+
+matrix_t *matrix_new_col_major(size_t nrows, size_t ncols) {
+  return matrix_alloc(nrows, ncols, matrix_leading_dimension(nrows),
+                      MATRIX_COL_MAJOR);
+}
+
+matrix_t *matrix_from_array(double *data, size_t nrows, size_t ncols) {
+  matrix_t *m = matrix_new(nrows, ncols);
+  size_t i, j;
+  for (i = 0; i < m->nrows; i++) {
+    for (j = 0; j < m->ncols; j++) {
+      DATA(m)[MATRIX_IDX_ROW(m, i, j)] = data[i * ncols + j];
+    }
+  }
+  return m;
+}
+
+matrix_t *matrix_from_2d_array(double **data, size_t nrows, size_t ncols) {
+  matrix_t *m = matrix_new(nrows, ncols);
+  size_t i, j;
+  for (i = 0; i < m->nrows; i++) {
+    for (j = 0; j < m->ncols; j++) {
+      DATA(m)[MATRIX_IDX_ROW(m, i, j)] = data[i][j];
+    }
+  }
+  return m;
+}
+
+matrix_t *matrix_from_col_major_array(double *data, size_t nrows,
+                                      size_t ncols) {
+  matrix_t *m = matrix_new_col_major(nrows, ncols);
+  size_t j;
+  for (j = 0; j < ncols; j++) {
+    memcpy(DATA(m) + j * m->ld, data + j * nrows, sizeof(double) * nrows);
+  }
+  return m;
+}
+
+/** Returns a view sharing `parent`'s data starting at `view`. */
+static matrix_t *matrix_view(linalg_t *parent, double *view, size_t nrows,
+                             size_t ncols, size_t ld, matrix_order_t order) {
+  matrix_t *m = malloc(sizeof(matrix_t));
+  CHECK_MEMORY(m);
+  DATA(m) = view;
+  m->nrows = nrows;
+  m->ncols = ncols;
+  m->ld = ld;
+  m->order = order;
+  OWNS_MEMORY(m) = false;
+  COPY_ON_WRITE(m) = false;
+  MEMORY_OWNER(m) = parent;
+  REF_COUNT_INIT(m);
+  REF_COUNT_INCREMENT(parent);
+  memory_track_alloc((linalg_t *)m, "matrix view", sizeof(matrix_t));
+  return m;
+}
+
+matrix_t *matrix_block_view(matrix_t *m, size_t i0, size_t j0, size_t nrows,
+                            size_t ncols) {
+  matrix_materialize(m);
+  return matrix_view((linalg_t *)m, &MATRIX_IDX_INTO(m, i0, j0), nrows, ncols,
+                     m->ld, m->order);
+}
+
+void matrix_free(matrix_t *m) {
+  double *data;
+  CHECK_REF_COUNT(m);
+  if (OWNS_MEMORY(m)) {
+    memory_track_free((linalg_t *)m, sizeof(matrix_t) + sizeof(double) *
+                                                           matrix_outer(m) *
+                                                           m->ld);
+    memory_free_data(DATA(m), matrix_outer(m) * m->ld);
+    free(m);
+  } else {
+    memory_track_free((linalg_t *)m, sizeof(matrix_t));
+    if (COPY_ON_WRITE(m)) {
+      data = memory_release_shared(MEMORY_OWNER(m));
+      if (data != NULL) {
+        memory_free_data(data, matrix_outer(m) * m->ld);
+      }
+    } else {
+      REF_COUNT_DECREMENT(MEMORY_OWNER(m));
+    }
+    free(m);
+  }
+}
+
+matrix_t *matrix_constant(size_t nrows, size_t ncols, double c) {
+  matrix_t *m = matrix_new(nrows, ncols);
+  size_t i, j;
+  TRACE_BEGIN(nrows, ncols);
+  for (i = 0; i < m->nrows; i++) {
+    for (j = 0; j < m->ncols; j++) {
+      DATA(m)[MATRIX_IDX_ROW(m, i, j)] = c;
+    }
+  }
+  TRACE_END();
+  return m;
+}
+
+matrix_t *matrix_zeros(size_t nrows, size_t ncols) {
+  return matrix_constant(nrows, ncols, 0);
+}
+
+matrix_t *matrix_ones(size_t nrows, size_t ncols) {
+  return matrix_constant(nrows, ncols, 1);
+}
+
+matrix_t *matrix_identity(size_t n) {
+  matrix_t *m = matrix_zeros(n, n);
+  size_t i;
+  for (i = 0; i < n; i++) {
+    DATA(m)[MATRIX_IDX_ROW(m, i, i)] = 1;
+  }
+  return m;
+}
+
+matrix_t *matrix_copy(matrix_t *m) {
+  matrix_t *copy;
+  linalg_t *shared;
+  // Data that views point into can change under a shared copy.
+  if (linalg_copy_on_write() &&
+      (COPY_ON_WRITE(m) || (OWNS_MEMORY(m) && REF_COUNT_LOAD(m) == 0))) {
+    shared = memory_share((linalg_t *)m, "matrix", sizeof(matrix_t),
+                          matrix_outer(m) * m->ld);
+    copy = matrix_view(shared, DATA(m), m->nrows, m->ncols, m->ld, m->order);
+    COPY_ON_WRITE(copy) = true;
+    return copy;
+  }
+  return matrix_copy_order(m, m->order);
+}
+
+matrix_t *matrix_copy_order(matrix_t *m, matrix_order_t order) {
+  matrix_t *copy = order == MATRIX_COL_MAJOR
+                       ? matrix_new_col_major(m->nrows, m->ncols)
+                       : matrix_new(m->nrows, m->ncols);
+  matrix_copy_into(copy, m);
+  return copy;
+}
+
+/** Copies `n` lines of `len` doubles between storages of equal order. */
+static void matrix_copy_lines(double *dst, size_t ldd, const double *src,
+                              size_t lds, size_t n, size_t len) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    memcpy(dst + i * ldd, src + i * lds, sizeof(double) * len);
+  }
+}
+
+void matrix_copy_into(matrix_t *dst, matrix_t *m) {
+  matrix_materialize(dst);
+  TRACE_BEGIN(m->nrows, m->ncols);
+  if (dst->order == m->order) {
+    matrix_copy_lines(DATA(dst), dst->ld, DATA(m), m->ld, matrix_outer(m),
+                      matrix_inner(m));
+  } else {
+    kernel_transpose_copy(DATA(dst), dst->ld, DATA(m), m->ld, matrix_outer(m),
+                          matrix_inner(m), tune_params()->transpose_block);
+  }
+  TRACE_END();
+}
+
+void matrix_materialize(matrix_t *m) {
+  size_t count = matrix_outer(m) * m->ld;
+  linalg_t *shared;
+  double *data, *last;
+  if (!COPY_ON_WRITE(m)) {
+    return;
+  }
+  shared = MEMORY_OWNER(m);
+  if (REF_COUNT_LOAD(shared) == 1) {
+    // The last holder keeps the buffer.
+    data = memory_release_shared(shared);
+  } else {
+    // Holders share their source's leading dimension, so the whole buffer
+    // is copied and `MATRIX_IDX` stays valid across the switch.
+    data = memory_alloc_data(matrix_outer(m), m->ld);
+    CHECK_MEMORY(data);
+    memcpy(data, DATA(m), sizeof(double) * count);
+    last = memory_release_shared(shared);
+    if (last != NULL) {
+      memory_free_data(last, count);
+    }
+  }
+  memory_track_free((linalg_t *)m, sizeof(matrix_t));
+  DATA(m) = data;
+  OWNS_MEMORY(m) = true;
+  COPY_ON_WRITE(m) = false;
+  MEMORY_OWNER(m) = NULL;
+  memory_track_alloc((linalg_t *)m, "matrix",
+                     sizeof(matrix_t) + sizeof(double) * count);
+}
+
+double *matrix_data_into(matrix_t *m) {
+  matrix_materialize(m);
+  return DATA(m);
+}
+
+vector_t *matrix_row_view(matrix_t *m, size_t row) {
+  if (m->order != MATRIX_ROW_MAJOR) {
+    raise_error(LINALG_LAYOUT_ERROR);
+  }
+  matrix_materialize(m);
+  return vector_view((linalg_t *)m, &MATRIX_IDX_INTO(m, row, 0), m->ncols);
+}
+
+vector_t *matrix_col_view(matrix_t *m, size_t col) {
+  if (m->order != MATRIX_COL_MAJOR) {
+    raise_error(LINALG_LAYOUT_ERROR);
+  }
+  matrix_materialize(m);
+  return vector_view((linalg_t *)m, &MATRIX_IDX_INTO(m, 0, col), m->nrows);
+}
+
+vector_t *matrix_row_copy(matrix_t *m, size_t row) {
+  vector_t *v = vector_new(m->ncols);
+  const double *src = DATA(m) + row * MATRIX_ROW_STRIDE(m);
+  size_t cs = MATRIX_COL_STRIDE(m);
+  size_t j;
+  for (j = 0; j < m->ncols; j++) {
+    DATA(v)[j] = src[j * cs];
+  }
+  return v;
+}
+
+vector_t *matrix_col_copy(matrix_t *m, size_t col) {
+  vector_t *v = vector_new(m->nrows);
+  const double *src = DATA(m) + col * MATRIX_COL_STRIDE(m);
+  size_t rs = MATRIX_ROW_STRIDE(m);
+  size_t i;
+  for (i = 0; i < m->nrows; i++) {
+    DATA(v)[i] = src[i * rs];
+  }
+  return v;
+}
+
+void matrix_copy_vector_into_row(matrix_t *m, vector_t *v, size_t row) {
+  size_t cs = MATRIX_COL_STRIDE(m);
+  size_t j;
+  double *dst;
+  matrix_materialize(m);
+  dst = DATA(m) + row * MATRIX_ROW_STRIDE(m);
+  for (j = 0; j < m->ncols; j++) {
+    dst[j * cs] = VECTOR_AT(v, j);
+  }
+}
+
+void matrix_copy_vector_into_col(matrix_t *m, vector_t *v, size_t col) {
+  size_t rs = MATRIX_ROW_STRIDE(m);
+  size_t i;
+  double *dst;
+  matrix_materialize(m);
+  dst = DATA(m) + col * MATRIX_COL_STRIDE(m);
+  for (i = 0; i < m->nrows; i++) {
+    dst[i * rs] = VECTOR_AT(v, i);
+  }
+}
+
+vector_t *matrix_diagonal(matrix_t *m) {
+  size_t n = m->nrows < m->ncols ? m->nrows : m->ncols;
+  vector_t *v = vector_new(n);
+  // Row and column strides add up to the same step in either order.
+  size_t step = m->ld + 1;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    DATA(v)[i] = DATA(m)[i * step];
+  }
+  return v;
+}
+
+void kernel_transpose_square(double *a, size_t lda, size_t n, size_t block) {
+  size_t ii, jj, i, j, iend, jend;
+  double tmp;
+  for (ii = 0; ii < n; ii += block) {
+    iend = ii + block < n ? ii + block : n;
+    for (jj = ii; jj < n; jj += block) {
+      jend = jj + block < n ? jj + block : n;
+      for (i = ii; i < iend; i++) {
+        for (j = (jj == ii ? i + 1 : jj); j < jend; j++) {
+          tmp = a[i * lda + j];
+          a[i * lda + j] = a[j * lda + i];
+          a[j * lda + i] = tmp;
+        }
+      }
+    }
+  }
+}
+
+void kernel_transpose_copy(double *b, size_t ldb, const double *a,
+                           size_t lda, size_t m, size_t n, size_t block) {
+  size_t ii, jj, i, j, iend, jend;
+  for (ii = 0; ii < m; ii += block) {
+    iend = ii + block < m ? ii + block : m;
+    for (jj = 0; jj < n; jj += block) {
+      jend = jj + block < n ? jj + block : n;
+      for (i = ii; i < iend; i++) {
+        for (j = jj; j < jend; j++) {
+          b[j * ldb + i] = a[i * lda + j];
+        }
+      }
+    }
+  }
+}
+
+void matrix_transpose(matrix_t *m) {
+  matrix_fixed_transpose_t fixed = matrix_fixed_transpose(m->nrows);
+  size_t block = tune_params()->transpose_block;
+  size_t outer, inner, ld, tmp;
+  double *data;
+  matrix_materialize(m);
+  TRACE_BEGIN(m->nrows, m->ncols);
+  if (m->nrows == m->ncols) {
+    // Transposing the storage transposes the matrix in either order.
+    if (fixed != NULL && m->ld == m->nrows) {
+      fixed(DATA(m));
+    } else {
+      kernel_transpose_square(DATA(m), m->ld, m->nrows, block);
+    }
+    TRACE_END();
+    return;
+  }
+  if (!OWNS_MEMORY(m)) {
+    raise_error(LINALG_VIEW_ERROR);
+  }
+  // Row and column views would be left pointing into the freed buffer.
+  CHECK_REF_COUNT(m);
+  outer = matrix_outer(m);
+  inner = matrix_inner(m);
+  ld = matrix_leading_dimension(outer);
+  data = memory_alloc_data(inner, ld);
+  CHECK_MEMORY(data);
+  kernel_transpose_copy(data, ld, DATA(m), m->ld, outer, inner, block);
+  memory_track_free((linalg_t *)m,
+                    sizeof(matrix_t) + sizeof(double) * outer * m->ld);
+  memory_free_data(DATA(m), outer * m->ld);
+  DATA(m) = data;
+  tmp = m->nrows;
+  m->nrows = m->ncols;
+  m->ncols = tmp;
+  m->ld = ld;
+  memory_track_alloc((linalg_t *)m, "matrix",
+                     sizeof(matrix_t) + sizeof(double) * inner * ld);
+  TRACE_END();
+}
+
+matrix_t *matrix_mul(matrix_t *m1, matrix_t *m2) {
+  matrix_t *m = m1->order == MATRIX_COL_MAJOR
+                    ? matrix_new_col_major(m1->nrows, m2->ncols)
+                    : matrix_new(m1->nrows, m2->ncols);
+  return matrix_mul_into(m, m1, m2);
+}
+
+void kernel_gemm(double *c, size_t ldc, const double *a, size_t lda,
+                 const double *b, size_t ldb, size_t m, size_t k, size_t n) {
+  size_t i, j, p;
+  double aip;
+  for (i = 0; i < m; i++) {
+    for (j = 0; j < n; j++) {
+      c[i * ldc + j] = 0;
+    }
+    for (p = 0; p < k; p++) {
+      aip = a[i * lda + p];
+      for (j = 0; j < n; j++) {
+        c[i * ldc + j] += aip * b[p * ldb + j];
+      }
+    }
+  }
+}
+
+void kernel_gemm_packed(double *c, size_t ldc, const double *a, size_t lda,
+                        const double *b, size_t ldb, size_t m, size_t k,
+                        size_t n, size_t kc, size_t nc, double *pack) {
+  size_t pc, jc, kb, nb, i, j, p;
+  double aip;
+  for (i = 0; i < m; i++) {
+    for (j = 0; j < n; j++) {
+      c[i * ldc + j] = 0;
+    }
+  }
+  for (pc = 0; pc < k; pc += kc) {
+    kb = pc + kc < k ? kc : k - pc;
+    for (jc = 0; jc < n; jc += nc) {
+      nb = jc + nc < n ? nc : n - jc;
+      for (p = 0; p < kb; p++) {
+        for (j = 0; j < nb; j++) {
+          pack[p * nb + j] = b[(pc + p) * ldb + jc + j];
+        }
+      }
+      for (i = 0; i < m; i++) {
+        for (p = 0; p < kb; p++) {
+          aip = a[i * lda + pc + p];
+          for (j = 0; j < nb; j++) {
+            c[i * ldc + jc + j] += aip * pack[p * nb + j];
+          }
+        }
+      }
+    }
+  }
+}
+
+void kernel_gemm_acc(double *c, size_t ldc, const double *a, size_t lda,
+                     const double *b, size_t ldb, size_t m, size_t k,
+                     size_t n) {
+  size_t i, j, p;
+  double aip;
+  for (i = 0; i < m; i++) {
+    for (p = 0; p < k; p++) {
+      aip = a[i * lda + p];
+      for (j = 0; j < n; j++) {
+        c[i * ldc + j] += aip * b[p * ldb + j];
+      }
+    }
+  }
+}
+
+void kernel_gemm_strided(double *c, size_t ldc, const double *a, size_t ars,
+                         size_t acs, const double *b, size_t brs, size_t bcs,
+                         size_t m, size_t k, size_t n, double alpha,
+                         double beta, size_t kc, size_t nc, double *pack) {
+  size_t pc, jc, kb, nb, i, j, p;
+  double a0, a1, *c0, *c1;
+  const double *row;
+  if (beta != 1) {
+    for (i = 0; i < m; i++) {
+      for (j = 0; j < n; j++) {
+        c[i * ldc + j] = beta == 0 ? 0 : beta * c[i * ldc + j];
+      }
+    }
+  }
+  for (pc = 0; pc < k; pc += kc) {
+    kb = pc + kc < k ? kc : k - pc;
+    for (jc = 0; jc < n; jc += nc) {
+      nb = jc + nc < n ? nc : n - jc;
+      // Read the panel along whichever dimension of b is contiguous.
+      if (bcs == 1) {
+        for (p = 0; p < kb; p++) {
+          for (j = 0; j < nb; j++) {
+            pack[p * nb + j] = b[(pc + p) * brs + jc + j];
+          }
+        }
+      } else {
+        for (j = 0; j < nb; j++) {
+          for (p = 0; p < kb; p++) {
+            pack[p * nb + j] = b[(pc + p) * brs + (jc + j) * bcs];
+          }
+        }
+      }
+      // Rows are taken in pairs so that each load of the panel feeds two
+      // rows of c. A column-major a is read down its columns; consecutive
+      // rows share the cache lines of the kb columns in use.
+      for (i = 0; i + 2 <= m; i += 2) {
+        c0 = c + i * ldc + jc;
+        c1 = c0 + ldc;
+        for (p = 0; p < kb; p++) {
+          a0 = alpha * a[i * ars + (pc + p) * acs];
+          a1 = alpha * a[(i + 1) * ars + (pc + p) * acs];
+          row = pack + p * nb;
+          for (j = 0; j < nb; j++) {
+            c0[j] += a0 * row[j];
+            c1[j] += a1 * row[j];
+          }
+        }
+      }
+      for (; i < m; i++) {
+        c0 = c + i * ldc + jc;
+        for (p = 0; p < kb; p++) {
+          a0 = alpha * a[i * ars + (pc + p) * acs];
+          row = pack + p * nb;
+          for (j = 0; j < nb; j++) {
+            c0[j] += a0 * row[j];
+          }
+        }
+      }
+    }
+  }
+}
+
+/* The key's destructor frees a thread's packing buffer when the thread
+ * exits, which covers pool workers and stream workers alike. */
+static pthread_key_t kernel_pack_key;
+static pthread_once_t kernel_pack_once = PTHREAD_ONCE_INIT;
+
+static void kernel_pack_key_create(void) {
+  if (pthread_key_create(&kernel_pack_key, free) != 0) {
+    raise_error(LINALG_UNKNOWN_ERROR);
+  }
+}
+
+double *kernel_pack_buffer(size_t size) {
+  static _Thread_local double *pack = NULL;
+  static _Thread_local size_t capacity = 0;
+  if (size > capacity) {
+    free(pack);
+    pack = malloc(sizeof(double) * size);
+    CHECK_MEMORY(pack);
+    capacity = size;
+    pthread_once(&kernel_pack_once, kernel_pack_key_create);
+    pthread_setspecific(kernel_pack_key, pack);
+  }
+  return pack;
+}
+
+void kernel_gemv(double *y, const double *a, size_t lda, const double *x,
+                 size_t m, size_t n, size_t block) {
+  size_t i, j, j0, j1;
+  double sum;
+  for (i = 0; i < m; i++) {
+    y[i] = 0;
+  }
+  for (j0 = 0; j0 < n; j0 += block) {
+    j1 = j0 + block < n ? j0 + block : n;
+    for (i = 0; i < m; i++) {
+      sum = 0;
+      for (j = j0; j < j1; j++) {
+        sum += a[i * lda + j] * x[j];
+      }
+      y[i] += sum;
+    }
+  }
+}
+
+void kernel_gemv_t(double *y, const double *a, size_t lda, const double *x,
+                   size_t m, size_t n) {
+  size_t i, j;
+  double xj;
+  for (i = 0; i < n; i++) {
+    y[i] = 0;
+  }
+  for (j = 0; j < m; j++) {
+    xj = x[j];
+    for (i = 0; i < n; i++) {
+      y[i] += a[j * lda + i] * xj;
+    }
+  }
+}
+
+/** Returns true if `m` is packed, square and of size `n`. */
+static bool matrix_is_packed_square(matrix_t *m, size_t n) {
+  return m->nrows == n && m->ncols == n && m->ld == n;
+}
+
+/** Returns the strides between rows and between columns of `m`. */
+static void matrix_strides(const matrix_t *m, size_t *rs, size_t *cs) {
+  *rs = MATRIX_ROW_STRIDE(m);
+  *cs = MATRIX_COL_STRIDE(m);
+}
+
+/** Multiplies with a fixed-size kernel for small packed squares and with the
+ *  packed kernel once `b` outgrows a single panel.
+ *
+ *  A column-major `dst` is computed as `m2^T * m1^T`, whose storage is
+ *  row-major, so that the kernels only ever write row-major blocks. If the
+ *  operands are then both row-major in storage the row-major kernels run
+ *  unchanged; otherwise the strided kernel reads them as they are.
+ */
+static void matrix_mul_kernel(matrix_t *dst, matrix_t *m1, matrix_t *m2) {
+  matrix_fixed_mul_t fixed = matrix_fixed_mul(m1->nrows);
+  const tune_params_t *params = tune_params();
+  const double *a = DATA(m1), *b = DATA(m2), *t;
+  size_t m = m1->nrows, k = m1->ncols, n = m2->ncols;
+  size_t ars, acs, brs, bcs, tmp;
+  double *pack;
+  matrix_strides(m1, &ars, &acs);
+  matrix_strides(m2, &brs, &bcs);
+  if (dst->order == MATRIX_COL_MAJOR) {
+    t = a;
+    a = b;
+    b = t;
+    tmp = ars;
+    ars = bcs;
+    bcs = tmp;
+    tmp = acs;
+    acs = brs;
+    brs = tmp;
+    tmp = m;
+    m = n;
+    n = tmp;
+  }
+  if (acs != 1 || bcs != 1) {
+    pack = kernel_pack_buffer(params->gemm_kc * params->gemm_nc);
+    kernel_gemm_strided(DATA(dst), dst->ld, a, ars, acs, b, brs, bcs, m, k, n,
+                        1, 0, params->gemm_kc, params->gemm_nc, pack);
+  } else if (fixed != NULL && matrix_is_packed_square(m1, m1->nrows) &&
+             matrix_is_packed_square(m2, m1->nrows) &&
+             matrix_is_packed_square(dst, m1->nrows)) {
+    fixed(DATA(dst), a, b);
+  } else if (k > params->gemm_kc || n > params->gemm_nc) {
+    kernel_gemm_packed(DATA(dst), dst->ld, a, ars, b, brs, m, k, n,
+                       params->gemm_kc, params->gemm_nc,
+                       kernel_pack_buffer(params->gemm_kc * params->gemm_nc));
+  } else {
+    kernel_gemm(DATA(dst), dst->ld, a, ars, b, brs, m, k, n);
+  }
+}
+
+matrix_t *matrix_mul_into(matrix_t *dst, matrix_t *m1, matrix_t *m2) {
+  matrix_materialize(dst);
+  TRACE_BEGIN(m1->nrows, m2->ncols);
+  matrix_mul_kernel(dst, m1, m2);
+  TRACE_END();
+  return dst;
+}
+
+/** Operands of a batched product. */
+typedef struct {
+  matrix_t **dst;
+  matrix_t **m1;
+  matrix_t **m2;
+} matrix_batch_t;
+
+static void matrix_mul_batch_range(void *ctx, size_t begin, size_t end) {
+  matrix_batch_t *batch = ctx;
+  size_t i;
+  for (i = begin; i < end; i++) {
+    matrix_mul_into(batch->dst[i], batch->m1[i], batch->m2[i]);
+  }
+}
+
+void matrix_mul_batch_into(matrix_t **dst, matrix_t **m1, matrix_t **m2,
+                           size_t count) {
+  matrix_batch_t batch;
+  batch.dst = dst;
+  batch.m1 = m1;
+  batch.m2 = m2;
+  // Initializes the block sizes here rather than inside a worker.
+  tune_params();
+  parallel_for_dynamic(count, 1, matrix_mul_batch_range, &batch);
+}
+
+vector_t *matrix_vector_mul(matrix_t *m, vector_t *v) {
+  vector_t *res = vector_new(m->nrows);
+  matrix_fixed_vector_mul_t fixed = matrix_fixed_vector_mul(m->nrows);
+  TRACE_BEGIN(m->nrows, m->ncols);
+  if (m->order == MATRIX_COL_MAJOR) {
+    kernel_gemv_t(DATA(res), DATA(m), m->ld, DATA(v), m->ncols, m->nrows);
+    TRACE_END();
+    return res;
+  }
+  if (fixed != NULL && matrix_is_packed_square(m, m->nrows)) {
+    fixed(DATA(res), DATA(m), DATA(v));
+    TRACE_END();
+    return res;
+  }
+  kernel_gemv(DATA(res), DATA(m), m->ld, DATA(v), m->nrows, m->ncols,
+              tune_params()->gemv_block);
+  TRACE_END();
+  return res;
+}
+
+bool matrix_is_upper_triangular(matrix_t *m, double tol) {
+  size_t rs = MATRIX_ROW_STRIDE(m), cs = MATRIX_COL_STRIDE(m);
+  size_t i, j;
+  for (i = 1; i < m->nrows; i++) {
+    for (j = 0; j < i && j < m->ncols; j++) {
+      if (fabs(DATA(m)[i * rs + j * cs]) > tol) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+char *matrix_to_string(matrix_t *m) {
+  vector_t *row;
+  char *row_str;
+  char *str = malloc(3);
+  size_t len = 1;
+  size_t i;
+  CHECK_MEMORY(str);
+  strcpy(str, "[");
+  for (i = 0; i < m->nrows; i++) {
+    row = matrix_row_copy(m, i);
+    row_str = vector_to_string(row);
+    len += strlen(row_str) + 2;
+    str = realloc(str, len + 2);
+    CHECK_MEMORY(str);
+    strcat(str, row_str);
+    if (i != m->nrows - 1) {
+      strcat(str, ", ");
+    }
+    free(row_str);
+    vector_free(row);
+  }
+  strcat(str, "]");
+  return str;
+}
@@ -0,0 +1,415 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "linalg_memory.h"
+#include "linalg_numa.h"
+#include "linalg_util.h"
+
+#define MEMORY_RECORD_BUCKETS 1024
+#define MEMORY_MAPPING_BUCKETS 64
+
+/** A live object, recorded only while the leak report is enabled. */
+typedef struct memory_record_t {
+  linalg_t *obj;
+  const char *kind;
+  size_t bytes;
+  const char *file;
+  int line;
+  struct memory_record_t *next;
+} memory_record_t;
+
+static atomic_size_t memory_live_objects = 0;
+static atomic_size_t memory_live_bytes = 0;
+static atomic_size_t memory_peak_bytes = 0;
+static atomic_size_t memory_allocations = 0;
+static _Atomic double memory_epoch = 0.0;
+
+static _Thread_local memory_thread_stats_t memory_local;
+static _Thread_local const char *memory_callsite_file = NULL;
+static _Thread_local int memory_callsite_line = 0;
+
+static atomic_bool memory_copy_on_write = false;
+static atomic_bool memory_recording = false;
+static pthread_mutex_t memory_records_lock = PTHREAD_MUTEX_INITIALIZER;
+static memory_record_t *memory_records[MEMORY_RECORD_BUCKETS];
+
+static double memory_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec * 1.0e-9;
+}
+
+static size_t memory_bucket(linalg_t *obj) {
+  return ((uintptr_t)obj >> 4) % MEMORY_RECORD_BUCKETS;
+}
+
+static void memory_record(linalg_t *obj, const char *kind, size_t bytes) {
+  memory_record_t *r = malloc(sizeof(memory_record_t));
+  size_t b = memory_bucket(obj);
+  CHECK_MEMORY(r);
+  r->obj = obj;
+  r->kind = kind;
+  r->bytes = bytes;
+  r->file = memory_callsite_file;
+  r->line = memory_callsite_line;
+  pthread_mutex_lock(&memory_records_lock);
+  r->next = memory_records[b];
+  memory_records[b] = r;
+  pthread_mutex_unlock(&memory_records_lock);
+}
+
+static void memory_unrecord(linalg_t *obj) {
+  memory_record_t **r;
+  memory_record_t *found;
+  pthread_mutex_lock(&memory_records_lock);
+  for (r = &memory_records[memory_bucket(obj)]; *r != NULL; r = &(*r)->next) {
+    if ((*r)->obj == obj) {
+      found = *r;
+      *r = found->next;
+      free(found);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&memory_records_lock);
+}
+
+/** A buffer mapped directly, for huge pages or NUMA placement. */
+typedef struct memory_mapping_t {
+  double *data;
+  size_t length;
+  /** Whether huge pages were requested for it. */
+  bool huge;
+  struct memory_mapping_t *next;
+} memory_mapping_t;
+
+/** Data shared by copy-on-write copies. */
+typedef struct {
+  linalg_t obj;
+  size_t count;
+} memory_shared_t;
+
+static pthread_mutex_t memory_share_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t memory_huge_once = PTHREAD_ONCE_INIT;
+static atomic_size_t memory_huge_threshold = SIZE_MAX;
+static atomic_size_t memory_huge_bytes = 0;
+static pthread_mutex_t memory_mappings_lock = PTHREAD_MUTEX_INITIALIZER;
+static memory_mapping_t *memory_mappings[MEMORY_MAPPING_BUCKETS];
+
+static void memory_huge_init(void) {
+  const char *env = getenv("LINALG_HUGE_PAGE_THRESHOLD");
+  if (env != NULL) {
+    atomic_store(&memory_huge_threshold, (size_t)strtoull(env, NULL, 10));
+  }
+}
+
+size_t memory_set_huge_page_threshold(size_t bytes) {
+  pthread_once(&memory_huge_once, memory_huge_init);
+  return atomic_exchange(&memory_huge_threshold, bytes);
+}
+
+static size_t memory_mapping_bucket(const double *data) {
+  return ((uintptr_t)data / MEMORY_HUGE_PAGE_SIZE) % MEMORY_MAPPING_BUCKETS;
+}
+
+/** Maps `bytes` bytes on huge pages, or returns NULL. */
+static double *memory_map_huge(size_t bytes, size_t *length) {
+  size_t slack;
+  char *base, *data;
+  *length = (bytes + MEMORY_HUGE_PAGE_SIZE - 1) / MEMORY_HUGE_PAGE_SIZE *
+            MEMORY_HUGE_PAGE_SIZE;
+#ifdef MAP_HUGETLB
+  data = mmap(NULL, *length, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (data != MAP_FAILED) {
+    return (double *)data;
+  }
+#endif
+  // Without reserved pages, align the mapping so that the kernel can back
+  // all of it with transparent huge pages, then trim the slack.
+  base = mmap(NULL, *length + MEMORY_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  slack = (MEMORY_HUGE_PAGE_SIZE - (uintptr_t)base % MEMORY_HUGE_PAGE_SIZE) %
+          MEMORY_HUGE_PAGE_SIZE;
+  data = base + slack;
+  if (slack > 0) {
+    munmap(base, slack);
+  }
+  munmap(data + *length, MEMORY_HUGE_PAGE_SIZE - slack);
+#ifdef MADV_HUGEPAGE
+  madvise(data, *length, MADV_HUGEPAGE);
+#endif
+  return (double *)data;
+}
+
+/** Records `data` so that `memory_free_data` unmaps it. */
+static void memory_add_mapping(double *data, size_t length, bool huge) {
+  memory_mapping_t *mapping = malloc(sizeof(memory_mapping_t));
+  size_t b = memory_mapping_bucket(data);
+  CHECK_MEMORY(mapping);
+  mapping->data = data;
+  mapping->length = length;
+  mapping->huge = huge;
+  pthread_mutex_lock(&memory_mappings_lock);
+  mapping->next = memory_mappings[b];
+  memory_mappings[b] = mapping;
+  pthread_mutex_unlock(&memory_mappings_lock);
+  if (huge) {
+    atomic_fetch_add_explicit(&memory_huge_bytes, length,
+                              memory_order_relaxed);
+  }
+}
+
+double *memory_alloc_data(size_t rows, size_t row_length) {
+  size_t bytes = sizeof(double) * rows * row_length;
+  size_t length = bytes;
+  bool huge;
+  double *data = NULL;
+  if (bytes < MEMORY_MMAP_THRESHOLD) {
+    return malloc(bytes);
+  }
+  pthread_once(&memory_huge_once, memory_huge_init);
+  huge = bytes >= atomic_load_explicit(&memory_huge_threshold,
+                                       memory_order_relaxed);
+  // Without huge pages or a placement to apply, malloc keeps reusing freed
+  // buffers instead of faulting in fresh pages on every allocation.
+  if (!huge && numa_policy() == NUMA_DEFAULT) {
+    return malloc(bytes);
+  }
+  if (huge) {
+    data = memory_map_huge(bytes, &length);
+  }
+  if (data == NULL) {
+    huge = false;
+    length = bytes;
+    // Mapped directly so that the policy applies to pages of this buffer
+    // only.
+    data = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+      return NULL;
+    }
+  }
+  memory_add_mapping(data, length, huge);
+  numa_place(data, rows, row_length);
+  return data;
+}
+
+void memory_free_data(double *data, size_t count) {
+  memory_mapping_t **m;
+  memory_mapping_t *found = NULL;
+  if (sizeof(double) * count < MEMORY_MMAP_THRESHOLD || data == NULL) {
+    free(data);
+    return;
+  }
+  pthread_mutex_lock(&memory_mappings_lock);
+  for (m = &memory_mappings[memory_mapping_bucket(data)]; *m != NULL;
+       m = &(*m)->next) {
+    if ((*m)->data == data) {
+      found = *m;
+      *m = found->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&memory_mappings_lock);
+  if (found == NULL) {
+    free(data);
+    return;
+  }
+  if (found->huge) {
+    atomic_fetch_sub_explicit(&memory_huge_bytes, found->length,
+                              memory_order_relaxed);
+  }
+  munmap(data, found->length);
+  free(found);
+}
+
+/** Returns the bytes of huge-page buffers backed by huge pages, read from
+ *  the AnonHugePages and *_Hugetlb fields of /proc/self/smaps. */
+static size_t memory_huge_resident(void) {
+  char line[256];
+  unsigned long start, end, kb;
+  memory_mapping_t *m;
+  bool ours = false;
+  size_t resident = 0;
+  FILE *f = fopen("/proc/self/smaps", "r");
+  if (f == NULL) {
+    return 0;
+  }
+  pthread_mutex_lock(&memory_mappings_lock);
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+      ours = false;
+      for (m = memory_mappings[memory_mapping_bucket((double *)start)];
+           m != NULL; m = m->next) {
+        if ((uintptr_t)m->data == start) {
+          ours = m->huge;
+          break;
+        }
+      }
+    } else if (ours && (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+                        sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1 ||
+                        sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1)) {
+      resident += (size_t)kb * 1024;
+    }
+  }
+  pthread_mutex_unlock(&memory_mappings_lock);
+  fclose(f);
+  return resident;
+}
+
+linalg_t *memory_share(linalg_t *obj, const char *kind, size_t header,
+                       size_t count) {
+  memory_shared_t *shared;
+  linalg_t *owner;
+  // Concurrent copies of the same source must agree on one buffer.
+  pthread_mutex_lock(&memory_share_lock);
+  if (!COPY_ON_WRITE(obj)) {
+    shared = malloc(sizeof(memory_shared_t));
+    CHECK_MEMORY(shared);
+    DATA(shared) = DATA(obj);
+    shared->count = count;
+    OWNS_MEMORY(shared) = true;
+    COPY_ON_WRITE(shared) = false;
+    MEMORY_OWNER(shared) = NULL;
+    REF_COUNT_INIT(shared);
+    REF_COUNT_INCREMENT(shared);
+    memory_track_free(obj, header + sizeof(double) * count);
+    memory_track_alloc(obj, kind, header);
+    memory_track_alloc((linalg_t *)shared, "shared data",
+                       sizeof(memory_shared_t) + sizeof(double) * count);
+    OWNS_MEMORY(obj) = false;
+    COPY_ON_WRITE(obj) = true;
+    MEMORY_OWNER(obj) = (linalg_t *)shared;
+  }
+  owner = MEMORY_OWNER(obj);
+  pthread_mutex_unlock(&memory_share_lock);
+  return owner;
+}
+
+double *memory_release_shared(linalg_t *shared) {
+  size_t count = ((memory_shared_t *)shared)->count;
+  double *data;
+  if (REF_COUNT_DECREMENT(shared) != 1) {
+    return NULL;
+  }
+  data = DATA(shared);
+  memory_track_free(shared, sizeof(memory_shared_t) + sizeof(double) * count);
+  free(shared);
+  return data;
+}
+
+void memory_track_alloc(linalg_t *obj, const char *kind, size_t bytes) {
+  size_t live, peak;
+  double unset = 0.0;
+  if (atomic_load_explicit(&memory_epoch, memory_order_relaxed) == 0.0) {
+    atomic_compare_exchange_strong(&memory_epoch, &unset, memory_now());
+  }
+  atomic_fetch_add_explicit(&memory_live_objects, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&memory_allocations, 1, memory_order_relaxed);
+  live = atomic_fetch_add_explicit(&memory_live_bytes, bytes,
+                                   memory_order_relaxed) +
+         bytes;
+  peak = atomic_load_explicit(&memory_peak_bytes, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&memory_peak_bytes, &peak, live,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+  memory_local.allocations += 1;
+  memory_local.bytes_allocated += bytes;
+  if (atomic_load_explicit(&memory_recording, memory_order_relaxed)) {
+    memory_record(obj, kind, bytes);
+  }
+  memory_callsite_file = NULL;
+  memory_callsite_line = 0;
+}
+
+void memory_track_free(linalg_t *obj, size_t bytes) {
+  atomic_fetch_sub_explicit(&memory_live_objects, 1, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&memory_live_bytes, bytes, memory_order_relaxed);
+  memory_local.frees += 1;
+  memory_local.bytes_freed += bytes;
+  if (atomic_load_explicit(&memory_recording, memory_order_relaxed)) {
+    memory_unrecord(obj);
+  }
+}
+
+void memory_stats(memory_stats_t *stats) {
+  double epoch;
+  stats->live_objects = atomic_load(&memory_live_objects);
+  stats->live_bytes = atomic_load(&memory_live_bytes);
+  stats->peak_bytes = atomic_load(&memory_peak_bytes);
+  stats->allocations = atomic_load(&memory_allocations);
+  epoch = atomic_load(&memory_epoch);
+  stats->elapsed = epoch != 0.0 ? memory_now() - epoch : 0.0;
+  stats->allocation_rate =
+      stats->elapsed > 0.0 ? stats->allocations / stats->elapsed : 0.0;
+  stats->huge_page_bytes = atomic_load(&memory_huge_bytes);
+  stats->huge_page_resident =
+      stats->huge_page_bytes > 0 ? memory_huge_resident() : 0;
+}
+
+void memory_thread_stats(memory_thread_stats_t *stats) {
+  *stats = memory_local;
+}
+
+void memory_stats_reset(void) {
+  atomic_store(&memory_peak_bytes, atomic_load(&memory_live_bytes));
+  atomic_store(&memory_allocations, 0);
+  atomic_store(&memory_epoch, memory_now());
+}
+
+static void memory_report_at_exit(void) { memory_report_leaks(stderr); }
+
+void memory_enable_leak_report(void) {
+  if (!atomic_exchange(&memory_recording, true)) {
+    atexit(memory_report_at_exit);
+  }
+}
+
+size_t memory_report_leaks(FILE *f) {
+  memory_record_t *r;
+  size_t b, count = 0, bytes = 0;
+  pthread_mutex_lock(&memory_records_lock);
+  for (b = 0; b < MEMORY_RECORD_BUCKETS; b++) {
+    for (r = memory_records[b]; r != NULL; r = r->next) {
+      if (count == 0) {
+        fprintf(f, "linalg: leaked objects:\n");
+      }
+      fprintf(f, "  %s of %zu bytes created at %s:%d\n", r->kind, r->bytes,
+              r->file != NULL ? r->file : "<unknown>", r->line);
+      count += 1;
+      bytes += r->bytes;
+    }
+  }
+  pthread_mutex_unlock(&memory_records_lock);
+  if (count > 0) {
+    fprintf(f, "linalg: %zu leaked object(s), %zu bytes\n", count, bytes);
+  }
+  return count;
+}
+
+void memory_set_callsite(const char *file, int line) {
+  memory_callsite_file = file;
+  memory_callsite_line = line;
+}
+
+void linalg_set_copy_on_write(bool enabled) {
+  atomic_store(&memory_copy_on_write, enabled);
+}
+
+bool linalg_copy_on_write(void) {
+  return atomic_load_explicit(&memory_copy_on_write, memory_order_relaxed);
+}
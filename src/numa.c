@@ -0,0 +1,183 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "linalg_numa.h"
+#include "linalg_parallel.h"
+
+/** Policies of the mbind system call. */
+#define NUMA_MPOL_BIND 2
+#define NUMA_MPOL_INTERLEAVE 3
+
+#define NUMA_MASK_WORDS (NUMA_MAX_NODES / (8 * sizeof(unsigned long)))
+
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+static numa_policy_t numa_default_policy = NUMA_DEFAULT;
+static int numa_default_node = 0;
+/** Online nodes, as an mbind node mask. */
+static unsigned long numa_online[NUMA_MASK_WORDS];
+static size_t numa_nonline = 1;
+
+static _Thread_local bool numa_local_set = false;
+static _Thread_local numa_policy_t numa_local_policy;
+static _Thread_local int numa_local_node;
+
+/** Parses a sysfs node list such as `0-1,4` into `numa_online`. */
+static void numa_read_online(void) {
+  char buf[1024];
+  char *p = buf;
+  long first, last, node;
+  FILE *f = fopen("/sys/devices/system/node/online", "r");
+  numa_online[0] = 1;
+  if (f == NULL) {
+    return;
+  }
+  if (fgets(buf, sizeof(buf), f) == NULL) {
+    fclose(f);
+    return;
+  }
+  fclose(f);
+  numa_online[0] = 0;
+  numa_nonline = 0;
+  while (*p != '\0' && *p != '\n') {
+    first = last = strtol(p, &p, 10);
+    if (*p == '-') {
+      last = strtol(p + 1, &p, 10);
+    }
+    for (node = first; node <= last && node < NUMA_MAX_NODES; node++) {
+      numa_online[node / (8 * sizeof(unsigned long))] |=
+          1UL << (node % (8 * sizeof(unsigned long)));
+      numa_nonline++;
+    }
+    if (*p == ',') {
+      p++;
+    } else if (*p != '\0' && *p != '\n') {
+      break;
+    }
+  }
+  if (numa_nonline == 0) {
+    numa_online[0] = 1;
+    numa_nonline = 1;
+  }
+}
+
+static void numa_init(void) {
+  const char *policy = getenv("LINALG_NUMA_POLICY");
+  const char *node = getenv("LINALG_NUMA_NODE");
+  numa_read_online();
+  if (policy != NULL) {
+    if (strcmp(policy, "interleave") == 0) {
+      numa_default_policy = NUMA_INTERLEAVE;
+    } else if (strcmp(policy, "first-touch") == 0) {
+      numa_default_policy = NUMA_FIRST_TOUCH;
+    } else if (strcmp(policy, "bind") == 0) {
+      numa_default_policy = NUMA_BIND;
+    }
+  }
+  if (node != NULL) {
+    numa_default_node = atoi(node);
+  }
+}
+
+static void numa_init_local(void) {
+  if (!numa_local_set) {
+    pthread_once(&numa_once, numa_init);
+    numa_local_policy = numa_default_policy;
+    numa_local_node = numa_default_node;
+    numa_local_set = true;
+  }
+}
+
+numa_policy_t numa_set_policy(numa_policy_t policy) {
+  numa_policy_t previous;
+  numa_init_local();
+  previous = numa_local_policy;
+  numa_local_policy = policy;
+  return previous;
+}
+
+numa_policy_t numa_policy(void) {
+  numa_init_local();
+  return numa_local_policy;
+}
+
+int numa_set_node(int node) {
+  int previous;
+  numa_init_local();
+  previous = numa_local_node;
+  numa_local_node = node;
+  return previous;
+}
+
+size_t numa_node_count(void) {
+  pthread_once(&numa_once, numa_init);
+  return numa_nonline;
+}
+
+/** Sets the memory policy of [data, data + bytes) to `mode` over `mask`. */
+static void numa_bind(void *data, size_t bytes, int mode,
+                      const unsigned long *mask) {
+#if defined(__linux__) && defined(SYS_mbind)
+  // The kernel reads one bit less than the count passed.
+  syscall(SYS_mbind, data, bytes, mode, mask, NUMA_MAX_NODES + 1, 0);
+#else
+  (void)data;
+  (void)bytes;
+  (void)mode;
+  (void)mask;
+#endif
+}
+
+typedef struct {
+  double *data;
+  size_t row_length;
+} numa_touch_t;
+
+static void numa_touch_range(void *ctx, size_t begin, size_t end) {
+  numa_touch_t *touch = ctx;
+  memset(touch->data + begin * touch->row_length, 0,
+         sizeof(double) * (end - begin) * touch->row_length);
+}
+
+void numa_place(double *data, size_t rows, size_t row_length) {
+  unsigned long mask[NUMA_MASK_WORDS];
+  size_t bytes = sizeof(double) * rows * row_length;
+  numa_touch_t touch;
+  int node;
+  numa_init_local();
+  switch (numa_local_policy) {
+  case NUMA_INTERLEAVE:
+    numa_bind(data, bytes, NUMA_MPOL_INTERLEAVE, numa_online);
+    break;
+  case NUMA_BIND:
+    node = numa_local_node;
+    if (node < 0 || node >= NUMA_MAX_NODES) {
+      break;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] =
+        1UL << (node % (8 * sizeof(unsigned long)));
+    numa_bind(data, bytes, NUMA_MPOL_BIND, mask);
+    break;
+  case NUMA_FIRST_TOUCH:
+    touch.data = data;
+    touch.row_length = row_length;
+    // Touching from one thread would put the whole buffer on its node.
+    if (!parallel_try_for(rows, numa_touch_range, &touch)) {
+      numa_bind(data, bytes, NUMA_MPOL_INTERLEAVE, numa_online);
+    }
+    break;
+  default:
+    break;
+  }
+}
@@ -0,0 +1,218 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "linalg_parallel.h"
+#include "linalg_util.h"
+
+/** The loop currently being run by the pool. */
+typedef struct {
+  parallel_fn_t fn;
+  void *ctx;
+  size_t n;
+  size_t grain;
+  bool dynamic;
+  atomic_size_t next;
+} parallel_job_t;
+
+static pthread_mutex_t parallel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t parallel_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t parallel_done = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t parallel_owner = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t *parallel_workers = NULL;
+static atomic_size_t parallel_nthreads = 0;
+static unsigned long parallel_generation = 0;
+static unsigned long parallel_start_generation = 0;
+static size_t parallel_active = 0;
+static bool parallel_shutdown = false;
+static parallel_job_t parallel_job;
+
+static _Thread_local bool parallel_inside = false;
+static _Thread_local parallel_policy_t parallel_policy = PARALLEL_AUTO;
+
+void parallel_chunk(size_t n, size_t nchunks, size_t t, size_t *begin,
+                    size_t *end) {
+  size_t base = n / nchunks, extra = n % nchunks;
+  *begin = t * base + (t < extra ? t : extra);
+  *end = *begin + base + (t < extra ? 1 : 0);
+}
+
+static void parallel_run(size_t t) {
+  parallel_job_t *job = &parallel_job;
+  size_t begin, end;
+  parallel_inside = true;
+  if (job->dynamic) {
+    for (;;) {
+      begin = atomic_fetch_add_explicit(&job->next, job->grain,
+                                        memory_order_relaxed);
+      if (begin >= job->n) {
+        break;
+      }
+      end = begin + job->grain < job->n ? begin + job->grain : job->n;
+      job->fn(job->ctx, begin, end);
+    }
+  } else {
+    parallel_chunk(job->n, parallel_nthreads, t, &begin, &end);
+    if (begin < end) {
+      job->fn(job->ctx, begin, end);
+    }
+  }
+  parallel_inside = false;
+}
+
+static void *parallel_worker(void *arg) {
+  size_t t = (size_t)arg;
+  unsigned long seen = parallel_start_generation;
+  for (;;) {
+    pthread_mutex_lock(&parallel_lock);
+    while (parallel_generation == seen && !parallel_shutdown) {
+      pthread_cond_wait(&parallel_wake, &parallel_lock);
+    }
+    if (parallel_shutdown) {
+      pthread_mutex_unlock(&parallel_lock);
+      return NULL;
+    }
+    seen = parallel_generation;
+    pthread_mutex_unlock(&parallel_lock);
+    parallel_run(t);
+    pthread_mutex_lock(&parallel_lock);
+    parallel_active -= 1;
+    if (parallel_active == 0) {
+      pthread_cond_signal(&parallel_done);
+    }
+    pthread_mutex_unlock(&parallel_lock);
+  }
+}
+
+static size_t parallel_default_threads(void) {
+  const char *env = getenv("LINALG_NUM_THREADS");
+  long n;
+  if (env != NULL && atol(env) > 0) {
+    return (size_t)atol(env);
+  }
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (size_t)n : 1;
+}
+
+static void parallel_stop(void) {
+  size_t t;
+  pthread_mutex_lock(&parallel_lock);
+  parallel_shutdown = true;
+  pthread_cond_broadcast(&parallel_wake);
+  pthread_mutex_unlock(&parallel_lock);
+  for (t = 1; t < parallel_nthreads; t++) {
+    pthread_join(parallel_workers[t - 1], NULL);
+  }
+  free(parallel_workers);
+  parallel_workers = NULL;
+  parallel_shutdown = false;
+}
+
+static void parallel_start(size_t nthreads) {
+  size_t t;
+  parallel_nthreads = nthreads;
+  if (nthreads < 2) {
+    return;
+  }
+  parallel_start_generation = parallel_generation;
+  parallel_workers = malloc(sizeof(pthread_t) * (nthreads - 1));
+  CHECK_MEMORY(parallel_workers);
+  for (t = 1; t < nthreads; t++) {
+    pthread_create(&parallel_workers[t - 1], NULL, parallel_worker,
+                   (void *)t);
+  }
+}
+
+void parallel_set_threads(size_t nthreads) {
+  if (nthreads == 0) {
+    nthreads = parallel_default_threads();
+  }
+  pthread_mutex_lock(&parallel_owner);
+  if (nthreads != parallel_nthreads) {
+    parallel_stop();
+    parallel_start(nthreads);
+  }
+  pthread_mutex_unlock(&parallel_owner);
+}
+
+size_t parallel_threads(void) {
+  if (parallel_nthreads == 0) {
+    parallel_set_threads(0);
+  }
+  return parallel_nthreads;
+}
+
+/** Runs the loop on the pool and returns true, or returns false without
+ *  running it if the pool cannot take it. */
+static bool parallel_try_dispatch(size_t n, size_t grain, bool dynamic,
+                                  parallel_fn_t fn, void *ctx) {
+  size_t nthreads = parallel_threads();
+  if (nthreads < 2 || parallel_inside ||
+      pthread_mutex_trylock(&parallel_owner) != 0) {
+    return false;
+  }
+  parallel_job.fn = fn;
+  parallel_job.ctx = ctx;
+  parallel_job.n = n;
+  parallel_job.grain = grain > 0 ? grain : 1;
+  parallel_job.dynamic = dynamic;
+  atomic_store(&parallel_job.next, 0);
+  pthread_mutex_lock(&parallel_lock);
+  parallel_active = parallel_nthreads - 1;
+  parallel_generation += 1;
+  pthread_cond_broadcast(&parallel_wake);
+  pthread_mutex_unlock(&parallel_lock);
+  parallel_run(0);
+  pthread_mutex_lock(&parallel_lock);
+  while (parallel_active > 0) {
+    pthread_cond_wait(&parallel_done, &parallel_lock);
+  }
+  pthread_mutex_unlock(&parallel_lock);
+  pthread_mutex_unlock(&parallel_owner);
+  return true;
+}
+
+static void parallel_dispatch(size_t n, size_t grain, bool dynamic,
+                              parallel_fn_t fn, void *ctx) {
+  if (n > 0 && !parallel_try_dispatch(n, grain, dynamic, fn, ctx)) {
+    fn(ctx, 0, n);
+  }
+}
+
+bool parallel_nested(void) { return parallel_inside; }
+
+void parallel_for(size_t n, parallel_fn_t fn, void *ctx) {
+  parallel_dispatch(n, 0, false, fn, ctx);
+}
+
+bool parallel_try_for(size_t n, parallel_fn_t fn, void *ctx) {
+  return n == 0 || parallel_try_dispatch(n, 0, false, fn, ctx);
+}
+
+void parallel_for_dynamic(size_t n, size_t grain, parallel_fn_t fn,
+                          void *ctx) {
+  parallel_dispatch(n, grain, true, fn, ctx);
+}
+
+parallel_policy_t parallel_set_policy(parallel_policy_t policy) {
+  parallel_policy_t previous = parallel_policy;
+  parallel_policy = policy;
+  return previous;
+}
+
+bool parallel_should_split(size_t n, size_t threshold) {
+  switch (parallel_policy) {
+  case PARALLEL_SERIAL:
+    return false;
+  case PARALLEL_ALWAYS:
+    return true;
+  default:
+    return n >= threshold && !parallel_inside;
+  }
+}
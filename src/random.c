@@ -0,0 +1,224 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+#include <string.h>
+
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_random.h"
+#include "linalg_trace.h"
+#include "linalg_vector.h"
+#include "map.h"
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+/** 2^-53, the spacing of doubles in [0.5, 1). */
+#define RANDOM_EPSILON 1.1102230246251565e-16
+
+void random_philox4x32(const uint32_t counter[4], const uint32_t key[2],
+                       uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  uint64_t p0, p1;
+  int r;
+  for (r = 0; r < PHILOX_ROUNDS; r++) {
+    p0 = (uint64_t)PHILOX_M0 * c0;
+    p1 = (uint64_t)PHILOX_M1 * c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c1 = (uint32_t)p1;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c3 = (uint32_t)p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+typedef enum {
+  RANDOM_UNIFORM,
+  RANDOM_NORMAL,
+} random_distribution_t;
+
+/** A fill of `nrows x ncols` logical elements into storage with leading
+ *  dimension `ld`. Element e = i * ncols + j takes half e % 2 of block
+ *  e / 2, so each block yields two doubles. */
+typedef struct {
+  double *data;
+  size_t nrows;
+  size_t ncols;
+  size_t ld;
+  random_distribution_t dist;
+  double a;
+  double b;
+  uint64_t seed;
+} random_fill_t;
+
+/** Reads the two uniforms in [0, 1) of blocks [q0, q0 + n) into `u0` and
+ *  `u1`. The loop has no control flow once Philox is inlined, so each
+ *  vector lane computes one block. The top 53 bits of each half are
+ *  converted as two exact int32 pieces, since x86 has no vector conversion
+ *  from 64-bit integers. */
+static void random_uniform_batch(uint64_t seed, uint64_t q0, size_t n,
+                                 double *u0, double *u1) {
+  uint32_t counter[4] = {0, 0, 0, 0};
+  uint32_t key[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+  uint32_t bits[4];
+  size_t b;
+  for (b = 0; b < n; b++) {
+    counter[0] = (uint32_t)(q0 + b);
+    counter[1] = (uint32_t)((q0 + b) >> 32);
+    random_philox4x32(counter, key, bits);
+    u0[b] = ((double)(int32_t)(bits[0] >> 5) * 67108864.0 +
+             (double)(int32_t)(((bits[0] & 31) << 21) | (bits[1] >> 11))) *
+            RANDOM_EPSILON;
+    u1[b] = ((double)(int32_t)(bits[2] >> 5) * 67108864.0 +
+             (double)(int32_t)(((bits[2] & 31) << 21) | (bits[3] >> 11))) *
+            RANDOM_EPSILON;
+  }
+}
+
+/** Scales `n` pairs of uniforms into [a, b), interleaved into `out`. */
+static void random_scale_batch(const random_fill_t *op, size_t n,
+                               const double *u0, const double *u1,
+                               double *out) {
+  size_t b;
+  for (b = 0; b < n; b++) {
+    out[2 * b] = op->a + (op->b - op->a) * u0[b];
+    out[2 * b + 1] = op->a + (op->b - op->a) * u1[b];
+  }
+}
+
+/** Turns `n` pairs of uniforms into normals with the Box-Muller transform,
+ *  interleaved into `out`. The first uniform is moved to (0, 1] so its
+ *  logarithm is finite. */
+static void random_normal_batch(const random_fill_t *op, size_t n,
+                                const double *u0, const double *u1,
+                                double *out) {
+  double radius, s, c;
+  size_t b;
+  for (b = 0; b < n; b++) {
+    radius = op->b * sqrt(-2 * map_log(1 - u0[b]));
+    map_sincos_turn(u1[b], &s, &c);
+    out[2 * b] = op->a + radius * c;
+    out[2 * b + 1] = op->a + radius * s;
+  }
+}
+
+/** Fills blocks [begin, end), `RANDOM_BATCH` at a time: the whole batch is
+ *  generated and converted, then copied out one row segment at a time. */
+static void random_fill_range(void *ctx, size_t begin, size_t end) {
+  const random_fill_t *op = ctx;
+  double u0[RANDOM_BATCH], u1[RANDOM_BATCH], out[2 * RANDOM_BATCH];
+  size_t count = op->nrows * op->ncols;
+  size_t q, n, e, last, i, j, len;
+  for (q = begin; q < end; q += n) {
+    n = end - q < RANDOM_BATCH ? end - q : RANDOM_BATCH;
+    random_uniform_batch(op->seed, q, n, u0, u1);
+    if (op->dist == RANDOM_UNIFORM) {
+      random_scale_batch(op, n, u0, u1, out);
+    } else {
+      random_normal_batch(op, n, u0, u1, out);
+    }
+    e = 2 * q;
+    last = 2 * (q + n) < count ? 2 * (q + n) : count;
+    i = e / op->ncols;
+    j = e % op->ncols;
+    for (; e < last; e += len) {
+      len = op->ncols - j < last - e ? op->ncols - j : last - e;
+      memcpy(op->data + i * op->ld + j, out + (e - 2 * q),
+             sizeof(double) * len);
+      i++;
+      j = 0;
+    }
+  }
+}
+
+static void random_fill(random_fill_t *op) {
+  size_t count = op->nrows * op->ncols;
+  size_t nblocks = (count + 1) / 2;
+  if (count == 0) {
+    return;
+  }
+  if (parallel_should_split(count, RANDOM_PARALLEL_THRESHOLD)) {
+    parallel_for(nblocks, random_fill_range, op);
+  } else {
+    random_fill_range(op, 0, nblocks);
+  }
+}
+
+static vector_t *vector_random(size_t length, random_distribution_t dist,
+                               double a, double b, uint64_t seed) {
+  vector_t *v = vector_new(length);
+  random_fill_t op;
+  op.data = DATA(v);
+  op.nrows = 1;
+  op.ncols = length;
+  op.ld = length;
+  op.dist = dist;
+  op.a = a;
+  op.b = b;
+  op.seed = seed;
+  random_fill(&op);
+  return v;
+}
+
+static matrix_t *matrix_random(size_t nrows, size_t ncols,
+                               random_distribution_t dist, double a, double b,
+                               uint64_t seed) {
+  matrix_t *m = matrix_new(nrows, ncols);
+  random_fill_t op;
+  op.data = DATA(m);
+  op.nrows = nrows;
+  op.ncols = ncols;
+  op.ld = m->ld;
+  op.dist = dist;
+  op.a = a;
+  op.b = b;
+  op.seed = seed;
+  random_fill(&op);
+  return m;
+}
+
+vector_t *vector_random_uniform(size_t length, double min, double max,
+                                uint64_t seed) {
+  vector_t *v;
+  TRACE_BEGIN(length, 1);
+  v = vector_random(length, RANDOM_UNIFORM, min, max, seed);
+  TRACE_END();
+  return v;
+}
+
+vector_t *vector_random_normal(size_t length, double mean, double stddev,
+                               uint64_t seed) {
+  vector_t *v;
+  TRACE_BEGIN(length, 1);
+  v = vector_random(length, RANDOM_NORMAL, mean, stddev, seed);
+  TRACE_END();
+  return v;
+}
+
+matrix_t *matrix_random_uniform(size_t nrows, size_t ncols, double min,
+                                double max, uint64_t seed) {
+  matrix_t *m;
+  TRACE_BEGIN(nrows, ncols);
+  m = matrix_random(nrows, ncols, RANDOM_UNIFORM, min, max, seed);
+  TRACE_END();
+  return m;
+}
+
+matrix_t *matrix_random_normal(size_t nrows, size_t ncols, double mean,
+                               double stddev, uint64_t seed) {
+  matrix_t *m;
+  TRACE_BEGIN(nrows, ncols);
+  m = matrix_random(nrows, ncols, RANDOM_NORMAL, mean, stddev, seed);
+  TRACE_END();
+  return m;
+}
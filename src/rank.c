@@ -0,0 +1,271 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+
+#include "kernels.h"
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_trace.h"
+#include "linalg_tune.h"
+
+/** Operands of a rank-1 update. */
+typedef struct {
+  matrix_t *m;
+  double alpha;
+  const double *x;
+  const double *y;
+  /** Length of a contiguous line of `m`. */
+  size_t n;
+} matrix_ger_t;
+
+static void matrix_ger_range(void *ctx, size_t begin, size_t end) {
+  matrix_ger_t *op = ctx;
+  size_t n = op->n;
+  size_t i, j;
+  double *row, axi;
+  for (i = begin; i < end; i++) {
+    row = DATA(op->m) + i * op->m->ld;
+    axi = op->alpha * op->x[i];
+    for (j = 0; j < n; j++) {
+      row[j] += axi * op->y[j];
+    }
+  }
+}
+
+void matrix_ger(matrix_t *m, double alpha, vector_t *x, vector_t *y) {
+  matrix_ger_t op;
+  size_t lines;
+  matrix_materialize(m);
+  op.m = m;
+  op.alpha = alpha;
+  op.x = DATA(x);
+  op.y = DATA(y);
+  op.n = m->ncols;
+  lines = m->nrows;
+  if (m->order == MATRIX_COL_MAJOR) {
+    // The storage holds m^T, which gets alpha * y * x^T.
+    op.x = DATA(y);
+    op.y = DATA(x);
+    op.n = m->nrows;
+    lines = m->ncols;
+  }
+  TRACE_BEGIN(m->nrows, m->ncols);
+  if (parallel_should_split(m->nrows * m->ncols, MATRIX_RANK_THRESHOLD)) {
+    parallel_for(lines, matrix_ger_range, &op);
+  } else {
+    matrix_ger_range(&op, 0, lines);
+  }
+  TRACE_END();
+}
+
+/** Strided view of op(a) or op(b): element (i, p) is
+ *  `data[i * rs + p * cs]`. */
+typedef struct {
+  const double *data;
+  size_t rs;
+  size_t cs;
+} rank_operand_t;
+
+/** Operands of a symmetric rank-k or rank-2k update. `b` is unused for a
+ *  rank-k update. */
+typedef struct {
+  matrix_t *c;
+  size_t crs;
+  size_t ccs;
+  matrix_uplo_t uplo;
+  double alpha;
+  rank_operand_t a;
+  rank_operand_t b;
+  bool rank2;
+  size_t k;
+  double beta;
+  bool mirror;
+  size_t ntiles;
+  /** Block sizes, read before the tiles are handed to the pool. */
+  const tune_params_t *params;
+} matrix_rank_t;
+
+/** Returns the first column of row `i` of the `uplo` triangle restricted to
+ *  a tile. `diag` selects diagonal tiles, where the triangle cuts through. */
+static size_t rank_first(matrix_uplo_t uplo, bool diag, size_t i) {
+  return diag && uplo == MATRIX_UPPER ? i : 0;
+}
+
+static size_t rank_last(matrix_uplo_t uplo, bool diag, size_t i, size_t n) {
+  return diag && uplo == MATRIX_LOWER ? i + 1 : n;
+}
+
+/** c[i, j] += alpha * sum_p x[i, p] * y[j, p] over the triangle of a
+ *  diagonal tile, as dot products when `p` is the unit stride and as
+ *  scaled rows of `y` otherwise. */
+static void rank_triangle(const matrix_rank_t *op, double *c,
+                          const rank_operand_t *x, const rank_operand_t *y,
+                          size_t n) {
+  size_t i, j, p, last;
+  double sum, xip;
+  if (x->cs == 1 && y->cs == 1) {
+    for (i = 0; i < n; i++) {
+      last = rank_last(op->uplo, true, i, n);
+      for (j = rank_first(op->uplo, true, i); j < last; j++) {
+        sum = 0;
+        for (p = 0; p < op->k; p++) {
+          sum += x->data[i * x->rs + p] * y->data[j * y->rs + p];
+        }
+        c[i * op->crs + j * op->ccs] += op->alpha * sum;
+      }
+    }
+    return;
+  }
+  for (p = 0; p < op->k; p++) {
+    for (i = 0; i < n; i++) {
+      xip = op->alpha * x->data[i * x->rs + p * x->cs];
+      last = rank_last(op->uplo, true, i, n);
+      for (j = rank_first(op->uplo, true, i); j < last; j++) {
+        c[i * op->crs + j * op->ccs] += xip * y->data[j * y->rs + p * y->cs];
+      }
+    }
+  }
+}
+
+/** Computes `alpha * x * y^T + beta * c` on tile (i0, j0) of `c`, which is
+ *  m x n. Off-diagonal tiles are general products for the packed kernel;
+ *  diagonal tiles, already scaled by beta, only update their triangle. */
+static void rank_tile_product(const matrix_rank_t *op,
+                              const rank_operand_t *x,
+                              const rank_operand_t *y, size_t i0, size_t j0,
+                              size_t m, size_t n, double beta, bool diag) {
+  const tune_params_t *params = op->params;
+  double *c = DATA(op->c) + i0 * op->crs + j0 * op->ccs;
+  rank_operand_t xt = {x->data + i0 * x->rs, x->rs, x->cs};
+  rank_operand_t yt = {y->data + j0 * y->rs, y->rs, y->cs};
+  double *pack;
+  if (diag) {
+    rank_triangle(op, c, &xt, &yt, m);
+    return;
+  }
+  pack = kernel_pack_buffer(params->gemm_kc * params->gemm_nc);
+  if (op->ccs == 1) {
+    kernel_gemm_strided(c, op->crs, xt.data, xt.rs, xt.cs, yt.data, yt.cs,
+                        yt.rs, m, op->k, n, op->alpha, beta, params->gemm_kc,
+                        params->gemm_nc, pack);
+  } else {
+    // A column-major tile is stored as its transpose, y * x^T.
+    kernel_gemm_strided(c, op->ccs, yt.data, yt.rs, yt.cs, xt.data, xt.cs,
+                        xt.rs, n, op->k, m, op->alpha, beta, params->gemm_kc,
+                        params->gemm_nc, pack);
+  }
+}
+
+static void matrix_rank_range(void *ctx, size_t begin, size_t end) {
+  matrix_rank_t *op = ctx;
+  size_t n = op->c->nrows;
+  size_t crs = op->crs, ccs = op->ccs;
+  size_t idx, ti, tj, i0, j0, m, w, i, j, last;
+  double *c;
+  bool diag;
+  for (idx = begin; idx < end; idx++) {
+    // Tiles of the lower triangle in row order; the upper triangle uses
+    // the same enumeration transposed.
+    ti = (size_t)((sqrt(8.0 * idx + 1) - 1) / 2);
+    while (ti * (ti + 1) / 2 > idx) {
+      ti--;
+    }
+    while ((ti + 1) * (ti + 2) / 2 <= idx) {
+      ti++;
+    }
+    tj = idx - ti * (ti + 1) / 2;
+    if (op->uplo == MATRIX_UPPER) {
+      i = ti;
+      ti = tj;
+      tj = i;
+    }
+    diag = ti == tj;
+    i0 = ti * MATRIX_RANK_TILE;
+    j0 = tj * MATRIX_RANK_TILE;
+    m = i0 + MATRIX_RANK_TILE < n ? MATRIX_RANK_TILE : n - i0;
+    w = j0 + MATRIX_RANK_TILE < n ? MATRIX_RANK_TILE : n - j0;
+    c = DATA(op->c) + i0 * crs + j0 * ccs;
+    if (diag) {
+      for (i = 0; i < m; i++) {
+        last = rank_last(op->uplo, diag, i, w);
+        for (j = rank_first(op->uplo, diag, i); j < last; j++) {
+          c[i * crs + j * ccs] =
+              op->beta == 0 ? 0 : op->beta * c[i * crs + j * ccs];
+        }
+      }
+    }
+    rank_tile_product(op, &op->a, op->rank2 ? &op->b : &op->a, i0, j0, m, w,
+                      op->beta, diag);
+    if (op->rank2) {
+      rank_tile_product(op, &op->b, &op->a, i0, j0, m, w, 1, diag);
+    }
+    if (op->mirror) {
+      for (i = 0; i < m; i++) {
+        last = rank_last(op->uplo, diag, i, w);
+        for (j = rank_first(op->uplo, diag, i); j < last; j++) {
+          DATA(op->c)[(j0 + j) * crs + (i0 + i) * ccs] = c[i * crs + j * ccs];
+        }
+      }
+    }
+  }
+}
+
+/** Fills the view of op(m), which is read with its strides exchanged when
+ *  transposed or column-major, as in trsm.c. */
+static void rank_operand(rank_operand_t *o, const matrix_t *m,
+                         matrix_trans_t trans) {
+  bool swap = (trans == MATRIX_TRANS) != (m->order == MATRIX_COL_MAJOR);
+  o->data = DATA(m);
+  o->rs = swap ? 1 : m->ld;
+  o->cs = swap ? m->ld : 1;
+}
+
+static void matrix_rank_update(matrix_rank_t *op, matrix_t *a, matrix_t *b,
+                               matrix_trans_t trans) {
+  size_t n = op->c->nrows;
+  size_t tiles = (n + MATRIX_RANK_TILE - 1) / MATRIX_RANK_TILE;
+  matrix_materialize(op->c);
+  op->crs = op->c->order == MATRIX_COL_MAJOR ? 1 : op->c->ld;
+  op->ccs = op->c->order == MATRIX_COL_MAJOR ? op->c->ld : 1;
+  rank_operand(&op->a, a, trans);
+  op->rank2 = b != NULL;
+  if (op->rank2) {
+    rank_operand(&op->b, b, trans);
+  }
+  op->k = trans == MATRIX_NO_TRANS ? a->ncols : a->nrows;
+  op->ntiles = tiles * (tiles + 1) / 2;
+  op->params = tune_params();
+  if (parallel_should_split(n * n * op->k / 2, MATRIX_RANK_THRESHOLD)) {
+    parallel_for_dynamic(op->ntiles, 1, matrix_rank_range, op);
+  } else {
+    matrix_rank_range(op, 0, op->ntiles);
+  }
+}
+
+void matrix_syrk(matrix_t *c, matrix_uplo_t uplo, matrix_trans_t trans,
+                 double alpha, matrix_t *a, double beta, bool mirror) {
+  matrix_rank_t op;
+  op.c = c;
+  op.uplo = uplo;
+  op.alpha = alpha;
+  op.beta = beta;
+  op.mirror = mirror;
+  TRACE_BEGIN(c->nrows, c->ncols);
+  matrix_rank_update(&op, a, NULL, trans);
+  TRACE_END();
+}
+
+void matrix_syr2k(matrix_t *c, matrix_uplo_t uplo, matrix_trans_t trans,
+                  double alpha, matrix_t *a, matrix_t *b, double beta,
+                  bool mirror) {
+  matrix_rank_t op;
+  op.c = c;
+  op.uplo = uplo;
+  op.alpha = alpha;
+  op.beta = beta;
+  op.mirror = mirror;
+  TRACE_BEGIN(c->nrows, c->ncols);
+  matrix_rank_update(&op, a, b, trans);
+  TRACE_END();
+}
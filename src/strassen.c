@@ -0,0 +1,166 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include "kernels.h"
+#include "linalg_matrix.h"
+#include "linalg_trace.h"
+#include "linalg_util.h"
+
+/** c = a + b over an r x n block. `c` may alias `a` or `b`. */
+static void strassen_add(double *c, size_t ldc, const double *a, size_t lda,
+                         const double *b, size_t ldb, size_t r, size_t n) {
+  size_t i, j;
+  for (i = 0; i < r; i++) {
+    for (j = 0; j < n; j++) {
+      c[i * ldc + j] = a[i * lda + j] + b[i * ldb + j];
+    }
+  }
+}
+
+/** c = a - b over an r x n block. `c` may alias `a` or `b`. */
+static void strassen_sub(double *c, size_t ldc, const double *a, size_t lda,
+                         const double *b, size_t ldb, size_t r, size_t n) {
+  size_t i, j;
+  for (i = 0; i < r; i++) {
+    for (j = 0; j < n; j++) {
+      c[i * ldc + j] = a[i * lda + j] - b[i * ldb + j];
+    }
+  }
+}
+
+/** Returns the number of doubles of workspace needed below this level. */
+static size_t strassen_workspace(size_t m, size_t k, size_t n,
+                                 size_t crossover) {
+  size_t h = m / 2, kh = k / 2, nh = n / 2;
+  if (m <= crossover || k <= crossover || n <= crossover) {
+    return 0;
+  }
+  return h * kh + kh * nh + h * nh +
+         strassen_workspace(h, kh, nh, crossover);
+}
+
+/** Overwrites `c` (m x n) with `a` (m x k) times `b` (k x n).
+ *
+ *  The even-sized leading part is computed with the Winograd variant using
+ *  the schedule of Douglas et al., which needs three temporaries per level
+ *  taken from the front of `ws`; the rest of `ws` is passed down.
+ */
+static void strassen(double *c, size_t ldc, const double *a, size_t lda,
+                     const double *b, size_t ldb, size_t m, size_t k, size_t n,
+                     size_t crossover, double *ws) {
+  size_t h = m / 2, kh = k / 2, nh = n / 2;
+  const double *a11, *a12, *a21, *a22, *b11, *b12, *b21, *b22;
+  double *c11, *c12, *c21, *c22, *x, *y, *z, *rest;
+  size_t i, j, p;
+  double sum;
+  if (m <= crossover || k <= crossover || n <= crossover) {
+    kernel_gemm(c, ldc, a, lda, b, ldb, m, k, n);
+    return;
+  }
+  a11 = a;
+  a12 = a + kh;
+  a21 = a + h * lda;
+  a22 = a21 + kh;
+  b11 = b;
+  b12 = b + nh;
+  b21 = b + kh * ldb;
+  b22 = b21 + nh;
+  c11 = c;
+  c12 = c + nh;
+  c21 = c + h * ldc;
+  c22 = c21 + nh;
+  x = ws;
+  y = x + h * kh;
+  z = y + kh * nh;
+  rest = z + h * nh;
+
+  strassen_sub(x, kh, a11, lda, a21, lda, h, kh);
+  strassen_sub(y, nh, b22, ldb, b12, ldb, kh, nh);
+  strassen(c21, ldc, x, kh, y, nh, h, kh, nh, crossover, rest);
+  strassen_add(x, kh, a21, lda, a22, lda, h, kh);
+  strassen_sub(y, nh, b12, ldb, b11, ldb, kh, nh);
+  strassen(c22, ldc, x, kh, y, nh, h, kh, nh, crossover, rest);
+  strassen_sub(x, kh, x, kh, a11, lda, h, kh);
+  strassen_sub(y, nh, b22, ldb, y, nh, kh, nh);
+  strassen(c12, ldc, x, kh, y, nh, h, kh, nh, crossover, rest);
+  strassen_sub(x, kh, a12, lda, x, kh, h, kh);
+  strassen(c11, ldc, x, kh, b22, ldb, h, kh, nh, crossover, rest);
+  strassen(z, nh, a11, lda, b11, ldb, h, kh, nh, crossover, rest);
+  strassen_add(c12, ldc, z, nh, c12, ldc, h, nh);
+  strassen_add(c21, ldc, c12, ldc, c21, ldc, h, nh);
+  strassen_add(c12, ldc, c12, ldc, c22, ldc, h, nh);
+  strassen_add(c22, ldc, c21, ldc, c22, ldc, h, nh);
+  strassen_add(c12, ldc, c12, ldc, c11, ldc, h, nh);
+  strassen_sub(y, nh, y, nh, b21, ldb, kh, nh);
+  strassen(c11, ldc, a22, lda, y, nh, h, kh, nh, crossover, rest);
+  strassen_sub(c21, ldc, c21, ldc, c11, ldc, h, nh);
+  strassen(c11, ldc, a12, lda, b21, ldb, h, kh, nh, crossover, rest);
+  strassen_add(c11, ldc, z, nh, c11, ldc, h, nh);
+
+  /* Peel the odd inner index: rank-1 update of the even block. */
+  if (k % 2 == 1) {
+    for (i = 0; i < 2 * h; i++) {
+      for (j = 0; j < 2 * nh; j++) {
+        c[i * ldc + j] += a[i * lda + k - 1] * b[(k - 1) * ldb + j];
+      }
+    }
+  }
+  /* Peel the odd last column and row with full-length dot products. */
+  if (n % 2 == 1) {
+    for (i = 0; i < m; i++) {
+      sum = 0;
+      for (p = 0; p < k; p++) {
+        sum += a[i * lda + p] * b[p * ldb + n - 1];
+      }
+      c[i * ldc + n - 1] = sum;
+    }
+  }
+  if (m % 2 == 1) {
+    for (j = 0; j < 2 * nh; j++) {
+      c[(m - 1) * ldc + j] = 0;
+    }
+    for (p = 0; p < k; p++) {
+      for (j = 0; j < 2 * nh; j++) {
+        c[(m - 1) * ldc + j] += a[(m - 1) * lda + p] * b[p * ldb + j];
+      }
+    }
+  }
+}
+
+matrix_t *matrix_mul_strassen_into(matrix_t *dst, matrix_t *m1, matrix_t *m2,
+                                   size_t crossover) {
+  size_t m = m1->nrows, k = m1->ncols, n = m2->ncols;
+  matrix_t *a = m1, *b = m2;
+  double *ws;
+  if (crossover == 0) {
+    crossover = MATRIX_STRASSEN_CROSSOVER;
+  }
+  matrix_materialize(dst);
+  TRACE_BEGIN(m, n);
+  // The recursion needs every operand in dst's order.
+  if (a->order != dst->order) {
+    a = matrix_copy_order(m1, dst->order);
+  }
+  if (b->order != dst->order) {
+    b = matrix_copy_order(m2, dst->order);
+  }
+  ws = malloc(sizeof(double) * (strassen_workspace(m, k, n, crossover) + 1));
+  CHECK_MEMORY(ws);
+  if (dst->order == MATRIX_COL_MAJOR) {
+    // dst^T = m2^T * m1^T is a row-major product over the same storage.
+    strassen(DATA(dst), dst->ld, DATA(b), b->ld, DATA(a), a->ld, n, k, m,
+             crossover, ws);
+  } else {
+    strassen(DATA(dst), dst->ld, DATA(a), a->ld, DATA(b), b->ld, m, k, n,
+             crossover, ws);
+  }
+  free(ws);
+  if (a != m1) {
+    matrix_free(a);
+  }
+  if (b != m2) {
+    matrix_free(b);
+  }
+  TRACE_END();
+  return dst;
+}
@@ -0,0 +1,242 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linalg_stream.h"
+#include "linalg_util.h"
+
+struct future_t {
+  pthread_mutex_t lock;
+  pthread_cond_t done_cond;
+  bool done;
+  void *result;
+  /** One reference for the caller and one for the stream. */
+  atomic_int refs;
+};
+
+/** A queued operation. */
+typedef struct stream_op_t {
+  stream_fn_t fn;
+  void *ctx;
+  future_t *future;
+  struct stream_op_t *next;
+} stream_op_t;
+
+struct stream_t {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  /** Signalled when an operation is queued or the stream stops. */
+  pthread_cond_t work_cond;
+  /** Signalled when the queue drains. */
+  pthread_cond_t idle_cond;
+  stream_op_t *head;
+  stream_op_t *tail;
+  /** Operations queued or running. */
+  size_t pending;
+  bool stopping;
+};
+
+static void future_release(future_t *f) {
+  if (atomic_fetch_sub_explicit(&f->refs, 1, memory_order_acq_rel) == 1) {
+    pthread_mutex_destroy(&f->lock);
+    pthread_cond_destroy(&f->done_cond);
+    free(f);
+  }
+}
+
+static void future_complete(future_t *f, void *result) {
+  pthread_mutex_lock(&f->lock);
+  f->result = result;
+  f->done = true;
+  pthread_cond_broadcast(&f->done_cond);
+  pthread_mutex_unlock(&f->lock);
+  future_release(f);
+}
+
+static void *stream_worker(void *arg) {
+  stream_t *s = arg;
+  stream_op_t *op;
+  void *result;
+  for (;;) {
+    pthread_mutex_lock(&s->lock);
+    while (s->head == NULL && !s->stopping) {
+      pthread_cond_wait(&s->work_cond, &s->lock);
+    }
+    op = s->head;
+    if (op == NULL) {
+      pthread_mutex_unlock(&s->lock);
+      return NULL;
+    }
+    s->head = op->next;
+    if (s->head == NULL) {
+      s->tail = NULL;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    result = op->fn(op->ctx);
+    future_complete(op->future, result);
+    free(op->ctx);
+    free(op);
+
+    pthread_mutex_lock(&s->lock);
+    if (--s->pending == 0) {
+      pthread_cond_broadcast(&s->idle_cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+  }
+}
+
+stream_t *stream_new(void) {
+  stream_t *s = calloc(1, sizeof(stream_t));
+  CHECK_MEMORY(s);
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->work_cond, NULL);
+  pthread_cond_init(&s->idle_cond, NULL);
+  if (pthread_create(&s->thread, NULL, stream_worker, s) != 0) {
+    raise_error(LINALG_UNKNOWN_ERROR);
+  }
+  return s;
+}
+
+void stream_synchronize(stream_t *s) {
+  pthread_mutex_lock(&s->lock);
+  while (s->pending > 0) {
+    pthread_cond_wait(&s->idle_cond, &s->lock);
+  }
+  pthread_mutex_unlock(&s->lock);
+}
+
+void stream_free(stream_t *s) {
+  pthread_mutex_lock(&s->lock);
+  s->stopping = true;
+  pthread_cond_signal(&s->work_cond);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+  pthread_mutex_destroy(&s->lock);
+  pthread_cond_destroy(&s->work_cond);
+  pthread_cond_destroy(&s->idle_cond);
+  free(s);
+}
+
+future_t *stream_submit(stream_t *s, stream_fn_t fn, const void *ctx,
+                        size_t ctx_size) {
+  stream_op_t *op = malloc(sizeof(stream_op_t));
+  future_t *f = calloc(1, sizeof(future_t));
+  CHECK_MEMORY(op);
+  CHECK_MEMORY(f);
+  pthread_mutex_init(&f->lock, NULL);
+  pthread_cond_init(&f->done_cond, NULL);
+  atomic_init(&f->refs, 2);
+  op->fn = fn;
+  op->ctx = malloc(ctx_size > 0 ? ctx_size : 1);
+  CHECK_MEMORY(op->ctx);
+  memcpy(op->ctx, ctx, ctx_size);
+  op->future = f;
+  op->next = NULL;
+  pthread_mutex_lock(&s->lock);
+  if (s->tail != NULL) {
+    s->tail->next = op;
+  } else {
+    s->head = op;
+  }
+  s->tail = op;
+  s->pending++;
+  pthread_cond_signal(&s->work_cond);
+  pthread_mutex_unlock(&s->lock);
+  return f;
+}
+
+bool future_poll(future_t *f) {
+  bool done;
+  pthread_mutex_lock(&f->lock);
+  done = f->done;
+  pthread_mutex_unlock(&f->lock);
+  return done;
+}
+
+void *future_wait(future_t *f) {
+  void *result;
+  pthread_mutex_lock(&f->lock);
+  while (!f->done) {
+    pthread_cond_wait(&f->done_cond, &f->lock);
+  }
+  result = f->result;
+  pthread_mutex_unlock(&f->lock);
+  return result;
+}
+
+void future_free(future_t *f) { future_release(f); }
+
+/** Operands of the built-in stream operations. */
+typedef struct {
+  void *dst;
+  void *a;
+  void *b;
+  double k;
+} stream_args_t;
+
+static void *stream_matrix_mul_fn(void *ctx) {
+  stream_args_t *args = ctx;
+  return matrix_mul_into(args->dst, args->a, args->b);
+}
+
+static void *stream_matrix_vector_mul_fn(void *ctx) {
+  stream_args_t *args = ctx;
+  return matrix_vector_mul(args->a, args->b);
+}
+
+static void *stream_vector_add_fn(void *ctx) {
+  stream_args_t *args = ctx;
+  vector_add_into(args->dst, args->a, args->b);
+  return args->dst;
+}
+
+static void *stream_vector_sub_fn(void *ctx) {
+  stream_args_t *args = ctx;
+  vector_sub_into(args->dst, args->a, args->b);
+  return args->dst;
+}
+
+static void *stream_vector_scalar_mul_fn(void *ctx) {
+  stream_args_t *args = ctx;
+  vector_scalar_mul_into(args->dst, args->a, args->k);
+  return args->dst;
+}
+
+static future_t *stream_submit_args(stream_t *s, stream_fn_t fn, void *dst,
+                                    void *a, void *b, double k) {
+  stream_args_t args;
+  args.dst = dst;
+  args.a = a;
+  args.b = b;
+  args.k = k;
+  return stream_submit(s, fn, &args, sizeof(args));
+}
+
+future_t *stream_matrix_mul_into(stream_t *s, matrix_t *dst, matrix_t *m1,
+                                 matrix_t *m2) {
+  return stream_submit_args(s, stream_matrix_mul_fn, dst, m1, m2, 0);
+}
+
+future_t *stream_matrix_vector_mul(stream_t *s, matrix_t *m, vector_t *v) {
+  return stream_submit_args(s, stream_matrix_vector_mul_fn, NULL, m, v, 0);
+}
+
+future_t *stream_vector_add_into(stream_t *s, vector_t *dst, vector_t *v1,
+                                 vector_t *v2) {
+  return stream_submit_args(s, stream_vector_add_fn, dst, v1, v2, 0);
+}
+
+future_t *stream_vector_sub_into(stream_t *s, vector_t *dst, vector_t *v1,
+                                 vector_t *v2) {
+  return stream_submit_args(s, stream_vector_sub_fn, dst, v1, v2, 0);
+}
+
+future_t *stream_vector_scalar_mul_into(stream_t *s, vector_t *dst,
+                                        vector_t *v, double k) {
+  return stream_submit_args(s, stream_vector_scalar_mul_fn, dst, v, NULL, k);
+}
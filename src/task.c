@@ -0,0 +1,250 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "linalg_parallel.h"
+#include "linalg_task.h"
+#include "linalg_util.h"
+
+struct task_t {
+  task_fn_t fn;
+  void *ctx;
+  atomic_int pending;
+  task_t **successors;
+  size_t nsuccessors;
+  size_t capacity;
+};
+
+/** Last writer and readers since of one key. */
+typedef struct {
+  const void *key;
+  task_t *writer;
+  task_t **readers;
+  size_t nreaders;
+  size_t capacity;
+} task_access_t;
+
+struct task_graph_t {
+  task_t **tasks;
+  size_t ntasks;
+  size_t capacity;
+  task_access_t *accesses;
+  size_t naccesses;
+  size_t access_capacity;
+};
+
+/** Ready tasks of one thread. The owner works at the bottom, thieves at the
+ *  top. Every task is pushed once, so `items` never needs to wrap. */
+typedef struct {
+  pthread_mutex_t lock;
+  task_t **items;
+  size_t top;
+  size_t bottom;
+} task_deque_t;
+
+typedef struct {
+  task_deque_t *deques;
+  size_t nthreads;
+  atomic_size_t remaining;
+} task_run_t;
+
+/** Appends `item` to a growable array of pointers. */
+static void task_append(task_t ***items, size_t *n, size_t *capacity,
+                        task_t *item) {
+  if (*n == *capacity) {
+    *capacity = *capacity > 0 ? 2 * *capacity : 4;
+    *items = realloc(*items, sizeof(task_t *) * *capacity);
+    CHECK_MEMORY(*items);
+  }
+  (*items)[(*n)++] = item;
+}
+
+task_graph_t *task_graph_new(void) {
+  task_graph_t *g = calloc(1, sizeof(task_graph_t));
+  CHECK_MEMORY(g);
+  return g;
+}
+
+void task_graph_free(task_graph_t *g) {
+  size_t i;
+  for (i = 0; i < g->ntasks; i++) {
+    free(g->tasks[i]->ctx);
+    free(g->tasks[i]->successors);
+    free(g->tasks[i]);
+  }
+  for (i = 0; i < g->access_capacity; i++) {
+    free(g->accesses[i].readers);
+  }
+  free(g->accesses);
+  free(g->tasks);
+  free(g);
+}
+
+task_t *task_graph_add(task_graph_t *g, task_fn_t fn, const void *ctx,
+                       size_t ctx_size) {
+  task_t *t = calloc(1, sizeof(task_t));
+  CHECK_MEMORY(t);
+  t->fn = fn;
+  t->ctx = malloc(ctx_size > 0 ? ctx_size : 1);
+  CHECK_MEMORY(t->ctx);
+  memcpy(t->ctx, ctx, ctx_size);
+  atomic_init(&t->pending, 0);
+  task_append(&g->tasks, &g->ntasks, &g->capacity, t);
+  return t;
+}
+
+void task_depend(task_t *before, task_t *after) {
+  if (before == after || (before->nsuccessors > 0 &&
+                          before->successors[before->nsuccessors - 1] ==
+                              after)) {
+    return;
+  }
+  task_append(&before->successors, &before->nsuccessors, &before->capacity,
+              after);
+  atomic_fetch_add_explicit(&after->pending, 1, memory_order_relaxed);
+}
+
+static size_t task_hash(const void *key, size_t capacity) {
+  return (size_t)(((uintptr_t)key >> 3) * 2654435761u) & (capacity - 1);
+}
+
+/** Returns the access record of `key`, growing the open-addressed table. */
+static task_access_t *task_access(task_graph_t *g, const void *key) {
+  task_access_t *old = g->accesses;
+  size_t old_capacity = g->access_capacity;
+  size_t i, h;
+  if (2 * (g->naccesses + 1) > g->access_capacity) {
+    g->access_capacity = old_capacity > 0 ? 2 * old_capacity : 64;
+    g->accesses = calloc(g->access_capacity, sizeof(task_access_t));
+    CHECK_MEMORY(g->accesses);
+    for (i = 0; i < old_capacity; i++) {
+      if (old[i].key != NULL) {
+        h = task_hash(old[i].key, g->access_capacity);
+        while (g->accesses[h].key != NULL) {
+          h = (h + 1) & (g->access_capacity - 1);
+        }
+        g->accesses[h] = old[i];
+      }
+    }
+    free(old);
+  }
+  h = task_hash(key, g->access_capacity);
+  while (g->accesses[h].key != NULL && g->accesses[h].key != key) {
+    h = (h + 1) & (g->access_capacity - 1);
+  }
+  if (g->accesses[h].key == NULL) {
+    g->accesses[h].key = key;
+    g->naccesses += 1;
+  }
+  return &g->accesses[h];
+}
+
+void task_reads(task_graph_t *g, task_t *t, const void *key) {
+  task_access_t *a = task_access(g, key);
+  if (a->writer != NULL) {
+    task_depend(a->writer, t);
+  }
+  task_append(&a->readers, &a->nreaders, &a->capacity, t);
+}
+
+void task_writes(task_graph_t *g, task_t *t, const void *key) {
+  task_access_t *a = task_access(g, key);
+  size_t i;
+  if (a->writer != NULL) {
+    task_depend(a->writer, t);
+  }
+  for (i = 0; i < a->nreaders; i++) {
+    task_depend(a->readers[i], t);
+  }
+  a->writer = t;
+  a->nreaders = 0;
+}
+
+size_t task_graph_size(task_graph_t *g) { return g->ntasks; }
+
+static void task_push(task_deque_t *d, task_t *t) {
+  pthread_mutex_lock(&d->lock);
+  d->items[d->bottom++] = t;
+  pthread_mutex_unlock(&d->lock);
+}
+
+static task_t *task_pop(task_deque_t *d) {
+  task_t *t = NULL;
+  pthread_mutex_lock(&d->lock);
+  if (d->bottom > d->top) {
+    t = d->items[--d->bottom];
+  }
+  pthread_mutex_unlock(&d->lock);
+  return t;
+}
+
+static task_t *task_steal(task_deque_t *d) {
+  task_t *t = NULL;
+  if (pthread_mutex_trylock(&d->lock) != 0) {
+    return NULL;
+  }
+  if (d->bottom > d->top) {
+    t = d->items[d->top++];
+  }
+  pthread_mutex_unlock(&d->lock);
+  return t;
+}
+
+static void task_worker(void *ctx, size_t begin, size_t end) {
+  task_run_t *run = ctx;
+  task_deque_t *own = &run->deques[begin];
+  task_t *t;
+  size_t i;
+  (void)end;
+  while (atomic_load_explicit(&run->remaining, memory_order_acquire) > 0) {
+    t = task_pop(own);
+    for (i = 1; t == NULL && i < run->nthreads; i++) {
+      t = task_steal(&run->deques[(begin + i) % run->nthreads]);
+    }
+    if (t == NULL) {
+      sched_yield();
+      continue;
+    }
+    t->fn(t->ctx);
+    for (i = 0; i < t->nsuccessors; i++) {
+      if (atomic_fetch_sub_explicit(&t->successors[i]->pending, 1,
+                                    memory_order_acq_rel) == 1) {
+        task_push(own, t->successors[i]);
+      }
+    }
+    atomic_fetch_sub_explicit(&run->remaining, 1, memory_order_release);
+  }
+}
+
+void task_graph_run(task_graph_t *g) {
+  task_run_t run;
+  size_t i, t = 0;
+  run.nthreads = parallel_threads();
+  run.deques = malloc(sizeof(task_deque_t) * run.nthreads);
+  CHECK_MEMORY(run.deques);
+  for (i = 0; i < run.nthreads; i++) {
+    pthread_mutex_init(&run.deques[i].lock, NULL);
+    run.deques[i].items = malloc(sizeof(task_t *) * (g->ntasks + 1));
+    CHECK_MEMORY(run.deques[i].items);
+    run.deques[i].top = 0;
+    run.deques[i].bottom = 0;
+  }
+  for (i = 0; i < g->ntasks; i++) {
+    if (atomic_load(&g->tasks[i]->pending) == 0) {
+      task_push(&run.deques[t], g->tasks[i]);
+      t = (t + 1) % run.nthreads;
+    }
+  }
+  atomic_init(&run.remaining, g->ntasks);
+  parallel_for(run.nthreads, task_worker, &run);
+  for (i = 0; i < run.nthreads; i++) {
+    pthread_mutex_destroy(&run.deques[i].lock);
+    free(run.deques[i].items);
+  }
+  free(run.deques);
+}
@@ -0,0 +1,179 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "linalg_memory.h"
+#include "linalg_parallel.h"
+#include "linalg_tile.h"
+#include "linalg_trace.h"
+#include "linalg_util.h"
+
+static size_t tile_matrix_bytes(tile_matrix_t *m) {
+  return sizeof(double) * m->tile_rows * m->tile_cols * m->tile * m->tile;
+}
+
+tile_matrix_t *tile_matrix_zeros(size_t nrows, size_t ncols, size_t tile) {
+  tile_matrix_t *m = malloc(sizeof(tile_matrix_t));
+  CHECK_MEMORY(m);
+  if (tile == 0) {
+    tile = TILE_MATRIX_TILE;
+  }
+  m->nrows = nrows;
+  m->ncols = ncols;
+  m->tile = tile;
+  m->tile_rows = (nrows + tile - 1) / tile;
+  m->tile_cols = (ncols + tile - 1) / tile;
+  // One row of tiles per placement row, so first-touch spreads tile rows.
+  DATA(m) = memory_alloc_data(m->tile_rows, m->tile_cols * tile * tile);
+  CHECK_MEMORY(DATA(m));
+  memset(DATA(m), 0, tile_matrix_bytes(m));
+  OWNS_MEMORY(m) = true;
+  COPY_ON_WRITE(m) = false;
+  MEMORY_OWNER(m) = NULL;
+  REF_COUNT_INIT(m);
+  memory_track_alloc((linalg_t *)m, "tile matrix",
+                     sizeof(tile_matrix_t) + tile_matrix_bytes(m));
+  return m;
+}
+
+void tile_matrix_free(tile_matrix_t *m) {
+  CHECK_REF_COUNT(m);
+  memory_track_free((linalg_t *)m,
+                    sizeof(tile_matrix_t) + tile_matrix_bytes(m));
+  memory_free_data(DATA(m), tile_matrix_bytes(m) / sizeof(double));
+  free(m);
+}
+
+tile_matrix_t *tile_matrix_from_matrix(matrix_t *m, size_t tile) {
+  tile_matrix_t *t = tile_matrix_zeros(m->nrows, m->ncols, tile);
+  size_t rs = MATRIX_ROW_STRIDE(m), cs = MATRIX_COL_STRIDE(m);
+  size_t i, j;
+  TRACE_BEGIN(m->nrows, m->ncols);
+  for (i = 0; i < m->nrows; i++) {
+    for (j = 0; j < m->ncols; j++) {
+      TILE_MATRIX_IDX_INTO(t, i, j) = DATA(m)[i * rs + j * cs];
+    }
+  }
+  TRACE_END();
+  return t;
+}
+
+matrix_t *tile_matrix_to_matrix(tile_matrix_t *t) {
+  matrix_t *m = matrix_new(t->nrows, t->ncols);
+  size_t i, j;
+  TRACE_BEGIN(t->nrows, t->ncols);
+  for (i = 0; i < m->nrows; i++) {
+    for (j = 0; j < m->ncols; j++) {
+      DATA(m)[MATRIX_IDX_ROW(m, i, j)] = TILE_MATRIX_IDX_INTO(t, i, j);
+    }
+  }
+  TRACE_END();
+  return m;
+}
+
+double *tile_matrix_tile(tile_matrix_t *m, size_t ti, size_t tj) {
+  return DATA(m) + (ti * m->tile_cols + tj) * m->tile * m->tile;
+}
+
+/** Operands of a tile-major product. */
+typedef struct {
+  tile_matrix_t *dst;
+  tile_matrix_t *m1;
+  tile_matrix_t *m2;
+} tile_matrix_mul_t;
+
+static void tile_matrix_mul_range(void *ctx, size_t begin, size_t end) {
+  tile_matrix_mul_t *op = ctx;
+  size_t t = op->m1->tile;
+  size_t idx, ti, tj, tk, i;
+  double *c;
+  for (idx = begin; idx < end; idx++) {
+    ti = idx / op->dst->tile_cols;
+    tj = idx % op->dst->tile_cols;
+    c = tile_matrix_tile(op->dst, ti, tj);
+    for (i = 0; i < t * t; i++) {
+      c[i] = 0;
+    }
+    for (tk = 0; tk < op->m1->tile_cols; tk++) {
+      kernel_gemm_acc(c, t, tile_matrix_tile(op->m1, ti, tk), t,
+                      tile_matrix_tile(op->m2, tk, tj), t, t, t, t);
+    }
+  }
+}
+
+void tile_matrix_mul_into(tile_matrix_t *dst, tile_matrix_t *m1,
+                          tile_matrix_t *m2) {
+  tile_matrix_mul_t op;
+  if (m1->tile != m2->tile || dst->tile != m1->tile ||
+      m1->ncols != m2->nrows || dst->nrows != m1->nrows ||
+      dst->ncols != m2->ncols) {
+    raise_error(LINALG_LAYOUT_ERROR);
+  }
+  op.dst = dst;
+  op.m1 = m1;
+  op.m2 = m2;
+  TRACE_BEGIN(m1->nrows, m2->ncols);
+  parallel_for_dynamic(dst->tile_rows * dst->tile_cols, 1,
+                       tile_matrix_mul_range, &op);
+  TRACE_END();
+}
+
+void tile_matrix_transpose_into(tile_matrix_t *dst, tile_matrix_t *m) {
+  size_t t = m->tile;
+  size_t ti, tj, i, j;
+  double *src, *out;
+  if (dst->tile != t || dst->nrows != m->ncols || dst->ncols != m->nrows) {
+    raise_error(LINALG_LAYOUT_ERROR);
+  }
+  TRACE_BEGIN(m->nrows, m->ncols);
+  for (ti = 0; ti < m->tile_rows; ti++) {
+    for (tj = 0; tj < m->tile_cols; tj++) {
+      src = tile_matrix_tile(m, ti, tj);
+      out = tile_matrix_tile(dst, tj, ti);
+      for (i = 0; i < t; i++) {
+        for (j = 0; j < t; j++) {
+          out[j * t + i] = src[i * t + j];
+        }
+      }
+    }
+  }
+  TRACE_END();
+}
+
+bool tile_matrix_cholesky(tile_matrix_t *m) {
+  size_t t = m->tile;
+  size_t i, j;
+  bool ok;
+  if (m->nrows != m->ncols) {
+    raise_error(LINALG_LAYOUT_ERROR);
+  }
+  TRACE_BEGIN(m->nrows, m->ncols);
+  ok = kernel_cholesky_tiles(DATA(m), t, m->tile_cols * t * t, t * t,
+                             m->nrows, t);
+  for (i = 0; i < m->nrows; i++) {
+    for (j = i + 1; j < m->ncols; j++) {
+      TILE_MATRIX_IDX_INTO(m, i, j) = 0;
+    }
+  }
+  TRACE_END();
+  return ok;
+}
+
+bool tile_matrix_equal(tile_matrix_t *m1, tile_matrix_t *m2, double tol) {
+  size_t i, j;
+  if (m1->nrows != m2->nrows || m1->ncols != m2->ncols) {
+    return false;
+  }
+  for (i = 0; i < m1->nrows; i++) {
+    for (j = 0; j < m1->ncols; j++) {
+      if (fabs(TILE_MATRIX_IDX_INTO(m1, i, j) -
+               TILE_MATRIX_IDX_INTO(m2, i, j)) > tol) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,167 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "linalg_trace.h"
+#include "linalg_util.h"
+
+/** Per-thread ring of events, linked into a global list on first use.
+ *
+ *  A thread that exits hands its ring back with its events intact, and the
+ *  next thread to record takes it over instead of allocating another, so
+ *  short-lived threads do not grow the list.
+ */
+typedef struct trace_buffer_t {
+  trace_event_t events[TRACE_BUFFER_CAPACITY];
+  atomic_size_t head;
+  unsigned tid;
+  atomic_bool in_use;
+  struct trace_buffer_t *next;
+} trace_buffer_t;
+
+static atomic_bool trace_is_enabled = false;
+static atomic_uint trace_next_tid = 1;
+static _Atomic(trace_buffer_t *) trace_buffers = NULL;
+static _Thread_local trace_buffer_t *trace_local = NULL;
+static pthread_key_t trace_key;
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+
+static void trace_release(void *buf) {
+  atomic_store_explicit(&((trace_buffer_t *)buf)->in_use, false,
+                        memory_order_release);
+}
+
+static void trace_key_create(void) {
+  if (pthread_key_create(&trace_key, trace_release) != 0) {
+    raise_error(LINALG_UNKNOWN_ERROR);
+  }
+}
+
+static double trace_now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec * 1.0e6 + (double)t.tv_nsec * 1.0e-3;
+}
+
+/** Returns a ring released by an exited thread, or NULL. */
+static trace_buffer_t *trace_reuse_buffer(void) {
+  trace_buffer_t *buf =
+      atomic_load_explicit(&trace_buffers, memory_order_acquire);
+  bool expected;
+  for (; buf != NULL; buf = buf->next) {
+    expected = false;
+    if (atomic_compare_exchange_strong_explicit(&buf->in_use, &expected, true,
+                                                memory_order_acquire,
+                                                memory_order_relaxed)) {
+      return buf;
+    }
+  }
+  return NULL;
+}
+
+static trace_buffer_t *trace_local_buffer(void) {
+  trace_buffer_t *buf = trace_local;
+  if (buf == NULL) {
+    buf = trace_reuse_buffer();
+    if (buf == NULL) {
+      buf = calloc(1, sizeof(trace_buffer_t));
+      CHECK_MEMORY(buf);
+      atomic_init(&buf->head, 0);
+      atomic_init(&buf->in_use, true);
+      buf->next = atomic_load_explicit(&trace_buffers, memory_order_relaxed);
+      while (!atomic_compare_exchange_weak_explicit(
+          &trace_buffers, &buf->next, buf, memory_order_release,
+          memory_order_relaxed)) {
+      }
+    }
+    buf->tid = atomic_fetch_add_explicit(&trace_next_tid, 1,
+                                         memory_order_relaxed);
+    pthread_once(&trace_key_once, trace_key_create);
+    pthread_setspecific(trace_key, buf);
+    trace_local = buf;
+  }
+  return buf;
+}
+
+static void trace_record(const char *name, char phase, size_t rows,
+                         size_t cols) {
+  trace_buffer_t *buf;
+  trace_event_t *e;
+  size_t head;
+  if (!atomic_load_explicit(&trace_is_enabled, memory_order_relaxed)) {
+    return;
+  }
+  buf = trace_local_buffer();
+  head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+  e = &buf->events[head % TRACE_BUFFER_CAPACITY];
+  e->name = name;
+  e->phase = phase;
+  e->tid = buf->tid;
+  e->ts = trace_now();
+  e->rows = rows;
+  e->cols = cols;
+  atomic_store_explicit(&buf->head, head + 1, memory_order_release);
+}
+
+void trace_enable(void) { atomic_store(&trace_is_enabled, true); }
+
+void trace_disable(void) { atomic_store(&trace_is_enabled, false); }
+
+bool trace_enabled(void) { return atomic_load(&trace_is_enabled); }
+
+void trace_begin(const char *name, size_t rows, size_t cols) {
+  trace_record(name, 'B', rows, cols);
+}
+
+void trace_end(const char *name) { trace_record(name, 'E', 0, 0); }
+
+size_t trace_event_count(void) {
+  trace_buffer_t *buf = atomic_load(&trace_buffers);
+  size_t count = 0;
+  size_t head;
+  for (; buf != NULL; buf = buf->next) {
+    head = atomic_load_explicit(&buf->head, memory_order_acquire);
+    count += head < TRACE_BUFFER_CAPACITY ? head : TRACE_BUFFER_CAPACITY;
+  }
+  return count;
+}
+
+void trace_reset(void) {
+  trace_buffer_t *buf = atomic_load(&trace_buffers);
+  for (; buf != NULL; buf = buf->next) {
+    atomic_store_explicit(&buf->head, 0, memory_order_release);
+  }
+}
+
+bool trace_flush(const char *path) {
+  trace_buffer_t *buf = atomic_load(&trace_buffers);
+  trace_event_t *e;
+  size_t head, first, i;
+  bool comma = false;
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    return false;
+  }
+  fprintf(f, "{\"traceEvents\":[\n");
+  for (; buf != NULL; buf = buf->next) {
+    head = atomic_load_explicit(&buf->head, memory_order_acquire);
+    first = head > TRACE_BUFFER_CAPACITY ? head - TRACE_BUFFER_CAPACITY : 0;
+    for (i = first; i < head; i++) {
+      e = &buf->events[i % TRACE_BUFFER_CAPACITY];
+      fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+                 "\"pid\":1,\"tid\":%u",
+              comma ? ",\n" : "", e->name, e->phase, e->ts, e->tid);
+      if (e->phase == 'B') {
+        fprintf(f, ",\"args\":{\"rows\":%zu,\"cols\":%zu}", e->rows, e->cols);
+      }
+      fprintf(f, "}");
+      comma = true;
+    }
+  }
+  fprintf(f, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  return fclose(f) == 0;
+}
@@ -0,0 +1,175 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include "kernels.h"
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_trace.h"
+#include "linalg_tune.h"
+
+/* Every case is reduced to a left-side solve with a lower or upper
+ * triangle. Transposes are expressed by swapping an operand's row and
+ * column strides, and a right-side solve x * op(a) = b is the left-side
+ * solve op(a)^T * x^T = b^T. */
+
+/** Strided view of a dense operand. */
+typedef struct {
+  double *data;
+  size_t rs;
+  size_t cs;
+} trsm_operand_t;
+
+#define TRSM_AT(o, i, j) ((o)->data[(i) * (o)->rs + (j) * (o)->cs])
+
+/** A left-side solve over `n` right-hand sides of length `m`. */
+typedef struct {
+  trsm_operand_t a;
+  trsm_operand_t b;
+  bool lower;
+  bool unit;
+  size_t m;
+  /** Block sizes, read before the columns are handed to the pool. */
+  const tune_params_t *params;
+} trsm_t;
+
+/** Solves the diagonal block [k0, k1) for columns [j0, j1) of `b`. */
+static void trsm_diagonal(const trsm_t *op, size_t k0, size_t k1, size_t j0,
+                          size_t j1) {
+  const trsm_operand_t *a = &op->a;
+  const trsm_operand_t *b = &op->b;
+  size_t r, i, p, j;
+  double aip, d;
+  for (r = 0; r < k1 - k0; r++) {
+    i = op->lower ? k0 + r : k1 - 1 - r;
+    for (p = op->lower ? k0 : i + 1; p < (op->lower ? i : k1); p++) {
+      aip = TRSM_AT(a, i, p);
+      for (j = j0; j < j1; j++) {
+        TRSM_AT(b, i, j) -= aip * TRSM_AT(b, p, j);
+      }
+    }
+    if (!op->unit) {
+      d = 1 / TRSM_AT(a, i, i);
+      for (j = j0; j < j1; j++) {
+        TRSM_AT(b, i, j) *= d;
+      }
+    }
+  }
+}
+
+/** b[i0:i1, j0:j1] -= a[i0:i1, k0:k1] * b[k0:k1, j0:j1] with the packed
+ *  product kernel. A `b` whose rows are not contiguous is updated through
+ *  its transpose, which is. */
+static void trsm_update(const trsm_t *op, size_t i0, size_t i1, size_t k0,
+                        size_t k1, size_t j0, size_t j1) {
+  const tune_params_t *params = op->params;
+  const trsm_operand_t *a = &op->a;
+  const trsm_operand_t *b = &op->b;
+  double *pack;
+  if (i1 <= i0 || j1 <= j0) {
+    return;
+  }
+  pack = kernel_pack_buffer(params->gemm_kc * params->gemm_nc);
+  if (b->cs == 1) {
+    kernel_gemm_strided(&TRSM_AT(b, i0, j0), b->rs, &TRSM_AT(a, i0, k0),
+                        a->rs, a->cs, &TRSM_AT(b, k0, j0), b->rs, b->cs,
+                        i1 - i0, k1 - k0, j1 - j0, -1, 1, params->gemm_kc,
+                        params->gemm_nc, pack);
+  } else {
+    kernel_gemm_strided(&TRSM_AT(b, i0, j0), b->cs, &TRSM_AT(b, k0, j0),
+                        b->cs, b->rs, &TRSM_AT(a, i0, k0), a->cs, a->rs,
+                        j1 - j0, k1 - k0, i1 - i0, -1, 1, params->gemm_kc,
+                        params->gemm_nc, pack);
+  }
+}
+
+/** Solves columns [begin, end) of `b`. */
+static void trsm_range(void *ctx, size_t begin, size_t end) {
+  const trsm_t *op = ctx;
+  size_t nb = MATRIX_TRSM_BLOCK;
+  size_t nblocks = (op->m + nb - 1) / nb;
+  size_t s, k0, k1;
+  for (s = 0; s < nblocks; s++) {
+    k0 = (op->lower ? s : nblocks - 1 - s) * nb;
+    k1 = k0 + nb < op->m ? k0 + nb : op->m;
+    trsm_diagonal(op, k0, k1, begin, end);
+    if (op->lower) {
+      trsm_update(op, k1, op->m, k0, k1, begin, end);
+    } else {
+      trsm_update(op, 0, k0, k0, k1, begin, end);
+    }
+  }
+}
+
+/** Fills the view of op(a) and whether it is lower triangular. */
+static void trsm_triangle(trsm_t *op, matrix_t *a, matrix_uplo_t uplo,
+                          matrix_trans_t trans) {
+  // A transposed operand is read with its strides exchanged, which is
+  // also how a column-major one differs from a row-major one.
+  bool swap = (trans == MATRIX_TRANS) != (a->order == MATRIX_COL_MAJOR);
+  op->a.data = DATA(a);
+  op->a.rs = swap ? 1 : a->ld;
+  op->a.cs = swap ? a->ld : 1;
+  op->lower = (uplo == MATRIX_LOWER) == (trans == MATRIX_NO_TRANS);
+}
+
+void matrix_trsv(matrix_t *a, matrix_uplo_t uplo, matrix_trans_t trans,
+                 matrix_diag_t diag, vector_t *x) {
+  trsm_t op;
+  vector_materialize(x);
+  trsm_triangle(&op, a, uplo, trans);
+  op.b.data = DATA(x);
+  op.b.rs = 1;
+  op.b.cs = 1;
+  op.unit = diag == MATRIX_UNIT;
+  op.m = x->length;
+  op.params = tune_params();
+  TRACE_BEGIN(a->nrows, a->ncols);
+  trsm_range(&op, 0, 1);
+  TRACE_END();
+}
+
+void matrix_trsm(matrix_t *b, matrix_side_t side, matrix_uplo_t uplo,
+                 matrix_trans_t trans, matrix_diag_t diag, double alpha,
+                 matrix_t *a) {
+  trsm_t op;
+  size_t n, i, j, rs, cs, tmp;
+  matrix_materialize(b);
+  trsm_triangle(&op, a, uplo, trans);
+  op.unit = diag == MATRIX_UNIT;
+  op.params = tune_params();
+  op.b.data = DATA(b);
+  if ((side == MATRIX_LEFT) != (b->order == MATRIX_COL_MAJOR)) {
+    op.b.rs = b->ld;
+    op.b.cs = 1;
+  } else {
+    op.b.rs = 1;
+    op.b.cs = b->ld;
+  }
+  if (side == MATRIX_LEFT) {
+    op.m = b->nrows;
+    n = b->ncols;
+  } else {
+    tmp = op.a.rs;
+    op.a.rs = op.a.cs;
+    op.a.cs = tmp;
+    op.lower = !op.lower;
+    op.m = b->ncols;
+    n = b->nrows;
+  }
+  TRACE_BEGIN(b->nrows, b->ncols);
+  if (alpha != 1) {
+    rs = MATRIX_ROW_STRIDE(b);
+    cs = MATRIX_COL_STRIDE(b);
+    for (i = 0; i < b->nrows; i++) {
+      for (j = 0; j < b->ncols; j++) {
+        DATA(b)[i * rs + j * cs] *= alpha;
+      }
+    }
+  }
+  if (parallel_should_split(op.m * op.m / 2 * n, MATRIX_TRSM_THRESHOLD)) {
+    parallel_for(n, trsm_range, &op);
+  } else {
+    trsm_range(&op, 0, n);
+  }
+  TRACE_END();
+}
@@ -0,0 +1,429 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "kernels.h"
+#include "linalg_parallel.h"
+#include "linalg_tune.h"
+#include "linalg_util.h"
+
+/** Longest line read from a profile or from /proc/cpuinfo. */
+#define TUNE_LINE 512
+
+static const char *tune_threshold_keys[VECTOR_OP_COUNT] = {
+    "threshold_constant", "threshold_linspace", "threshold_copy",
+    "threshold_add",      "threshold_sub",      "threshold_scalar_mul"};
+
+static tune_params_t tune_current;
+static atomic_bool tune_ready = false;
+static pthread_mutex_t tune_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Set while this thread initializes the parameters, so that kernels run
+ *  by the autotuner see the values being tuned instead of waiting on the
+ *  lock. */
+static _Thread_local bool tune_initializing = false;
+
+/** Reads the size in bytes of the level `level` data cache of CPU 0 from
+ *  sysfs, returning 0 if it is not available. */
+static size_t tune_cache_size(int level) {
+  char path[128], type[32], size[32];
+  FILE *f;
+  int index, found;
+  size_t bytes;
+  bool ok;
+  for (index = 0; index < 16; index++) {
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+    f = fopen(path, "r");
+    if (f == NULL) {
+      return 0;
+    }
+    ok = fscanf(f, "%d", &found) == 1;
+    fclose(f);
+    if (!ok || found != level) {
+      continue;
+    }
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    f = fopen(path, "r");
+    if (f == NULL || fscanf(f, "%31s", type) != 1) {
+      if (f != NULL) {
+        fclose(f);
+      }
+      continue;
+    }
+    fclose(f);
+    if (strcmp(type, "Instruction") == 0) {
+      continue;
+    }
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    f = fopen(path, "r");
+    // The unit suffix is optional, so a bare byte count leaves `size` empty.
+    size[0] = '\0';
+    if (f == NULL || fscanf(f, "%zu%31s", &bytes, size) < 1) {
+      if (f != NULL) {
+        fclose(f);
+      }
+      continue;
+    }
+    fclose(f);
+    if (size[0] == 'K') {
+      bytes <<= 10;
+    } else if (size[0] == 'M') {
+      bytes <<= 20;
+    }
+    return bytes;
+  }
+  return 0;
+}
+
+static size_t tune_clamp(size_t x, size_t lo, size_t hi) {
+  return x < lo ? lo : (x > hi ? hi : x);
+}
+
+void tune_defaults(tune_params_t *params) {
+  size_t l1 = tune_cache_size(1);
+  size_t l2 = tune_cache_size(2);
+  size_t block;
+  int op;
+  params->gemm_kc = KERNEL_GEMM_KC;
+  params->gemm_nc = KERNEL_GEMM_NC;
+  params->transpose_block = KERNEL_TRANSPOSE_BLOCK;
+  params->gemv_block = KERNEL_GEMV_BLOCK;
+  // The packed panel of b should fill about half of L2.
+  if (l2 > 0) {
+    params->gemm_nc = tune_clamp(
+        l2 / 2 / (sizeof(double) * params->gemm_kc) / 64 * 64, 64, 2048);
+  }
+  // Both tiles of a transpose swap, and half of L1 for the segment of x in
+  // a matrix-vector product.
+  if (l1 > 0) {
+    for (block = 8; 2 * (2 * block) * (2 * block) * sizeof(double) <= l1 / 2;
+         block *= 2) {
+    }
+    params->transpose_block = tune_clamp(block, 8, 128);
+    params->gemv_block = tune_clamp(l1 / 2 / sizeof(double), 256, 65536);
+  }
+  for (op = 0; op < VECTOR_OP_COUNT; op++) {
+    params->vector_thresholds[op] = vector_parallel_threshold(op);
+  }
+}
+
+/** Installs `params` without triggering initialization. */
+static void tune_apply(const tune_params_t *params) {
+  int op;
+  tune_current = *params;
+  for (op = 0; op < VECTOR_OP_COUNT; op++) {
+    vector_set_parallel_threshold(op, params->vector_thresholds[op]);
+  }
+}
+
+static void tune_initialize(void) {
+  const char *path = getenv(TUNE_PROFILE_ENV);
+  tune_params_t params;
+  tune_defaults(&params);
+  if (path != NULL && !tune_load(path, &params) &&
+      getenv(TUNE_AUTOTUNE_ENV) != NULL && tune_run(&params)) {
+    tune_save(path, &params);
+  }
+  tune_apply(&params);
+}
+
+const tune_params_t *tune_params(void) {
+  if (!atomic_load_explicit(&tune_ready, memory_order_acquire) &&
+      !tune_initializing) {
+    pthread_mutex_lock(&tune_lock);
+    if (!atomic_load_explicit(&tune_ready, memory_order_relaxed)) {
+      tune_initializing = true;
+      tune_initialize();
+      tune_initializing = false;
+      atomic_store_explicit(&tune_ready, true, memory_order_release);
+    }
+    pthread_mutex_unlock(&tune_lock);
+  }
+  return &tune_current;
+}
+
+void tune_set_params(const tune_params_t *params) {
+  tune_params();
+  tune_apply(params);
+}
+
+/** Benchmark state shared by the candidates of one kernel. */
+typedef struct {
+  double *a;
+  double *b;
+  double *c;
+  size_t m;
+  size_t k;
+  size_t n;
+  size_t p;
+  size_t q;
+} tune_bench_t;
+
+static double tune_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1.0e-9;
+}
+
+/** Returns the best of three timings of `fn`. */
+static double tune_time(void (*fn)(tune_bench_t *), tune_bench_t *bench) {
+  double best = 0, t0, elapsed;
+  int rep;
+  for (rep = 0; rep < 3; rep++) {
+    t0 = tune_seconds();
+    fn(bench);
+    elapsed = tune_seconds() - t0;
+    if (rep == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+static void tune_bench_gemm(tune_bench_t *b) {
+  kernel_gemm_packed(b->c, b->n, b->a, b->k, b->b, b->n, b->m, b->k, b->n,
+                     b->p, b->q, kernel_pack_buffer(b->p * b->q));
+}
+
+static void tune_bench_transpose(tune_bench_t *b) {
+  kernel_transpose_square(b->a, b->n, b->n, b->p);
+}
+
+static void tune_bench_gemv(tune_bench_t *b) {
+  kernel_gemv(b->c, b->a, b->n, b->b, b->m, b->n, b->p);
+}
+
+/** Allocates `count` doubles filled with a fixed pattern. */
+static double *tune_buffer(size_t count) {
+  double *x = malloc(sizeof(double) * count);
+  size_t i;
+  CHECK_MEMORY(x);
+  for (i = 0; i < count; i++) {
+    x[i] = (double)(i % 17) - 8;
+  }
+  return x;
+}
+
+bool tune_run(tune_params_t *params) {
+  static const size_t kcs[] = {64, 128, 256, 384};
+  static const size_t ncs[] = {128, 256, 512, 1024};
+  static const size_t transposes[] = {8, 16, 32, 64, 128};
+  static const size_t gemvs[] = {256, 512, 1024, 2048, 4096, 16384};
+  size_t thresholds[VECTOR_OP_COUNT];
+  tune_bench_t bench;
+  double best, elapsed;
+  size_t i, j;
+  int op;
+  if (parallel_nested()) {
+    // Every loop would run serially, so the thresholds would be noise.
+    return false;
+  }
+  tune_defaults(params);
+
+  bench.m = 64;
+  bench.k = 512;
+  bench.n = 1024;
+  bench.a = tune_buffer(bench.m * bench.k);
+  bench.b = tune_buffer(bench.k * bench.n);
+  bench.c = tune_buffer(bench.m * bench.n);
+  best = 0;
+  for (i = 0; i < sizeof(kcs) / sizeof(kcs[0]); i++) {
+    for (j = 0; j < sizeof(ncs) / sizeof(ncs[0]); j++) {
+      bench.p = kcs[i];
+      bench.q = ncs[j];
+      elapsed = tune_time(tune_bench_gemm, &bench);
+      if (best == 0 || elapsed < best) {
+        best = elapsed;
+        params->gemm_kc = kcs[i];
+        params->gemm_nc = ncs[j];
+      }
+    }
+  }
+  free(bench.a);
+  free(bench.b);
+  free(bench.c);
+
+  bench.n = 1024;
+  bench.a = tune_buffer(bench.n * bench.n);
+  best = 0;
+  for (i = 0; i < sizeof(transposes) / sizeof(transposes[0]); i++) {
+    bench.p = transposes[i];
+    elapsed = tune_time(tune_bench_transpose, &bench);
+    if (best == 0 || elapsed < best) {
+      best = elapsed;
+      params->transpose_block = transposes[i];
+    }
+  }
+  free(bench.a);
+
+  bench.m = 256;
+  bench.n = 16384;
+  bench.a = tune_buffer(bench.m * bench.n);
+  bench.b = tune_buffer(bench.n);
+  bench.c = tune_buffer(bench.m);
+  best = 0;
+  for (i = 0; i < sizeof(gemvs) / sizeof(gemvs[0]); i++) {
+    bench.p = gemvs[i];
+    elapsed = tune_time(tune_bench_gemv, &bench);
+    if (best == 0 || elapsed < best) {
+      best = elapsed;
+      params->gemv_block = gemvs[i];
+    }
+  }
+  free(bench.a);
+  free(bench.b);
+  free(bench.c);
+
+  // Calibration installs its thresholds, so restore the ones in use.
+  for (op = 0; op < VECTOR_OP_COUNT; op++) {
+    thresholds[op] = vector_parallel_threshold(op);
+  }
+  vector_calibrate_parallel_thresholds();
+  for (op = 0; op < VECTOR_OP_COUNT; op++) {
+    params->vector_thresholds[op] = vector_parallel_threshold(op);
+    vector_set_parallel_threshold(op, thresholds[op]);
+  }
+  return true;
+}
+
+static char tune_model[TUNE_LINE] = "unknown";
+static pthread_once_t tune_model_once = PTHREAD_ONCE_INIT;
+
+static void tune_read_cpu_model(void) {
+  char line[TUNE_LINE];
+  char *value;
+  size_t len;
+  FILE *f = fopen("/proc/cpuinfo", "r");
+  if (f == NULL) {
+    return;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "model name", 10) != 0 ||
+        (value = strchr(line, ':')) == NULL) {
+      continue;
+    }
+    value += strspn(value + 1, " \t") + 1;
+    len = strcspn(value, "\n");
+    if (len > 0) {
+      memcpy(tune_model, value, len);
+      tune_model[len] = '\0';
+    }
+    break;
+  }
+  fclose(f);
+}
+
+const char *tune_cpu_model(void) {
+  pthread_once(&tune_model_once, tune_read_cpu_model);
+  return tune_model;
+}
+
+/** Returns true if `line` opens the profile entry of `model`. */
+static bool tune_is_header(const char *line, const char *model) {
+  size_t len = strlen(model);
+  return line[0] == '[' && strncmp(line + 1, model, len) == 0 &&
+         line[len + 1] == ']';
+}
+
+/** Sets the parameter named `key`, returning false for unknown keys. */
+static bool tune_set_key(tune_params_t *params, const char *key,
+                         size_t value) {
+  int op;
+  if (strcmp(key, "gemm_kc") == 0) {
+    params->gemm_kc = value;
+  } else if (strcmp(key, "gemm_nc") == 0) {
+    params->gemm_nc = value;
+  } else if (strcmp(key, "transpose_block") == 0) {
+    params->transpose_block = value;
+  } else if (strcmp(key, "gemv_block") == 0) {
+    params->gemv_block = value;
+  } else {
+    for (op = 0; op < VECTOR_OP_COUNT; op++) {
+      if (strcmp(key, tune_threshold_keys[op]) == 0) {
+        params->vector_thresholds[op] = value;
+        return true;
+      }
+    }
+    return false;
+  }
+  return true;
+}
+
+bool tune_load(const char *path, tune_params_t *params) {
+  const char *model = tune_cpu_model();
+  char line[TUNE_LINE], key[TUNE_LINE];
+  tune_params_t loaded = *params;
+  bool in_entry = false, found = false;
+  size_t value;
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return false;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '[') {
+      in_entry = tune_is_header(line, model);
+      found = found || in_entry;
+    } else if (in_entry && sscanf(line, "%s %zu", key, &value) == 2 &&
+               value > 0) {
+      tune_set_key(&loaded, key, value);
+    }
+  }
+  fclose(f);
+  if (found) {
+    *params = loaded;
+  }
+  return found;
+}
+
+bool tune_save(const char *path, const tune_params_t *params) {
+  const char *model = tune_cpu_model();
+  char line[TUNE_LINE];
+  char *tmp = malloc(strlen(path) + 5);
+  bool in_entry = false;
+  FILE *in, *out;
+  int op;
+  CHECK_MEMORY(tmp);
+  sprintf(tmp, "%s.tmp", path);
+  out = fopen(tmp, "w");
+  if (out == NULL) {
+    free(tmp);
+    return false;
+  }
+  // Keep every other CPU's entry, then append this one.
+  in = fopen(path, "r");
+  if (in != NULL) {
+    while (fgets(line, sizeof(line), in) != NULL) {
+      if (line[0] == '[') {
+        in_entry = tune_is_header(line, model);
+      }
+      if (!in_entry) {
+        fputs(line, out);
+      }
+    }
+    fclose(in);
+  }
+  fprintf(out, "[%s]\n", model);
+  fprintf(out, "gemm_kc %zu\n", params->gemm_kc);
+  fprintf(out, "gemm_nc %zu\n", params->gemm_nc);
+  fprintf(out, "transpose_block %zu\n", params->transpose_block);
+  fprintf(out, "gemv_block %zu\n", params->gemv_block);
+  for (op = 0; op < VECTOR_OP_COUNT; op++) {
+    fprintf(out, "%s %zu\n", tune_threshold_keys[op],
+            params->vector_thresholds[op]);
+  }
+  if (fclose(out) != 0 || rename(tmp, path) != 0) {
+    remove(tmp);
+    free(tmp);
+    return false;
+  }
+  free(tmp);
+  return true;
+}
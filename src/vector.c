@@ -1,21 +1,186 @@
 // linalg - C89 linear algebra library
 // Copyright (C) Seaton Ullberg and contributors -- MIT license
 
+#include <float.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 
+#include "linalg_memory.h"
+#include "linalg_parallel.h"
+#include "linalg_trace.h"
+#include "linalg_tune.h"
 #include "linalg_util.h"
 #include "linalg_vector.h"
+#include "linalg_vector_inline.h"
+
+/** Operands of an element-wise operation over a range of indices. */
+typedef struct {
+  vector_t *dst;
+  vector_t *v1;
+  vector_t *v2;
+  double a;
+  double b;
+} vector_op_args_t;
+
+/** Lengths from which each `vector_op_t` is split across threads. */
+static atomic_size_t vector_thresholds[VECTOR_OP_COUNT] = {
+    1 << 18, 1 << 16, 1 << 17, 1 << 17, 1 << 17, 1 << 17};
+
+/** Runs `fn` over the whole operation, on the worker pool if worthwhile. */
+static void vector_run(vector_op_t op, size_t length, parallel_fn_t fn,
+                       vector_op_args_t *args) {
+  // Loads a tuning profile's thresholds on first use.
+  tune_params();
+  if (parallel_should_split(length, atomic_load_explicit(
+                                        &vector_thresholds[op],
+                                        memory_order_relaxed))) {
+    parallel_for(length, fn, args);
+  } else {
+    fn(args, 0, length);
+  }
+}
+
+/* The range kernels run after `dst` is materialized, so they write
+ * through its data directly. */
+
+static void vector_constant_range(void *ctx, size_t begin, size_t end) {
+  vector_op_args_t *args = ctx;
+  double *dst = DATA(args->dst);
+  size_t i;
+  for (i = begin; i < end; i++) {
+    dst[i] = args->a;
+  }
+}
+
+static void vector_linspace_range(void *ctx, size_t begin, size_t end) {
+  vector_op_args_t *args = ctx;
+  double *dst = DATA(args->dst);
+  size_t i;
+  for (i = begin; i < end; i++) {
+    dst[i] = args->a + args->b * i;
+  }
+}
+
+static void vector_copy_range(void *ctx, size_t begin, size_t end) {
+  vector_op_args_t *args = ctx;
+  double *dst = DATA(args->dst);
+  const double *v1 = DATA(args->v1);
+  size_t i;
+  for (i = begin; i < end; i++) {
+    dst[i] = v1[i];
+  }
+}
+
+static void vector_add_range(void *ctx, size_t begin, size_t end) {
+  vector_op_args_t *args = ctx;
+  double *dst = DATA(args->dst);
+  const double *v1 = DATA(args->v1), *v2 = DATA(args->v2);
+  size_t i;
+  for (i = begin; i < end; i++) {
+    dst[i] = v1[i] + v2[i];
+  }
+}
+
+static void vector_sub_range(void *ctx, size_t begin, size_t end) {
+  vector_op_args_t *args = ctx;
+  double *dst = DATA(args->dst);
+  const double *v1 = DATA(args->v1), *v2 = DATA(args->v2);
+  size_t i;
+  for (i = begin; i < end; i++) {
+    dst[i] = v1[i] - v2[i];
+  }
+}
+
+static void vector_scalar_mul_range(void *ctx, size_t begin, size_t end) {
+  vector_op_args_t *args = ctx;
+  double *dst = DATA(args->dst);
+  const double *v1 = DATA(args->v1);
+  size_t i;
+  for (i = begin; i < end; i++) {
+    dst[i] = v1[i] * args->a;
+  }
+}
+
+static const parallel_fn_t vector_ranges[VECTOR_OP_COUNT] = {
+    vector_constant_range, vector_linspace_range, vector_copy_range,
+    vector_add_range,      vector_sub_range,      vector_scalar_mul_range};
+
+void vector_set_parallel_threshold(vector_op_t op, size_t length) {
+  atomic_store(&vector_thresholds[op], length);
+}
+
+size_t vector_parallel_threshold(vector_op_t op) {
+  return atomic_load(&vector_thresholds[op]);
+}
+
+/** Returns the best of three timings of `op` over `length` elements. */
+static double vector_time_op(vector_op_t op, vector_op_args_t *args,
+                             size_t length) {
+  struct timespec t0, t1;
+  double elapsed, best = 0;
+  int rep;
+  for (rep = 0; rep < 3; rep++) {
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    vector_run(op, length, vector_ranges[op], args);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1.0e-9;
+    if (rep == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+void vector_calibrate_parallel_thresholds(void) {
+  size_t max_length = (size_t)1 << 22;
+  vector_op_args_t args;
+  parallel_policy_t policy;
+  double serial, parallel;
+  size_t length, threshold;
+  int op, wins;
+  args.dst = vector_zeros(max_length);
+  args.v1 = vector_ones(max_length);
+  args.v2 = vector_ones(max_length);
+  args.a = 2;
+  args.b = 1;
+  for (op = 0; op < VECTOR_OP_COUNT; op++) {
+    threshold = SIZE_MAX;
+    wins = 0;
+    for (length = 1 << 10; length <= max_length && parallel_threads() > 1;
+         length *= 2) {
+      policy = parallel_set_policy(PARALLEL_SERIAL);
+      serial = vector_time_op(op, &args, length);
+      parallel_set_policy(PARALLEL_ALWAYS);
+      parallel = vector_time_op(op, &args, length);
+      parallel_set_policy(policy);
+      wins = parallel < serial ? wins + 1 : 0;
+      if (wins == 2) {
+        threshold = length / 2;
+        break;
+      }
+    }
+    vector_set_parallel_threshold(op, threshold);
+  }
+  vector_free(args.dst);
+  vector_free(args.v1);
+  vector_free(args.v2);
+}
 
 vector_t *vector_new(size_t length) {
   vector_t *v = malloc(sizeof(vector_t));
   CHECK_MEMORY(v);
-  DATA(v) = malloc((sizeof(double)) * length);
-  CHECK_MEMORY(v);
+  DATA(v) = memory_alloc_data(length, 1);
+  CHECK_MEMORY(DATA(v));
   v->length = length;
   OWNS_MEMORY(v) = true;
+  COPY_ON_WRITE(v) = false;
   MEMORY_OWNER(v) = NULL;
-  REF_COUNT(v) = 0;
+  REF_COUNT_INIT(v);
+  memory_track_alloc((linalg_t *)v, "vector",
+                     sizeof(vector_t) + sizeof(double) * length);
   return v;
 }
 
@@ -25,9 +190,11 @@ vector_t *vector_view(linalg_t *parent, double *view, size_t length) {
   DATA(v) = view;
   v->length = length;
   OWNS_MEMORY(v) = false;
+  COPY_ON_WRITE(v) = false;
   MEMORY_OWNER(v) = parent;
-  REF_COUNT(v) = 0;
-  REF_COUNT(parent) += 1;
+  REF_COUNT_INIT(v);
+  REF_COUNT_INCREMENT(parent);
+  memory_track_alloc((linalg_t *)v, "vector view", sizeof(vector_t));
   return v;
 }
 
@@ -42,23 +209,36 @@ vector_t *vector_from_array(double *data, size_t length) {
 
 void vector_free(vector_t *v) {
   linalg_t *memory_owner;
+  double *data;
   CHECK_REF_COUNT(v);
   if (OWNS_MEMORY(v)) {
-    free(DATA(v));
+    memory_track_free((linalg_t *)v,
+                      sizeof(vector_t) + sizeof(double) * v->length);
+    memory_free_data(DATA(v), v->length);
     free(v);
   } else {
+    memory_track_free((linalg_t *)v, sizeof(vector_t));
     memory_owner = MEMORY_OWNER(v);
-    REF_COUNT(memory_owner) -= 1;
+    if (COPY_ON_WRITE(v)) {
+      data = memory_release_shared(memory_owner);
+      if (data != NULL) {
+        memory_free_data(data, v->length);
+      }
+    } else {
+      REF_COUNT_DECREMENT(memory_owner);
+    }
     free(v);
   }
 }
 
 vector_t *vector_constant(size_t length, double c) {
   vector_t *v = vector_new(length);
-  size_t i;
-  for (i = 0; i < v->length; i++) {
-    VECTOR_IDX_INTO(v, i) = c;
-  }
+  vector_op_args_t args;
+  args.dst = v;
+  args.a = c;
+  TRACE_BEGIN(length, 1);
+  vector_run(VECTOR_OP_CONSTANT, length, vector_constant_range, &args);
+  TRACE_END();
   return v;
 }
 
@@ -68,32 +248,84 @@ vector_t *vector_ones(size_t length) { return vector_constant(length, 1); }
 
 vector_t *vector_linspace(size_t length, double min, double max) {
   vector_t *v = vector_new(length);
-  double step = (max - min) / (length - 1);
-  size_t i;
-  for (i = 0; i < v->length; i++) {
-    VECTOR_IDX_INTO(v, i) = min + step * i;
-  }
+  vector_op_args_t args;
+  args.dst = v;
+  args.a = min;
+  args.b = (max - min) / (length - 1);
+  TRACE_BEGIN(length, 1);
+  vector_run(VECTOR_OP_LINSPACE, length, vector_linspace_range, &args);
+  TRACE_END();
   return v;
 }
 
 vector_t *vector_slice(vector_t *v, size_t start, size_t end) {
   size_t length = end - start;
-  double *start_ptr = DATA(v) + start;
-  vector_t *view = vector_view((linalg_t *)v, start_ptr, length);
+  double *start_ptr;
+  vector_t *view;
+  vector_materialize(v);
+  start_ptr = DATA(v) + start;
+  view = vector_view((linalg_t *)v, start_ptr, length);
   return view;
 }
 
 vector_t *vector_copy(vector_t *v) {
-  vector_t *copy = vector_new(v->length);
+  vector_t *copy;
+  linalg_t *shared;
+  // Data that views point into can change under a shared copy.
+  if (linalg_copy_on_write() &&
+      (COPY_ON_WRITE(v) || (OWNS_MEMORY(v) && REF_COUNT_LOAD(v) == 0))) {
+    shared = memory_share((linalg_t *)v, "vector", sizeof(vector_t),
+                          v->length);
+    copy = vector_view(shared, DATA(v), v->length);
+    COPY_ON_WRITE(copy) = true;
+    return copy;
+  }
+  copy = vector_new(v->length);
   vector_copy_into(copy, v);
   return copy;
 }
 
-void vector_copy_into(vector_t *dst, vector_t *v) {
-  size_t i;
-  for (i = 0; i < v->length; i++) {
-    VECTOR_IDX_INTO(dst, i) = VECTOR_IDX_INTO(v, i);
+void vector_materialize(vector_t *v) {
+  linalg_t *shared;
+  double *data, *last;
+  if (!COPY_ON_WRITE(v)) {
+    return;
+  }
+  shared = MEMORY_OWNER(v);
+  if (REF_COUNT_LOAD(shared) == 1) {
+    // The last holder keeps the buffer.
+    data = memory_release_shared(shared);
+  } else {
+    data = memory_alloc_data(v->length, 1);
+    CHECK_MEMORY(data);
+    memcpy(data, DATA(v), sizeof(double) * v->length);
+    last = memory_release_shared(shared);
+    if (last != NULL) {
+      memory_free_data(last, v->length);
+    }
   }
+  memory_track_free((linalg_t *)v, sizeof(vector_t));
+  DATA(v) = data;
+  OWNS_MEMORY(v) = true;
+  COPY_ON_WRITE(v) = false;
+  MEMORY_OWNER(v) = NULL;
+  memory_track_alloc((linalg_t *)v, "vector",
+                     sizeof(vector_t) + sizeof(double) * v->length);
+}
+
+double *vector_data_into(vector_t *v) {
+  vector_materialize(v);
+  return DATA(v);
+}
+
+void vector_copy_into(vector_t *dst, vector_t *v) {
+  vector_op_args_t args;
+  vector_materialize(dst);
+  args.dst = dst;
+  args.v1 = v;
+  TRACE_BEGIN(v->length, 1);
+  vector_run(VECTOR_OP_COPY, v->length, vector_copy_range, &args);
+  TRACE_END();
 }
 
 vector_t *vector_add(vector_t *v1, vector_t *v2) {
@@ -103,10 +335,14 @@ vector_t *vector_add(vector_t *v1, vector_t *v2) {
 }
 
 void vector_add_into(vector_t *dst, vector_t *v1, vector_t *v2) {
-  size_t i;
-  for (i = 0; i < v1->length; i++) {
-    VECTOR_IDX_INTO(dst, i) = VECTOR_IDX_INTO(v1, i) + VECTOR_IDX_INTO(v2, i);
-  }
+  vector_op_args_t args;
+  vector_materialize(dst);
+  args.dst = dst;
+  args.v1 = v1;
+  args.v2 = v2;
+  TRACE_BEGIN(v1->length, 1);
+  vector_run(VECTOR_OP_ADD, v1->length, vector_add_range, &args);
+  TRACE_END();
 }
 
 vector_t *vector_sub(vector_t *v1, vector_t *v2) {
@@ -116,10 +352,14 @@ vector_t *vector_sub(vector_t *v1, vector_t *v2) {
 }
 
 void vector_sub_into(vector_t *dst, vector_t *v1, vector_t *v2) {
-  size_t i;
-  for (i = 0; i < v1->length; i++) {
-    VECTOR_IDX_INTO(dst, i) = VECTOR_IDX_INTO(v1, i) - VECTOR_IDX_INTO(v2, i);
-  }
+  vector_op_args_t args;
+  vector_materialize(dst);
+  args.dst = dst;
+  args.v1 = v1;
+  args.v2 = v2;
+  TRACE_BEGIN(v1->length, 1);
+  vector_run(VECTOR_OP_SUB, v1->length, vector_sub_range, &args);
+  TRACE_END();
 }
 
 vector_t *vector_scalar_mul(vector_t *v, double s) {
@@ -129,10 +369,14 @@ vector_t *vector_scalar_mul(vector_t *v, double s) {
 }
 
 void vector_scalar_mul_into(vector_t *dst, vector_t *v, double s) {
-  size_t i;
-  for (i = 0; i < v->length; i++) {
-    VECTOR_IDX_INTO(dst, i) = VECTOR_IDX_INTO(v, i) * s;
-  }
+  vector_op_args_t args;
+  vector_materialize(dst);
+  args.dst = dst;
+  args.v1 = v;
+  args.a = s;
+  TRACE_BEGIN(v->length, 1);
+  vector_run(VECTOR_OP_SCALAR_MUL, v->length, vector_scalar_mul_range, &args);
+  TRACE_END();
 }
 
 vector_t *vector_normalize(vector_t *v) {
@@ -145,22 +389,14 @@ vector_t *vector_normalize(vector_t *v) {
 void vector_normalize_into(vector_t *dst, vector_t *v) {
   double norm = vector_norm(v);
   size_t i;
+  vector_materialize(dst);
+  TRACE_BEGIN(v->length, 1);
   for (i = 0; i < v->length; i++) {
-    VECTOR_IDX_INTO(dst, i) = VECTOR_IDX_INTO(v, i) / norm;
+    VECTOR_IDX_INTO(dst, i) = VECTOR_AT(v, i) / norm;
   }
+  TRACE_END();
 }
 
-double vector_dot(vector_t *v1, vector_t *v2) {
-  double prod = 0;
-  size_t i;
-  for (i = 0; i < v1->length; i++) {
-    prod += VECTOR_IDX_INTO(v1, i) * VECTOR_IDX_INTO(v2, i);
-  }
-  return prod;
-}
-
-double vector_norm(vector_t *v) { return sqrt(vector_dot(v, v)); }
-
 char *vector_to_string(vector_t *v) {
   int bufsize = 256; // arbitrary buffer size
   char s[bufsize];
@@ -168,7 +404,7 @@ char *vector_to_string(vector_t *v) {
   strcpy(str, "[");
   size_t i;
   for (i = 0; i < v->length; i++) {
-    sprintf(s, "%f", VECTOR_IDX_INTO(v, i));
+    sprintf(s, "%f", VECTOR_AT(v, i));
     strcat(str, s);
     if (i != v->length - 1) {
       strcat(str, ", ");
@@ -177,16 +413,3 @@ char *vector_to_string(vector_t *v) {
   strcat(str, "]");
   return str;
 }
-
-bool vector_equal(vector_t *v1, vector_t *v2, double tol) {
-  if (v1->length != v2->length) {
-    return false;
-  }
-  size_t i;
-  for (i = 0; i < v1->length; i++) {
-    if (fabs(VECTOR_IDX_INTO(v1, i) - VECTOR_IDX_INTO(v2, i)) > tol) {
-      return false;
-    }
-  }
-  return true;
-}
\ No newline at end of file
@@ -0,0 +1,82 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+
+#include "linalg_parallel.h"
+#include "linalg_trace.h"
+#include "linalg_vector.h"
+#include "map.h"
+
+/** Operands of a map over a range of indices. */
+typedef struct {
+  vector_t *dst;
+  vector_t *v;
+  double (*fn)(double);
+} vector_map_args_t;
+
+#define VECTOR_MAP_RANGE(name, expr)                                  \
+  static void name(void *ctx, size_t begin, size_t end) {             \
+    vector_map_args_t *args = ctx;                                    \
+    const double *in = DATA(args->v);                                 \
+    double *out = DATA(args->dst);                                    \
+    size_t i;                                                         \
+    (void)args->fn;                                                   \
+    for (i = begin; i < end; i++) {                                   \
+      out[i] = expr;                                                  \
+    }                                                                 \
+  }
+
+VECTOR_MAP_RANGE(vector_map_range, args->fn(in[i]))
+VECTOR_MAP_RANGE(vector_map_exp_range, map_exp(in[i]))
+VECTOR_MAP_RANGE(vector_map_log_range, map_log(in[i]))
+VECTOR_MAP_RANGE(vector_map_sqrt_range, sqrt(in[i]))
+VECTOR_MAP_RANGE(vector_map_tanh_range, map_tanh(in[i]))
+VECTOR_MAP_RANGE(vector_map_sigmoid_range, map_sigmoid(in[i]))
+
+/** Runs a map in chunks of `VECTOR_MAP_CHUNK` elements, spread over the
+ *  worker pool once the vector reaches `VECTOR_MAP_THRESHOLD`. */
+static void vector_map_run(vector_t *dst, vector_t *v, parallel_fn_t range,
+                           double (*fn)(double)) {
+  vector_map_args_t args;
+  size_t begin;
+  vector_materialize(dst);
+  args.dst = dst;
+  args.v = v;
+  args.fn = fn;
+  TRACE_BEGIN(v->length, 1);
+  if (parallel_should_split(v->length, VECTOR_MAP_THRESHOLD)) {
+    parallel_for_dynamic(v->length, VECTOR_MAP_CHUNK, range, &args);
+  } else {
+    for (begin = 0; begin < v->length; begin += VECTOR_MAP_CHUNK) {
+      range(&args, begin,
+            begin + VECTOR_MAP_CHUNK < v->length ? begin + VECTOR_MAP_CHUNK
+                                                 : v->length);
+    }
+  }
+  TRACE_END();
+}
+
+void vector_map_into(vector_t *dst, vector_t *v, double (*fn)(double)) {
+  vector_map_run(dst, v, vector_map_range, fn);
+}
+
+void vector_map_exp_into(vector_t *dst, vector_t *v) {
+  vector_map_run(dst, v, vector_map_exp_range, NULL);
+}
+
+void vector_map_log_into(vector_t *dst, vector_t *v) {
+  vector_map_run(dst, v, vector_map_log_range, NULL);
+}
+
+void vector_map_sqrt_into(vector_t *dst, vector_t *v) {
+  vector_map_run(dst, v, vector_map_sqrt_range, NULL);
+}
+
+void vector_map_tanh_into(vector_t *dst, vector_t *v) {
+  vector_map_run(dst, v, vector_map_tanh_range, NULL);
+}
+
+void vector_map_sigmoid_into(vector_t *dst, vector_t *v) {
+  vector_map_run(dst, v, vector_map_sigmoid_range, NULL);
+}
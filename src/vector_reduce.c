@@ -0,0 +1,601 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <float.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "linalg_parallel.h"
+#include "linalg_trace.h"
+#include "linalg_util.h"
+#include "linalg_vector.h"
+
+/* Blue's constants for the scaled L2 norm, as in LAPACK's dnrm2: squares of
+ * elements in [tsml, tbig] neither overflow nor underflow, the others are
+ * accumulated after scaling by ssml or sbig. */
+#define REDUCE_TSML 1.4916681462400413e-154 /* 2^-511 */
+#define REDUCE_TBIG 1.9979190722022350e+146 /* 2^486 */
+#define REDUCE_SSML 4.4989137945431964e+161 /* 2^537 */
+#define REDUCE_SBIG 1.1113793747425387e-162 /* 2^-538 */
+
+/** Number of interleaved accumulators within a reproducible block. */
+#define REDUCE_LANES 8
+
+/** Elements per chunk of the scaled L2 norm, see `reduce_nrm2`. */
+#define REDUCE_NRM2_CHUNK 512
+
+/* Reproducible blocks must round every product and sum on its own, so
+ * `x * y + lane` may not be contracted into an FMA on targets that have one. */
+#if defined(__GNUC__) && !defined(__clang__)
+#define REDUCE_NO_CONTRACT __attribute__((optimize("fp-contract=off")))
+#define REDUCE_NO_CONTRACT_BODY
+#elif defined(__clang__)
+#define REDUCE_NO_CONTRACT
+#define REDUCE_NO_CONTRACT_BODY _Pragma("STDC FP_CONTRACT OFF")
+#else
+#define REDUCE_NO_CONTRACT
+#define REDUCE_NO_CONTRACT_BODY
+#endif
+
+static atomic_bool vector_reproducible_mode = false;
+
+void vector_set_reproducible(bool enabled) {
+  atomic_store(&vector_reproducible_mode, enabled);
+}
+
+bool vector_reproducible(void) {
+  return atomic_load(&vector_reproducible_mode);
+}
+
+/** Partial result of a reduction over one block of a vector. */
+typedef struct {
+  double a;
+  double b;
+  double c;
+  size_t index;
+  size_t count;
+} vector_partial_t;
+
+typedef void (*vector_reduce_fn_t)(const double *x, size_t begin, size_t end,
+                                   vector_partial_t *out);
+typedef void (*vector_merge_fn_t)(vector_partial_t *acc,
+                                  const vector_partial_t *p);
+
+/** One reduction split into blocks whose partials are merged in order. */
+typedef struct {
+  const double *x;
+  size_t length;
+  size_t nblocks;
+  vector_partial_t *partials;
+  vector_reduce_fn_t reduce;
+} vector_reduction_t;
+
+static void vector_reduce_blocks(void *ctx, size_t begin, size_t end) {
+  vector_reduction_t *r = ctx;
+  size_t b, first, last;
+  for (b = begin; b < end; b++) {
+    parallel_chunk(r->length, r->nblocks, b, &first, &last);
+    r->reduce(r->x, first, last, &r->partials[b]);
+  }
+}
+
+/** Reduces `v` into `out`, one block per thread above
+ *  `VECTOR_REDUCE_THRESHOLD` and in a single block otherwise. */
+static void vector_reduce(vector_t *v, vector_reduce_fn_t reduce,
+                          vector_merge_fn_t merge, vector_partial_t *out) {
+  vector_reduction_t r;
+  size_t b;
+  if (!parallel_should_split(v->length, VECTOR_REDUCE_THRESHOLD) ||
+      parallel_threads() < 2 || vector_reproducible()) {
+    reduce(DATA(v), 0, v->length, out);
+    return;
+  }
+  r.x = DATA(v);
+  r.length = v->length;
+  r.nblocks = parallel_threads();
+  r.reduce = reduce;
+  r.partials = malloc(sizeof(vector_partial_t) * r.nblocks);
+  CHECK_MEMORY(r.partials);
+  parallel_for(r.nblocks, vector_reduce_blocks, &r);
+  *out = r.partials[0];
+  for (b = 1; b < r.nblocks; b++) {
+    merge(out, &r.partials[b]);
+  }
+  free(r.partials);
+}
+
+static void reduce_sum(const double *x, size_t begin, size_t end,
+                       vector_partial_t *out) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    s0 += x[i];
+    s1 += x[i + 1];
+    s2 += x[i + 2];
+    s3 += x[i + 3];
+  }
+  for (; i < end; i++) {
+    s0 += x[i];
+  }
+  out->a = (s0 + s1) + (s2 + s3);
+}
+
+static void merge_sum(vector_partial_t *acc, const vector_partial_t *p) {
+  acc->a += p->a;
+}
+
+static void reduce_prod(const double *x, size_t begin, size_t end,
+                        vector_partial_t *out) {
+  double p = 1;
+  size_t i;
+  for (i = begin; i < end; i++) {
+    p *= x[i];
+  }
+  out->a = p;
+}
+
+static void merge_prod(vector_partial_t *acc, const vector_partial_t *p) {
+  acc->a *= p->a;
+}
+
+/* `c ? a : b` as bit operations, as in vector_map.c: the lane loops below
+ * only vectorize when their bodies are free of control flow. */
+static inline double reduce_select(bool c, double a, double b) {
+  uint64_t ua, ub, mask = -(uint64_t)c;
+  memcpy(&ua, &a, sizeof(ua));
+  memcpy(&ub, &b, sizeof(ub));
+  ua = (ua & mask) | (ub & ~mask);
+  memcpy(&a, &ua, sizeof(a));
+  return a;
+}
+
+/* The smaller and larger of a running `m` and `x`. A NaN on either side is
+ * sticky, so min and max propagate NaN wherever it sits. */
+static inline double reduce_min2(double m, double x) {
+  return reduce_select((x < m) | (x != x), x, m);
+}
+
+static inline double reduce_max2(double m, double x) {
+  return reduce_select((x > m) | (x != x), x, m);
+}
+
+/** Folds `x[begin..end)` into `REDUCE_LANES` running minima (or maxima). */
+static double reduce_extreme(const double *x, size_t begin, size_t end,
+                             bool max) {
+  double lanes[REDUCE_LANES], m = max ? -HUGE_VAL : HUGE_VAL;
+  size_t i, j;
+  for (j = 0; j < REDUCE_LANES; j++) {
+    lanes[j] = m;
+  }
+  if (max) {
+    for (i = begin; i + REDUCE_LANES <= end; i += REDUCE_LANES) {
+      for (j = 0; j < REDUCE_LANES; j++) {
+        lanes[j] = reduce_max2(lanes[j], x[i + j]);
+      }
+    }
+  } else {
+    for (i = begin; i + REDUCE_LANES <= end; i += REDUCE_LANES) {
+      for (j = 0; j < REDUCE_LANES; j++) {
+        lanes[j] = reduce_min2(lanes[j], x[i + j]);
+      }
+    }
+  }
+  for (; i < end; i++) {
+    m = max ? reduce_max2(m, x[i]) : reduce_min2(m, x[i]);
+  }
+  for (j = 0; j < REDUCE_LANES; j++) {
+    m = max ? reduce_max2(m, lanes[j]) : reduce_min2(m, lanes[j]);
+  }
+  return m;
+}
+
+/** Index of the first element of `x[begin..end)` equal to `m`, or of the
+ *  first NaN when `m` is NaN. */
+static size_t reduce_find(const double *x, size_t begin, size_t end,
+                          double m) {
+  size_t i;
+  if (m != m) {
+    for (i = begin; i < end && x[i] == x[i]; i++) {
+    }
+  } else {
+    for (i = begin; i < end && x[i] != m; i++) {
+    }
+  }
+  return i;
+}
+
+static void reduce_min(const double *x, size_t begin, size_t end,
+                       vector_partial_t *out) {
+  out->a = end > begin ? reduce_extreme(x, begin, end, false) : NAN;
+  out->count = end - begin;
+}
+
+static void reduce_max(const double *x, size_t begin, size_t end,
+                       vector_partial_t *out) {
+  out->a = end > begin ? reduce_extreme(x, begin, end, true) : NAN;
+  out->count = end - begin;
+}
+
+static void reduce_argmin(const double *x, size_t begin, size_t end,
+                          vector_partial_t *out) {
+  reduce_min(x, begin, end, out);
+  out->index = reduce_find(x, begin, end, out->a);
+}
+
+static void reduce_argmax(const double *x, size_t begin, size_t end,
+                          vector_partial_t *out) {
+  reduce_max(x, begin, end, out);
+  out->index = reduce_find(x, begin, end, out->a);
+}
+
+/* Blocks are merged in order, so a later block wins only with a strictly
+ * better value, or with the first NaN. */
+static void merge_min(vector_partial_t *acc, const vector_partial_t *p) {
+  if (p->count > 0 &&
+      (acc->count == 0 ||
+       (acc->a == acc->a && (p->a < acc->a || p->a != p->a)))) {
+    *acc = *p;
+  }
+}
+
+static void merge_max(vector_partial_t *acc, const vector_partial_t *p) {
+  if (p->count > 0 &&
+      (acc->count == 0 ||
+       (acc->a == acc->a && (p->a > acc->a || p->a != p->a)))) {
+    *acc = *p;
+  }
+}
+
+static void reduce_l1(const double *x, size_t begin, size_t end,
+                      vector_partial_t *out) {
+  double s = 0;
+  size_t i;
+  for (i = begin; i < end; i++) {
+    s += fabs(x[i]);
+  }
+  out->a = s;
+}
+
+static void reduce_linf(const double *x, size_t begin, size_t end,
+                        vector_partial_t *out) {
+  double lanes[REDUCE_LANES] = {0}, m = 0;
+  size_t i, j;
+  for (i = begin; i + REDUCE_LANES <= end; i += REDUCE_LANES) {
+    for (j = 0; j < REDUCE_LANES; j++) {
+      lanes[j] = reduce_max2(lanes[j], fabs(x[i + j]));
+    }
+  }
+  for (; i < end; i++) {
+    m = reduce_max2(m, fabs(x[i]));
+  }
+  for (j = 0; j < REDUCE_LANES; j++) {
+    m = reduce_max2(m, lanes[j]);
+  }
+  out->a = m;
+}
+
+static void merge_linf(vector_partial_t *acc, const vector_partial_t *p) {
+  acc->a = reduce_max2(acc->a, p->a);
+}
+
+/** Welford's update: `a` is the running mean, `b` the sum of squared
+ *  deviations from it. */
+static void reduce_moments(const double *x, size_t begin, size_t end,
+                           vector_partial_t *out) {
+  double mean = 0, m2 = 0, delta;
+  size_t i, n = 0;
+  for (i = begin; i < end; i++) {
+    n += 1;
+    delta = x[i] - mean;
+    mean += delta / n;
+    m2 += delta * (x[i] - mean);
+  }
+  out->a = mean;
+  out->b = m2;
+  out->count = n;
+}
+
+/** Chan et al.'s pairwise combination of two sets of moments. */
+static void merge_moments(vector_partial_t *acc, const vector_partial_t *p) {
+  size_t n = acc->count + p->count;
+  double delta = p->a - acc->a;
+  if (p->count == 0) {
+    return;
+  }
+  acc->a += delta * p->count / n;
+  acc->b += p->b + delta * delta * ((double)acc->count * p->count / n);
+  acc->count = n;
+}
+
+/** Adds the square of `ax` >= 0 to the accumulator it belongs to and zero
+ *  to the other two. NaN lands in the medium accumulator. */
+static inline void reduce_blue(double ax, double *big, double *med,
+                               double *sml) {
+  bool isbig = ax > REDUCE_TBIG, issml = ax < REDUCE_TSML;
+  double b = reduce_select(isbig, ax * REDUCE_SBIG, 0);
+  double s = reduce_select(issml, ax * REDUCE_SSML, 0);
+  double m = reduce_select(isbig | issml, 0, ax);
+  *big += b * b;
+  *med += m * m;
+  *sml += s * s;
+}
+
+/** Blue's three accumulators: `a` big, `b` medium and `c` small. Each
+ *  chunk of `REDUCE_NRM2_CHUNK` elements is first summed as plain squares,
+ *  which is exact enough when that sum is neither tiny nor huge; only the
+ *  other chunks are summed again, from cache, into the three accumulators. */
+static void reduce_nrm2(const double *x, size_t begin, size_t end,
+                        vector_partial_t *out) {
+  double s0, s1, s2, s3, s;
+  size_t i, j, n;
+  out->a = out->b = out->c = 0;
+  for (i = begin; i < end; i += n) {
+    n = end - i < REDUCE_NRM2_CHUNK ? end - i : REDUCE_NRM2_CHUNK;
+    s0 = s1 = s2 = s3 = 0;
+    for (j = i; j + 4 <= i + n; j += 4) {
+      s0 += x[j] * x[j];
+      s1 += x[j + 1] * x[j + 1];
+      s2 += x[j + 2] * x[j + 2];
+      s3 += x[j + 3] * x[j + 3];
+    }
+    for (; j < i + n; j++) {
+      s0 += x[j] * x[j];
+    }
+    s = (s0 + s1) + (s2 + s3);
+    if (s >= DBL_MIN / DBL_EPSILON && s <= REDUCE_TBIG * REDUCE_TBIG) {
+      out->b += s;
+      continue;
+    }
+    for (j = i; j < i + n; j++) {
+      reduce_blue(fabs(x[j]), &out->a, &out->b, &out->c);
+    }
+  }
+}
+
+static void merge_nrm2(vector_partial_t *acc, const vector_partial_t *p) {
+  acc->a += p->a;
+  acc->b += p->b;
+  acc->c += p->c;
+}
+
+/** Sums `x[0..n)` (times `y[0..n)` when given) into `REDUCE_LANES`
+ *  interleaved lanes combined by a fixed tree. */
+REDUCE_NO_CONTRACT static double reduce_block(const double *x,
+                                              const double *y, size_t n) {
+  REDUCE_NO_CONTRACT_BODY
+  double lanes[REDUCE_LANES] = {0};
+  size_t i, j;
+  if (y != NULL) {
+    for (i = 0; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+      for (j = 0; j < REDUCE_LANES; j++) {
+        lanes[j] += x[i + j] * y[i + j];
+      }
+    }
+    for (j = 0; i + j < n; j++) {
+      lanes[j] += x[i + j] * y[i + j];
+    }
+  } else {
+    for (i = 0; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+      for (j = 0; j < REDUCE_LANES; j++) {
+        lanes[j] += x[i + j];
+      }
+    }
+    for (j = 0; i + j < n; j++) {
+      lanes[j] += x[i + j];
+    }
+  }
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+         ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+/** Combines `p[0..n)` by recursive halving. */
+static double reduce_pairwise(const double *p, size_t n) {
+  size_t half;
+  if (n == 0) {
+    return 0;
+  }
+  if (n == 1) {
+    return p[0];
+  }
+  half = n / 2;
+  return reduce_pairwise(p, half) + reduce_pairwise(p + half, n - half);
+}
+
+typedef struct {
+  const double *x;
+  const double *y;
+  size_t length;
+  double *partials;
+} vector_reproducible_t;
+
+static void vector_reproducible_blocks(void *ctx, size_t begin, size_t end) {
+  vector_reproducible_t *r = ctx;
+  size_t b, first, last;
+  for (b = begin; b < end; b++) {
+    first = b * VECTOR_REPRODUCIBLE_BLOCK;
+    last = first + VECTOR_REPRODUCIBLE_BLOCK;
+    last = last < r->length ? last : r->length;
+    r->partials[b] = reduce_block(r->x + first,
+                                  r->y != NULL ? r->y + first : NULL,
+                                  last - first);
+  }
+}
+
+/** Reduces `x` (or `x * y`) block by block, spreading blocks over the
+ *  pool above `VECTOR_REDUCE_THRESHOLD`. */
+static double vector_reduce_reproducible(const double *x, const double *y,
+                                         size_t length) {
+  vector_reproducible_t r;
+  size_t nblocks = (length + VECTOR_REPRODUCIBLE_BLOCK - 1) /
+                   VECTOR_REPRODUCIBLE_BLOCK;
+  double result;
+  if (nblocks <= 1) {
+    return reduce_block(x, y, length);
+  }
+  r.x = x;
+  r.y = y;
+  r.length = length;
+  r.partials = malloc(sizeof(double) * nblocks);
+  CHECK_MEMORY(r.partials);
+  if (parallel_should_split(length, VECTOR_REDUCE_THRESHOLD)) {
+    parallel_for(nblocks, vector_reproducible_blocks, &r);
+  } else {
+    vector_reproducible_blocks(&r, 0, nblocks);
+  }
+  result = reduce_pairwise(r.partials, nblocks);
+  free(r.partials);
+  return result;
+}
+
+double vector_dot_reproducible(vector_t *v1, vector_t *v2) {
+  double result;
+  TRACE_BEGIN(v1->length, 1);
+  result = vector_reduce_reproducible(DATA(v1), DATA(v2), v1->length);
+  TRACE_END();
+  return result;
+}
+
+double vector_sum_reproducible(vector_t *v) {
+  double result;
+  TRACE_BEGIN(v->length, 1);
+  result = vector_reduce_reproducible(DATA(v), NULL, v->length);
+  TRACE_END();
+  return result;
+}
+
+double vector_norm_reproducible(vector_t *v) {
+  double norm;
+  TRACE_BEGIN(v->length, 1);
+  norm = vector_reduce_reproducible(DATA(v), DATA(v), v->length);
+  if (isfinite(norm) && norm >= DBL_MIN / DBL_EPSILON) {
+    norm = sqrt(norm);
+  } else {
+    norm = vector_norm_scaled(v);
+  }
+  TRACE_END();
+  return norm;
+}
+
+double vector_sum(vector_t *v) {
+  vector_partial_t r;
+  if (vector_reproducible()) {
+    return vector_sum_reproducible(v);
+  }
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_sum, merge_sum, &r);
+  TRACE_END();
+  return r.a;
+}
+
+double vector_prod(vector_t *v) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_prod, merge_prod, &r);
+  TRACE_END();
+  return r.a;
+}
+
+double vector_min(vector_t *v) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_min, merge_min, &r);
+  TRACE_END();
+  return r.a;
+}
+
+double vector_max(vector_t *v) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_max, merge_max, &r);
+  TRACE_END();
+  return r.a;
+}
+
+size_t vector_argmin(vector_t *v) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_argmin, merge_min, &r);
+  TRACE_END();
+  return r.index;
+}
+
+size_t vector_argmax(vector_t *v) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_argmax, merge_max, &r);
+  TRACE_END();
+  return r.index;
+}
+
+double vector_norm_l1(vector_t *v) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_l1, merge_sum, &r);
+  TRACE_END();
+  return r.a;
+}
+
+double vector_norm_inf(vector_t *v) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_linf, merge_linf, &r);
+  TRACE_END();
+  return r.a;
+}
+
+void vector_mean_variance(vector_t *v, double *mean, double *variance) {
+  vector_partial_t r;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_moments, merge_moments, &r);
+  TRACE_END();
+  *mean = r.count > 0 ? r.a : NAN;
+  *variance = r.count > 0 ? r.b / r.count : NAN;
+}
+
+double vector_mean(vector_t *v) {
+  double mean, variance;
+  vector_mean_variance(v, &mean, &variance);
+  return mean;
+}
+
+double vector_variance(vector_t *v) {
+  double mean, variance;
+  vector_mean_variance(v, &mean, &variance);
+  return variance;
+}
+
+double vector_norm_scaled(vector_t *v) {
+  vector_partial_t r;
+  double abig, amed, asml, ymin, ymax, scl, sumsq;
+  TRACE_BEGIN(v->length, 1);
+  vector_reduce(v, reduce_nrm2, merge_nrm2, &r);
+  TRACE_END();
+  abig = r.a;
+  amed = r.b;
+  asml = r.c;
+  if (abig > 0) {
+    if (amed > 0 || amed != amed) {
+      abig += (amed * REDUCE_SBIG) * REDUCE_SBIG;
+    }
+    scl = 1 / REDUCE_SBIG;
+    sumsq = abig;
+  } else if (asml > 0) {
+    if (amed > 0 || amed != amed) {
+      amed = sqrt(amed);
+      asml = sqrt(asml) / REDUCE_SSML;
+      ymin = asml > amed ? amed : asml;
+      ymax = asml > amed ? asml : amed;
+      scl = 1;
+      sumsq = ymax * ymax * (1 + (ymin / ymax) * (ymin / ymax));
+    } else {
+      scl = 1 / REDUCE_SSML;
+      sumsq = asml;
+    }
+  } else {
+    scl = 1;
+    sumsq = amed;
+  }
+  return scl * sqrt(sumsq);
+}
@@ -0,0 +1,213 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+
+#include "linalg_expr.h"
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+static double expr_test_square(double x) { return x * x; }
+
+UTEST(expr_tests, test_expr_fused_chain) {
+  expr_graph_t* g = expr_graph_new();
+  vector_t* a = vector_random_uniform(1000, -1.0, 1.0, 1);
+  vector_t* b = vector_random_uniform(1000, -1.0, 1.0, 2);
+  vector_t* c = vector_random_uniform(1000, -1.0, 1.0, 3);
+  expr_t *ea = expr_vector(g, a), *eb = expr_vector(g, b),
+         *ec = expr_vector(g, c);
+  // map((a + 2b) * c - a, square), with a read twice.
+  expr_t* e = expr_map(
+      g, expr_sub(g, expr_mul(g, expr_add(g, ea, expr_scale(g, eb, 2.0)), ec),
+                  ea),
+      expr_test_square);
+  vector_t* res = expr_eval(g, e);
+  double x;
+  size_t i;
+  for (i = 0; i < 1000; i++) {
+    x = (VECTOR_IDX_INTO(a, i) + 2.0 * VECTOR_IDX_INTO(b, i)) *
+            VECTOR_IDX_INTO(c, i) -
+        VECTOR_IDX_INTO(a, i);
+    ASSERT_EQ(VECTOR_IDX_INTO(res, i), x * x);
+  }
+  vector_free(res);
+  vector_free(a);
+  vector_free(b);
+  vector_free(c);
+  expr_graph_free(g);
+}
+
+UTEST(expr_tests, test_expr_normalize) {
+  expr_graph_t* g = expr_graph_new();
+  vector_t* a = vector_random_uniform(777, -1.0, 1.0, 4);
+  vector_t* b = vector_random_uniform(777, -1.0, 1.0, 5);
+  vector_t* c = vector_random_uniform(777, -1.0, 1.0, 6);
+  vector_t* res = vector_new(777);
+  vector_t* target = vector_sub(a, c);
+  vector_t* t = vector_scalar_mul(b, 0.5);
+  expr_t* e = expr_normalize(
+      g, expr_sub(g,
+                  expr_add(g, expr_vector(g, a),
+                           expr_scale(g, expr_vector(g, b), 0.5)),
+                  expr_vector(g, c)));
+  size_t i;
+  vector_add_into(target, target, t);
+  vector_normalize_into(target, target);
+  expr_eval_into(g, e, res);
+  for (i = 0; i < 777; i++) {
+    ASSERT_TRUE(fabs(VECTOR_IDX_INTO(res, i) - VECTOR_IDX_INTO(target, i)) <
+                1e-12);
+  }
+  ASSERT_TRUE(fabs(vector_norm(res) - 1.0) < 1e-12);
+  // A normalize inside a larger expression is evaluated as a barrier.
+  e = expr_add(g, e, expr_vector(g, a));
+  expr_eval_into(g, e, res);
+  for (i = 0; i < 777; i++) {
+    ASSERT_TRUE(fabs(VECTOR_IDX_INTO(res, i) - VECTOR_IDX_INTO(target, i) -
+                     VECTOR_IDX_INTO(a, i)) < 1e-12);
+  }
+  vector_free(a);
+  vector_free(b);
+  vector_free(c);
+  vector_free(res);
+  vector_free(target);
+  vector_free(t);
+  expr_graph_free(g);
+}
+
+UTEST(expr_tests, test_expr_matrix_vector_mul) {
+  expr_graph_t* g = expr_graph_new();
+  matrix_t* m = matrix_random_uniform(30, 20, -1.0, 1.0, 7);
+  vector_t* x = vector_random_uniform(20, -1.0, 1.0, 8);
+  vector_t* y = vector_random_uniform(20, -1.0, 1.0, 9);
+  vector_t* z = vector_random_uniform(30, -1.0, 1.0, 10);
+  vector_t* sum = vector_add(x, y);
+  vector_t* mv = matrix_vector_mul(m, sum);
+  vector_t* res;
+  matrix_t* col;
+  // m (x + y) - 3 z, and the same product used twice.
+  expr_t* p = expr_matrix_vector_mul(
+      g, m, expr_add(g, expr_vector(g, x), expr_vector(g, y)));
+  expr_t* e = expr_sub(g, p, expr_scale(g, expr_vector(g, z), 3.0));
+  size_t i;
+  res = expr_eval(g, e);
+  for (i = 0; i < 30; i++) {
+    ASSERT_TRUE(fabs(VECTOR_IDX_INTO(res, i) -
+                     (VECTOR_IDX_INTO(mv, i) - 3.0 * VECTOR_IDX_INTO(z, i))) <
+                1e-12);
+  }
+  vector_free(res);
+  res = expr_eval(g, expr_mul(g, p, p));
+  for (i = 0; i < 30; i++) {
+    ASSERT_TRUE(fabs(VECTOR_IDX_INTO(res, i) -
+                     VECTOR_IDX_INTO(mv, i) * VECTOR_IDX_INTO(mv, i)) < 1e-12);
+  }
+  vector_free(res);
+  // A column-major matrix gives the same product.
+  col = matrix_copy_order(m, MATRIX_COL_MAJOR);
+  res = expr_eval(g, expr_matrix_vector_mul(g, col, expr_vector(g, sum)));
+  ASSERT_TRUE(vector_equal(res, mv, 1e-12));
+  vector_free(res);
+  matrix_free(col);
+  matrix_free(m);
+  vector_free(x);
+  vector_free(y);
+  vector_free(z);
+  vector_free(sum);
+  vector_free(mv);
+  expr_graph_free(g);
+}
+
+UTEST(expr_tests, test_expr_aliased_destination) {
+  expr_graph_t* g = expr_graph_new();
+  vector_t* a = vector_constant(300, 2.0);
+  vector_t* b = vector_constant(300, 3.0);
+  expr_t *ea = expr_vector(g, a), *eb = expr_vector(g, b);
+  size_t i;
+  // a = a * b + a
+  expr_eval_into(g, expr_add(g, expr_mul(g, ea, eb), ea), a);
+  for (i = 0; i < 300; i++) {
+    ASSERT_EQ(VECTOR_IDX_INTO(a, i), 8.0);
+  }
+  // b = a, a bare leaf, is a copy.
+  expr_eval_into(g, ea, b);
+  ASSERT_EQ(VECTOR_IDX_INTO(b, 299), 8.0);
+  vector_free(a);
+  vector_free(b);
+  expr_graph_free(g);
+}
+
+UTEST(expr_tests, test_expr_parallel) {
+  expr_graph_t* g = expr_graph_new();
+  size_t n = 4 * EXPR_PARALLEL_THRESHOLD + 3;
+  vector_t* a = vector_random_uniform(n, -1.0, 1.0, 11);
+  vector_t* b = vector_random_uniform(n, -1.0, 1.0, 12);
+  vector_t *serial, *parallel;
+  expr_t* e = expr_normalize(
+      g, expr_add(g, expr_vector(g, a), expr_scale(g, expr_vector(g, b), 2.0)));
+  parallel_policy_t policy;
+  size_t i;
+  serial = expr_eval(g, e);
+  parallel_set_threads(4);
+  policy = parallel_set_policy(PARALLEL_ALWAYS);
+  parallel = expr_eval(g, e);
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  for (i = 0; i < n; i++) {
+    ASSERT_TRUE(fabs(VECTOR_IDX_INTO(serial, i) -
+                     VECTOR_IDX_INTO(parallel, i)) < 1e-12);
+  }
+  vector_free(a);
+  vector_free(b);
+  vector_free(serial);
+  vector_free(parallel);
+  expr_graph_free(g);
+}
+
+UTEST(expr_tests, test_expr_shared_nodes) {
+  expr_graph_t* g = expr_graph_new();
+  vector_t* a = vector_random_uniform(1000, 0.5, 1.5, 13);
+  vector_t* res = vector_new(1000);
+  vector_t* target = vector_new(1000);
+  expr_t* x = expr_vector(g, a);
+  expr_t *y, *z;
+  double norm = 0;
+  size_t i;
+  int k;
+  // Each level reads the previous one twice. Emitting a shared node once
+  // keeps this linear in the depth instead of exponential.
+  y = x;
+  for (k = 0; k < 40; k++) {
+    y = expr_scale(g, expr_add(g, y, y), 0.5);
+  }
+  expr_eval_into(g, y, res);
+  ASSERT_TRUE(vector_equal(res, a, 0.0));
+  y = x;
+  for (k = 0; k < 5; k++) {
+    y = expr_mul(g, y, y);
+  }
+  expr_eval_into(g, y, res);
+  for (i = 0; i < 1000; i++) {
+    ASSERT_TRUE(fabs(VECTOR_IDX_INTO(res, i) - pow(VECTOR_IDX_INTO(a, i), 32)) <
+                1e-9 * VECTOR_IDX_INTO(res, i));
+  }
+  // A shared node read both across a barrier and in the fused region.
+  y = expr_sub(g, x, expr_scale(g, x, 0.25));
+  z = expr_add(g, expr_normalize(g, y), y);
+  expr_eval_into(g, z, res);
+  for (i = 0; i < 1000; i++) {
+    norm += 0.75 * VECTOR_IDX_INTO(a, i) * 0.75 * VECTOR_IDX_INTO(a, i);
+  }
+  norm = sqrt(norm);
+  for (i = 0; i < 1000; i++) {
+    VECTOR_IDX_INTO(target, i) =
+        0.75 * VECTOR_IDX_INTO(a, i) / norm + 0.75 * VECTOR_IDX_INTO(a, i);
+  }
+  ASSERT_TRUE(vector_equal(res, target, 1e-12));
+  vector_free(a);
+  vector_free(res);
+  vector_free(target);
+  expr_graph_free(g);
+}
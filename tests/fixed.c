@@ -0,0 +1,74 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+
+#include "linalg_fixed.h"
+#include "linalg_matrix.h"
+#include "utest.h"
+
+UTEST(fixed_tests, test_fixed_determinant) {
+  double a2[] = {3.0, 8.0, 4.0, 6.0};
+  double a3[] = {6.0, 1.0, 1.0, 4.0, -2.0, 5.0, 2.0, 8.0, 7.0};
+  double a8[64] = {0};
+  size_t i;
+  for (i = 0; i < 8; i++) {
+    a8[i * 8 + i] = (double)(i + 1);
+  }
+  a8[7] = 5.0;
+  ASSERT_TRUE(fabs(matrix_determinant_2x2(a2) + 14.0) < 1.0e-12);
+  ASSERT_TRUE(fabs(matrix_determinant_3x3(a3) + 306.0) < 1.0e-12);
+  ASSERT_TRUE(fabs(matrix_determinant_8x8(a8) - 40320.0) < 1.0e-9);
+}
+
+UTEST(fixed_tests, test_fixed_inverse) {
+  double a[25], inv[25], prod[25];
+  size_t i, j;
+  for (i = 0; i < 5; i++) {
+    for (j = 0; j < 5; j++) {
+      a[i * 5 + j] = i == j ? 4.0 : 1.0 / (1.0 + i + j);
+    }
+  }
+  ASSERT_TRUE(matrix_inverse_5x5(inv, a));
+  matrix_mul_5x5(prod, a, inv);
+  for (i = 0; i < 5; i++) {
+    for (j = 0; j < 5; j++) {
+      ASSERT_TRUE(fabs(prod[i * 5 + j] - (i == j ? 1.0 : 0.0)) < 1.0e-12);
+    }
+  }
+}
+
+UTEST(fixed_tests, test_fixed_inverse_singular) {
+  double a[] = {1.0, 2.0, 2.0, 4.0};
+  double inv[4];
+  ASSERT_FALSE(matrix_inverse_2x2(inv, a));
+}
+
+UTEST(fixed_tests, test_fixed_dispatch) {
+  size_t n, i, j, k;
+  matrix_t *m1, *m2, *m;
+  double sum;
+  for (n = 1; n <= MATRIX_FIXED_MAX + 1; n++) {
+    m1 = matrix_new(n, n);
+    m2 = matrix_new(n, n);
+    for (i = 0; i < n * n; i++) {
+      DATA(m1)[i] = (double)i;
+      DATA(m2)[i] = (double)(n * n - i);
+    }
+    m = matrix_mul(m1, m2);
+    for (i = 0; i < n; i++) {
+      for (j = 0; j < n; j++) {
+        sum = 0;
+        for (k = 0; k < n; k++) {
+          sum += MATRIX_IDX_INTO(m1, i, k) * MATRIX_IDX_INTO(m2, k, j);
+        }
+        ASSERT_EQ(MATRIX_IDX_INTO(m, i, j), sum);
+      }
+    }
+    matrix_transpose(m1);
+    ASSERT_EQ(MATRIX_IDX_INTO(m1, n - 1, 0), (double)(n - 1));
+    matrix_free(m1);
+    matrix_free(m2);
+    matrix_free(m);
+  }
+}
@@ -0,0 +1,46 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+// Exercises the static inline definitions instead of the library's.
+#define LINALG_HEADER_ONLY
+
+#include <math.h>
+
+#include "linalg_matrix.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+UTEST(inline_tests, test_inline_vector) {
+  vector_t* v = vector_linspace(5, 1.0, 5.0);
+  vector_t* w = vector_ones(5);
+  vector_t* copy;
+  bool cow = linalg_copy_on_write();
+  ASSERT_EQ(vector_get(v, 3), 4.0);
+  ASSERT_EQ(vector_dot(v, w), 15.0);
+  ASSERT_EQ(vector_norm(w), sqrt(5.0));
+  ASSERT_FALSE(vector_equal(v, w, 0.5));
+  // Setting an element of a shared copy leaves the source intact.
+  linalg_set_copy_on_write(true);
+  copy = vector_copy(v);
+  vector_set(copy, 0, 9.0);
+  linalg_set_copy_on_write(cow);
+  ASSERT_EQ(vector_get(copy, 0), 9.0);
+  ASSERT_EQ(vector_get(v, 0), 1.0);
+  vector_set(copy, 0, 1.0);
+  ASSERT_TRUE(vector_equal(v, copy, 0.0));
+  vector_free(copy);
+  vector_free(v);
+  vector_free(w);
+}
+
+UTEST(inline_tests, test_inline_matrix) {
+  matrix_t* m = matrix_zeros(3, 4);
+  matrix_t* n = matrix_zeros(3, 4);
+  matrix_set(m, 2, 3, 1.5);
+  ASSERT_EQ(matrix_get(m, 2, 3), 1.5);
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 2, 3), 1.5);
+  ASSERT_FALSE(matrix_equal(m, n, 1.0));
+  ASSERT_TRUE(matrix_equal(m, n, 1.5));
+  matrix_free(m);
+  matrix_free(n);
+}
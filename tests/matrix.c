@@ -0,0 +1,757 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "linalg_base.h"
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+UTEST(matrix_tests, test_matrix_from_array) {
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  matrix_t* m = matrix_from_array(arr, 2, 3);
+  ASSERT_EQ(m->nrows, (size_t)2);
+  ASSERT_EQ(m->ncols, (size_t)3);
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 1, 0), 4.0);
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 0, 2), 3.0);
+  matrix_free(m);
+}
+
+UTEST(matrix_tests, test_matrix_identity) {
+  double arr[] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+  matrix_t* m = matrix_identity(3);
+  matrix_t* target = matrix_from_array(arr, 3, 3);
+  ASSERT_TRUE(matrix_equal(m, target, 1.0e-6));
+  matrix_free(m);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_padding) {
+  matrix_t* packed = matrix_new(2, 3);
+  matrix_t* padded = matrix_new(2, MATRIX_PAD_STRIDE);
+  ASSERT_EQ(packed->ld, (size_t)3);
+  ASSERT_EQ(padded->ld, (size_t)(MATRIX_PAD_STRIDE + MATRIX_PAD_LENGTH));
+  matrix_free(packed);
+  matrix_free(padded);
+}
+
+UTEST(matrix_tests, test_matrix_block_view) {
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0};
+  double arr_block[] = {5.0, 6.0, 8.0, 9.0};
+  matrix_t* m = matrix_from_array(arr, 3, 3);
+  matrix_t* target = matrix_from_array(arr_block, 2, 2);
+  matrix_t* block = matrix_block_view(m, 1, 1, 2, 2);
+  ASSERT_EQ(REF_COUNT(m), 1);
+  ASSERT_TRUE(matrix_equal(block, target, 1.0e-6));
+  MATRIX_IDX_INTO(block, 0, 0) = 0.0;
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 1, 1), 0.0);
+  matrix_free(block);
+  ASSERT_EQ(REF_COUNT(m), 0);
+  matrix_free(m);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_row_and_col) {
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  double arr_col[] = {2.0, 5.0};
+  matrix_t* m = matrix_from_array(arr, 2, 3);
+  vector_t* row = matrix_row_view(m, 1);
+  vector_t* col = matrix_col_copy(m, 1);
+  vector_t* target = vector_from_array(arr_col, 2);
+  ASSERT_EQ(VECTOR_IDX_INTO(row, 2), 6.0);
+  ASSERT_TRUE(vector_equal(col, target, 1.0e-6));
+  matrix_copy_vector_into_col(m, target, 0);
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 1, 0), 5.0);
+  vector_free(row);
+  vector_free(col);
+  vector_free(target);
+  matrix_free(m);
+}
+
+UTEST(matrix_tests, test_matrix_transpose) {
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  double arr_target[] = {1.0, 4.0, 2.0, 5.0, 3.0, 6.0};
+  matrix_t* m = matrix_from_array(arr, 2, 3);
+  matrix_t* target = matrix_from_array(arr_target, 3, 2);
+  matrix_transpose(m);
+  ASSERT_TRUE(matrix_equal(m, target, 1.0e-6));
+  matrix_free(m);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_transpose_live_view) {
+  matrix_t* m = matrix_zeros(2, 3);
+  vector_t* row = matrix_row_view(m, 1);
+  int status;
+  pid_t pid;
+  fflush(stdout);
+  pid = fork();
+  ASSERT_TRUE(pid >= 0);
+  if (pid == 0) {
+    // Moving the data would leave the row view dangling.
+    matrix_transpose(m);
+    _exit(EXIT_SUCCESS);
+  }
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), EXIT_FAILURE);
+  VECTOR_IDX_INTO(row, 2) = 1.0;
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 1, 2), 1.0);
+  vector_free(row);
+  matrix_transpose(m);
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 2, 1), 1.0);
+  matrix_free(m);
+}
+
+UTEST(matrix_tests, test_matrix_transpose_large) {
+  size_t n = 70;
+  size_t i, j;
+  matrix_t* m = matrix_new(n, n);
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < n; j++) {
+      MATRIX_IDX_INTO(m, i, j) = i * n + j;
+    }
+  }
+  matrix_transpose(m);
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < n; j++) {
+      ASSERT_EQ(MATRIX_IDX_INTO(m, j, i), (double)(i * n + j));
+    }
+  }
+  matrix_free(m);
+}
+
+UTEST(matrix_tests, test_matrix_mul) {
+  double arr1[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  double arr2[] = {7.0, 8.0, 9.0, 10.0, 11.0, 12.0};
+  double arr_target[] = {58.0, 64.0, 139.0, 154.0};
+  matrix_t* m1 = matrix_from_array(arr1, 2, 3);
+  matrix_t* m2 = matrix_from_array(arr2, 3, 2);
+  matrix_t* target = matrix_from_array(arr_target, 2, 2);
+  matrix_t* m = matrix_mul(m1, m2);
+  ASSERT_TRUE(matrix_equal(m, target, 1.0e-6));
+  matrix_free(m1);
+  matrix_free(m2);
+  matrix_free(m);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_mul_block_views) {
+  double arr[] = {1.0, 2.0, 0.0, 3.0, 4.0, 0.0, 0.0, 0.0, 0.0};
+  double arr_target[] = {7.0, 10.0, 15.0, 22.0};
+  matrix_t* m = matrix_from_array(arr, 3, 3);
+  matrix_t* block = matrix_block_view(m, 0, 0, 2, 2);
+  matrix_t* target = matrix_from_array(arr_target, 2, 2);
+  matrix_t* out = matrix_zeros(3, 3);
+  matrix_t* out_block = matrix_block_view(out, 1, 1, 2, 2);
+  matrix_mul_into(out_block, block, block);
+  ASSERT_TRUE(matrix_equal(out_block, target, 1.0e-6));
+  ASSERT_EQ(MATRIX_IDX_INTO(out, 0, 0), 0.0);
+  matrix_free(out_block);
+  matrix_free(block);
+  matrix_free(out);
+  matrix_free(m);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_vector_mul) {
+  double arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  double arr_v[] = {1.0, 0.0, 1.0};
+  double arr_target[] = {4.0, 10.0};
+  matrix_t* m = matrix_from_array(arr, 2, 3);
+  vector_t* v = vector_from_array(arr_v, 3);
+  vector_t* target = vector_from_array(arr_target, 2);
+  vector_t* res = matrix_vector_mul(m, v);
+  ASSERT_TRUE(vector_equal(res, target, 1.0e-6));
+  matrix_free(m);
+  vector_free(v);
+  vector_free(target);
+  vector_free(res);
+}
+
+UTEST(matrix_tests, test_matrix_copy_on_write) {
+  matrix_t* m = matrix_ones(2, 2);
+  matrix_t* copy;
+  linalg_set_copy_on_write(true);
+  copy = matrix_copy(m);
+  linalg_set_copy_on_write(false);
+  ASSERT_TRUE(DATA(copy) == DATA(m));
+  matrix_materialize(copy);
+  ASSERT_TRUE(DATA(copy) != DATA(m));
+  ASSERT_EQ(REF_COUNT(m), 0);
+  ASSERT_TRUE(matrix_equal(m, copy, 1.0e-6));
+  matrix_free(copy);
+  // Element writes to the source detach it, and it may be freed first.
+  linalg_set_copy_on_write(true);
+  copy = matrix_copy(m);
+  linalg_set_copy_on_write(false);
+  MATRIX_IDX_INTO(m, 0, 1) = 3.0;
+  ASSERT_TRUE(DATA(copy) != DATA(m));
+  ASSERT_EQ(MATRIX_AT(copy, 0, 1), 1.0);
+  matrix_free(m);
+  ASSERT_EQ(MATRIX_AT(copy, 1, 1), 1.0);
+  matrix_free(copy);
+}
+
+UTEST(matrix_tests, test_matrix_is_upper_triangular) {
+  double arr[] = {1.0, 2.0, 0.0, 3.0};
+  matrix_t* m = matrix_from_array(arr, 2, 2);
+  ASSERT_TRUE(matrix_is_upper_triangular(m, 1.0e-6));
+  MATRIX_IDX_INTO(m, 1, 0) = 1.0;
+  ASSERT_FALSE(matrix_is_upper_triangular(m, 1.0e-6));
+  matrix_free(m);
+}
+
+UTEST(matrix_tests, test_matrix_to_string) {
+  double arr[] = {1.0, 2.0, 3.0, 4.0};
+  matrix_t* m = matrix_from_array(arr, 2, 2);
+  char* res = matrix_to_string(m);
+  char* target = "[[1.000000, 2.000000], [3.000000, 4.000000]]";
+  ASSERT_EQ(strcmp(res, target), 0);
+  matrix_free(m);
+  free(res);
+}
+
+static matrix_t* matrix_test_pattern(size_t nrows, size_t ncols) {
+  matrix_t* m = matrix_new(nrows, ncols);
+  size_t i, j;
+  for (i = 0; i < nrows; i++) {
+    for (j = 0; j < ncols; j++) {
+      MATRIX_IDX_INTO(m, i, j) = (double)((i * 7 + j * 3) % 11) - 5.0;
+    }
+  }
+  return m;
+}
+
+UTEST(matrix_tests, test_matrix_mul_strassen) {
+  matrix_t* m1 = matrix_test_pattern(64, 64);
+  matrix_t* m2 = matrix_test_pattern(64, 64);
+  matrix_t* target = matrix_mul(m1, m2);
+  matrix_t* m = matrix_new(64, 64);
+  matrix_mul_strassen_into(m, m1, m2, 4);
+  ASSERT_TRUE(matrix_equal(m, target, 1.0e-9));
+  matrix_free(m1);
+  matrix_free(m2);
+  matrix_free(m);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_mul_strassen_odd) {
+  matrix_t* m1 = matrix_test_pattern(67, 53);
+  matrix_t* m2 = matrix_test_pattern(53, 61);
+  matrix_t* target = matrix_mul(m1, m2);
+  matrix_t* m = matrix_new(67, 61);
+  matrix_mul_strassen_into(m, m1, m2, 8);
+  ASSERT_TRUE(matrix_equal(m, target, 1.0e-9));
+  matrix_free(m1);
+  matrix_free(m2);
+  matrix_free(m);
+  matrix_free(target);
+}
+
+static matrix_t* matrix_naive_mul(matrix_t* m1, matrix_t* m2) {
+  matrix_t* m = matrix_zeros(m1->nrows, m2->ncols);
+  size_t i, j, k;
+  for (i = 0; i < m1->nrows; i++) {
+    for (j = 0; j < m2->ncols; j++) {
+      for (k = 0; k < m1->ncols; k++) {
+        MATRIX_IDX_INTO(m, i, j) +=
+            MATRIX_IDX_INTO(m1, i, k) * MATRIX_IDX_INTO(m2, k, j);
+      }
+    }
+  }
+  return m;
+}
+
+UTEST(matrix_tests, test_matrix_mul_packed) {
+  matrix_t* m1 = matrix_test_pattern(9, 300);
+  matrix_t* m2 = matrix_test_pattern(300, 270);
+  matrix_t* target = matrix_naive_mul(m1, m2);
+  matrix_t* m = matrix_mul(m1, m2);
+  ASSERT_TRUE(matrix_equal(m, target, 1.0e-9));
+  matrix_free(m1);
+  matrix_free(m2);
+  matrix_free(m);
+  matrix_free(target);
+}
+
+static void* matrix_test_packed_thread(void* arg) {
+  matrix_t** m = arg;
+  matrix_mul_into(m[2], m[0], m[1]);
+  return NULL;
+}
+
+UTEST(matrix_tests, test_matrix_mul_packed_thread_exit) {
+  matrix_t* m[3];
+  matrix_t* target;
+  pthread_t thread;
+  int i;
+  m[0] = matrix_test_pattern(9, 300);
+  m[1] = matrix_test_pattern(300, 270);
+  m[2] = matrix_new(9, 270);
+  target = matrix_naive_mul(m[0], m[1]);
+  // Each thread packs panels into its own buffer, freed when it exits.
+  for (i = 0; i < 3; i++) {
+    ASSERT_EQ(pthread_create(&thread, NULL, matrix_test_packed_thread, m), 0);
+    pthread_join(thread, NULL);
+    ASSERT_TRUE(matrix_equal(m[2], target, 1.0e-9));
+  }
+  matrix_free(m[0]);
+  matrix_free(m[1]);
+  matrix_free(m[2]);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_mul_batch) {
+  matrix_t* m1[6];
+  matrix_t* m2[6];
+  matrix_t* dst[6];
+  matrix_t* target;
+  size_t i;
+  for (i = 0; i < 6; i++) {
+    m1[i] = matrix_test_pattern(3 + i, 4 + i);
+    m2[i] = matrix_test_pattern(4 + i, 2 + 2 * i);
+    dst[i] = matrix_new(3 + i, 2 + 2 * i);
+  }
+  parallel_set_threads(3);
+  matrix_mul_batch_into(dst, m1, m2, 6);
+  parallel_set_threads(0);
+  for (i = 0; i < 6; i++) {
+    target = matrix_naive_mul(m1[i], m2[i]);
+    ASSERT_TRUE(matrix_equal(dst[i], target, 1.0e-9));
+    matrix_free(target);
+    matrix_free(m1[i]);
+    matrix_free(m2[i]);
+    matrix_free(dst[i]);
+  }
+}
+
+UTEST(matrix_tests, test_matrix_cholesky_tiled) {
+  size_t n = 37;
+  matrix_t* a = matrix_test_pattern(n, n);
+  matrix_t* spd = matrix_new(n, n);
+  matrix_t* l;
+  matrix_t* lt;
+  matrix_t* llt;
+  size_t i, j, k;
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < n; j++) {
+      MATRIX_IDX_INTO(spd, i, j) = i == j ? (double)n : 0.0;
+      for (k = 0; k < n; k++) {
+        MATRIX_IDX_INTO(spd, i, j) +=
+            MATRIX_IDX_INTO(a, i, k) * MATRIX_IDX_INTO(a, j, k) / n;
+      }
+    }
+  }
+  l = matrix_copy(spd);
+  parallel_set_threads(4);
+  ASSERT_TRUE(matrix_cholesky_tiled(l, 8));
+  parallel_set_threads(0);
+  ASSERT_FALSE(matrix_is_upper_triangular(l, 0.0));
+  lt = matrix_copy(l);
+  matrix_transpose(lt);
+  ASSERT_TRUE(matrix_is_upper_triangular(lt, 0.0));
+  llt = matrix_mul(l, lt);
+  ASSERT_TRUE(matrix_equal(llt, spd, 1.0e-9));
+  matrix_free(a);
+  matrix_free(spd);
+  matrix_free(l);
+  matrix_free(lt);
+  matrix_free(llt);
+}
+
+UTEST(matrix_tests, test_matrix_cholesky_not_spd) {
+  double arr[] = {1.0, 2.0, 2.0, 1.0};
+  matrix_t* m = matrix_from_array(arr, 2, 2);
+  ASSERT_FALSE(matrix_cholesky(m));
+  matrix_free(m);
+}
+
+UTEST(matrix_tests, test_matrix_ger) {
+  double x_arr[] = {1.0, 2.0};
+  double y_arr[] = {3.0, -1.0, 0.5};
+  double target_arr[] = {7.0, -1.0, 2.0, 13.0, -3.0, 3.0};
+  vector_t* x = vector_from_array(x_arr, 2);
+  vector_t* y = vector_from_array(y_arr, 3);
+  matrix_t* m = matrix_ones(2, 3);
+  matrix_t* target = matrix_from_array(target_arr, 2, 3);
+  matrix_ger(m, 2.0, x, y);
+  ASSERT_TRUE(matrix_equal(m, target, 0.0));
+  vector_free(x);
+  vector_free(y);
+  matrix_free(m);
+  matrix_free(target);
+}
+
+UTEST(matrix_tests, test_matrix_syrk) {
+  size_t n = 150, k = 37;
+  matrix_t* a = matrix_test_pattern(k, n);
+  matrix_t* at = matrix_test_pattern(k, n);
+  matrix_t* target;
+  matrix_t* c = matrix_ones(n, n);
+  parallel_policy_t policy;
+  size_t i, j;
+  matrix_transpose(at);
+  target = matrix_mul(at, a);
+  // c = 2 * a^T a - c, computed on the lower triangle and mirrored.
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < n; j++) {
+      MATRIX_IDX_INTO(target, i, j) = 2 * MATRIX_IDX_INTO(target, i, j) - 1;
+    }
+  }
+  parallel_set_threads(3);
+  policy = parallel_set_policy(PARALLEL_ALWAYS);
+  matrix_syrk(c, MATRIX_LOWER, MATRIX_TRANS, 2.0, a, -1.0, true);
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  ASSERT_TRUE(matrix_equal(c, target, 1e-9));
+  // Without mirroring the upper triangle is left untouched.
+  matrix_free(c);
+  c = matrix_zeros(n, n);
+  matrix_syrk(c, MATRIX_UPPER, MATRIX_TRANS, 2.0, a, 0.0, false);
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < n; j++) {
+      ASSERT_TRUE(fabs(MATRIX_IDX_INTO(c, i, j) -
+                       (j >= i ? MATRIX_IDX_INTO(target, i, j) + 1 : 0.0)) <
+                  1e-9);
+    }
+  }
+  // a a^T from the untransposed operand.
+  matrix_free(target);
+  matrix_free(c);
+  target = matrix_mul(at, a);
+  c = matrix_new(n, n);
+  matrix_syrk(c, MATRIX_LOWER, MATRIX_NO_TRANS, 1.0, at, 0.0, true);
+  ASSERT_TRUE(matrix_equal(c, target, 1e-9));
+  matrix_free(a);
+  matrix_free(at);
+  matrix_free(target);
+  matrix_free(c);
+}
+
+UTEST(matrix_tests, test_matrix_syr2k) {
+  size_t n = 70, k = 9;
+  matrix_t* a = matrix_test_pattern(n, k);
+  matrix_t* b = matrix_ones(n, k);
+  matrix_t* c = matrix_new(n, n);
+  matrix_t* bt = matrix_ones(n, k);
+  matrix_t* at = matrix_test_pattern(n, k);
+  matrix_t* ab;
+  matrix_t* ba;
+  matrix_t *ca, *cb, *cc;
+  size_t i, j;
+  matrix_transpose(bt);
+  matrix_transpose(at);
+  ab = matrix_mul(a, bt);
+  ba = matrix_mul(b, at);
+  matrix_syr2k(c, MATRIX_UPPER, MATRIX_NO_TRANS, 0.5, a, b, 0.0, true);
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < n; j++) {
+      ASSERT_TRUE(fabs(MATRIX_IDX_INTO(c, i, j) -
+                       0.5 * (MATRIX_IDX_INTO(ab, i, j) +
+                              MATRIX_IDX_INTO(ba, i, j))) < 1e-12);
+    }
+  }
+  // Column-major storage, alone or mixed with row-major operands.
+  ca = matrix_copy_order(a, MATRIX_COL_MAJOR);
+  cb = matrix_copy_order(b, MATRIX_COL_MAJOR);
+  cc = matrix_new_col_major(n, n);
+  matrix_syr2k(cc, MATRIX_UPPER, MATRIX_NO_TRANS, 0.5, ca, cb, 0.0, true);
+  ASSERT_TRUE(matrix_equal(cc, c, 1e-12));
+  matrix_syr2k(cc, MATRIX_LOWER, MATRIX_NO_TRANS, 0.5, a, cb, 1.0, true);
+  matrix_syr2k(c, MATRIX_LOWER, MATRIX_NO_TRANS, 0.5, ca, b, 1.0, true);
+  ASSERT_TRUE(matrix_equal(cc, c, 1e-12));
+  ASSERT_TRUE(fabs(MATRIX_IDX_INTO(c, 3, 68) - MATRIX_IDX_INTO(ab, 3, 68) -
+                   MATRIX_IDX_INTO(ba, 3, 68)) < 1e-12);
+  matrix_free(a);
+  matrix_free(b);
+  matrix_free(c);
+  matrix_free(at);
+  matrix_free(bt);
+  matrix_free(ab);
+  matrix_free(ba);
+  matrix_free(ca);
+  matrix_free(cb);
+  matrix_free(cc);
+}
+
+/** Returns op(a) with the unreferenced triangle zeroed and, for unit
+ *  triangles, ones on the diagonal. */
+static matrix_t* matrix_test_triangle(matrix_t* a, matrix_uplo_t uplo,
+                                      matrix_trans_t trans,
+                                      matrix_diag_t diag) {
+  matrix_t* t = matrix_copy(a);
+  size_t i, j;
+  for (i = 0; i < t->nrows; i++) {
+    for (j = 0; j < t->ncols; j++) {
+      if (uplo == MATRIX_LOWER ? j > i : j < i) {
+        MATRIX_IDX_INTO(t, i, j) = 0;
+      } else if (i == j && diag == MATRIX_UNIT) {
+        MATRIX_IDX_INTO(t, i, j) = 1;
+      }
+    }
+  }
+  if (trans == MATRIX_TRANS) {
+    matrix_transpose(t);
+  }
+  return t;
+}
+
+UTEST(matrix_tests, test_matrix_trsm) {
+  size_t n = 150, nrhs = 21;
+  matrix_t* a = matrix_test_pattern(n, n);
+  matrix_t *b, *x, *t, *ax;
+  parallel_policy_t policy;
+  int side, uplo, trans, diag;
+  size_t i;
+  // Small off-diagonal entries keep the unit triangles well conditioned.
+  for (i = 0; i < n * n; i++) {
+    DATA(a)[i] /= (double)n;
+  }
+  for (i = 0; i < n; i++) {
+    MATRIX_IDX_INTO(a, i, i) = 2.0 + (double)(i % 5);
+  }
+  parallel_set_threads(3);
+  policy = parallel_set_policy(PARALLEL_ALWAYS);
+  for (side = MATRIX_LEFT; side <= MATRIX_RIGHT; side++) {
+    b = side == MATRIX_LEFT ? matrix_test_pattern(n, nrhs)
+                            : matrix_test_pattern(nrhs, n);
+    for (uplo = MATRIX_LOWER; uplo <= MATRIX_UPPER; uplo++) {
+      for (trans = MATRIX_NO_TRANS; trans <= MATRIX_TRANS; trans++) {
+        for (diag = MATRIX_NON_UNIT; diag <= MATRIX_UNIT; diag++) {
+          x = matrix_copy(b);
+          matrix_trsm(x, side, uplo, trans, diag, 2.0, a);
+          t = matrix_test_triangle(a, uplo, trans, diag);
+          ax = side == MATRIX_LEFT ? matrix_mul(t, x) : matrix_mul(x, t);
+          for (i = 0; i < ax->nrows * ax->ld; i++) {
+            DATA(ax)[i] /= 2.0;
+          }
+          ASSERT_TRUE(matrix_equal(ax, b, 1e-9));
+          matrix_free(x);
+          matrix_free(t);
+          matrix_free(ax);
+        }
+      }
+    }
+    matrix_free(b);
+  }
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  matrix_free(a);
+}
+
+UTEST(matrix_tests, test_matrix_trsv) {
+  size_t n = 100;
+  matrix_t* a = matrix_test_pattern(n, n);
+  vector_t* b = vector_linspace(n, -1.0, 1.0);
+  vector_t *x, *ax;
+  matrix_t* t;
+  int uplo, trans;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    MATRIX_IDX_INTO(a, i, i) = 30.0;
+  }
+  for (uplo = MATRIX_LOWER; uplo <= MATRIX_UPPER; uplo++) {
+    for (trans = MATRIX_NO_TRANS; trans <= MATRIX_TRANS; trans++) {
+      x = vector_copy(b);
+      matrix_trsv(a, uplo, trans, MATRIX_NON_UNIT, x);
+      t = matrix_test_triangle(a, uplo, trans, MATRIX_NON_UNIT);
+      ax = matrix_vector_mul(t, x);
+      ASSERT_TRUE(vector_equal(ax, b, 1e-12));
+      vector_free(x);
+      vector_free(ax);
+      matrix_free(t);
+    }
+  }
+  matrix_free(a);
+  vector_free(b);
+}
+
+UTEST(matrix_tests, test_matrix_col_major) {
+  double arr[] = {1.0, 4.0, 2.0, 5.0, 3.0, 6.0};
+  double row_arr[] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  matrix_t* m = matrix_from_col_major_array(arr, 2, 3);
+  matrix_t* row = matrix_from_array(row_arr, 2, 3);
+  matrix_t* c;
+  vector_t* col;
+  ASSERT_EQ(m->order, MATRIX_COL_MAJOR);
+  ASSERT_EQ(matrix_get(m, 1, 0), 4.0);
+  ASSERT_EQ(matrix_get(m, 0, 2), 3.0);
+  ASSERT_TRUE(matrix_equal(m, row, 0.0));
+  // The index macros take any expression for the matrix and indices.
+  ASSERT_EQ(MATRIX_AT(*(&row + 0), 0 + 1, 1 + 1), 6.0);
+  ASSERT_EQ(MATRIX_AT(*(&m + 0), 0 + 1, 1 + 1), 6.0);
+  ASSERT_EQ(DATA(row)[MATRIX_IDX_ROW(*(&row + 0), 0 + 1, 0)], 4.0);
+  ASSERT_EQ(MATRIX_ROW_STRIDE(m), (size_t)1);
+  ASSERT_EQ(MATRIX_COL_STRIDE(row), (size_t)1);
+  // Columns of a column-major matrix are views into its storage.
+  col = matrix_col_view(m, 1);
+  ASSERT_TRUE(DATA(col) >= DATA(m) && DATA(col) < DATA(m) + 3 * m->ld);
+  ASSERT_EQ(VECTOR_IDX_INTO(col, 1), 5.0);
+  VECTOR_IDX_INTO(col, 0) = -2.0;
+  ASSERT_EQ(matrix_get(m, 0, 1), -2.0);
+  vector_free(col);
+  matrix_set(m, 0, 1, 2.0);
+  // Copies between orders keep the logical contents.
+  c = matrix_copy_order(row, MATRIX_COL_MAJOR);
+  ASSERT_EQ(c->order, MATRIX_COL_MAJOR);
+  ASSERT_TRUE(matrix_equal(c, m, 0.0));
+  matrix_free(c);
+  c = matrix_new_col_major(2, 3);
+  matrix_copy_into(c, row);
+  ASSERT_TRUE(matrix_equal(c, row, 0.0));
+  matrix_free(c);
+  c = matrix_copy(m);
+  ASSERT_EQ(c->order, MATRIX_COL_MAJOR);
+  ASSERT_TRUE(matrix_equal(c, row, 0.0));
+  matrix_free(c);
+  matrix_free(m);
+  matrix_free(row);
+}
+
+UTEST(matrix_tests, test_matrix_col_major_transpose) {
+  size_t shapes[][2] = {{5, 5}, {37, 70}, {70, 37}};
+  matrix_t *row, *col;
+  size_t s;
+  for (s = 0; s < 3; s++) {
+    row = matrix_test_pattern(shapes[s][0], shapes[s][1]);
+    col = matrix_copy_order(row, MATRIX_COL_MAJOR);
+    matrix_transpose(row);
+    matrix_transpose(col);
+    ASSERT_EQ(col->order, MATRIX_COL_MAJOR);
+    ASSERT_TRUE(matrix_equal(col, row, 0.0));
+    matrix_free(row);
+    matrix_free(col);
+  }
+}
+
+UTEST(matrix_tests, test_matrix_col_major_mul) {
+  size_t shapes[][3] = {{7, 5, 6}, {9, 300, 270}, {4, 4, 4}};
+  matrix_t *m1, *m2, *target, *a, *b, *dst;
+  size_t s;
+  int layout;
+  for (s = 0; s < 3; s++) {
+    m1 = matrix_test_pattern(shapes[s][0], shapes[s][1]);
+    m2 = matrix_test_pattern(shapes[s][1], shapes[s][2]);
+    target = matrix_naive_mul(m1, m2);
+    // Every combination of orders of dst, m1 and m2.
+    for (layout = 0; layout < 8; layout++) {
+      a = matrix_copy_order(m1, layout & 1 ? MATRIX_COL_MAJOR
+                                            : MATRIX_ROW_MAJOR);
+      b = matrix_copy_order(m2, layout & 2 ? MATRIX_COL_MAJOR
+                                            : MATRIX_ROW_MAJOR);
+      dst = layout & 4 ? matrix_new_col_major(a->nrows, b->ncols)
+                       : matrix_new(a->nrows, b->ncols);
+      matrix_mul_into(dst, a, b);
+      ASSERT_TRUE(matrix_equal(dst, target, 1e-9));
+      matrix_free(dst);
+      dst = matrix_mul_strassen_into(
+          layout & 4 ? matrix_new_col_major(a->nrows, b->ncols)
+                     : matrix_new(a->nrows, b->ncols),
+          a, b, 2);
+      ASSERT_TRUE(matrix_equal(dst, target, 1e-9));
+      matrix_free(dst);
+      matrix_free(a);
+      matrix_free(b);
+    }
+    matrix_free(m1);
+    matrix_free(m2);
+    matrix_free(target);
+  }
+}
+
+UTEST(matrix_tests, test_matrix_col_major_vector_mul) {
+  matrix_t* row = matrix_test_pattern(33, 19);
+  matrix_t* col = matrix_copy_order(row, MATRIX_COL_MAJOR);
+  vector_t* v = vector_linspace(19, -1.0, 1.0);
+  vector_t* target = matrix_vector_mul(row, v);
+  vector_t* res = matrix_vector_mul(col, v);
+  ASSERT_TRUE(vector_equal(res, target, 1e-12));
+  matrix_free(row);
+  matrix_free(col);
+  vector_free(v);
+  vector_free(target);
+  vector_free(res);
+}
+
+UTEST(matrix_tests, test_matrix_col_major_solvers) {
+  size_t n = 40, i, j, k;
+  matrix_t* a = matrix_test_pattern(n, n);
+  matrix_t* b = matrix_test_pattern(n, 9);
+  matrix_t* spd = matrix_new(n, n);
+  vector_t* x = vector_linspace(n, -1.0, 1.0);
+  vector_t* y = vector_linspace(n, 0.0, 2.0);
+  matrix_t *ca, *cb, *target, *c;
+  for (i = 0; i < n; i++) {
+    MATRIX_IDX_INTO(a, i, i) = 30.0;
+    for (j = 0; j < n; j++) {
+      MATRIX_IDX_INTO(spd, i, j) = i == j ? (double)n : 0.0;
+      for (k = 0; k < n; k++) {
+        MATRIX_IDX_INTO(spd, i, j) +=
+            MATRIX_IDX_INTO(a, i, k) * MATRIX_IDX_INTO(a, j, k) / (30.0 * n);
+      }
+    }
+  }
+  ca = matrix_copy_order(a, MATRIX_COL_MAJOR);
+  // Rank-one update.
+  target = matrix_copy(a);
+  matrix_ger(target, 0.5, x, y);
+  matrix_ger(ca, 0.5, x, y);
+  ASSERT_TRUE(matrix_equal(ca, target, 1e-12));
+  matrix_free(target);
+  matrix_copy_into(ca, a);
+  // Triangular solves with either operand column-major.
+  target = matrix_copy(b);
+  matrix_trsm(target, MATRIX_LEFT, MATRIX_LOWER, MATRIX_TRANS, MATRIX_NON_UNIT,
+              1.0, a);
+  cb = matrix_copy_order(b, MATRIX_COL_MAJOR);
+  matrix_trsm(cb, MATRIX_LEFT, MATRIX_LOWER, MATRIX_TRANS, MATRIX_NON_UNIT,
+              1.0, ca);
+  ASSERT_TRUE(matrix_equal(cb, target, 1e-12));
+  matrix_free(cb);
+  cb = matrix_copy(b);
+  matrix_trsm(cb, MATRIX_LEFT, MATRIX_LOWER, MATRIX_TRANS, MATRIX_NON_UNIT,
+              1.0, ca);
+  ASSERT_TRUE(matrix_equal(cb, target, 1e-12));
+  matrix_free(cb);
+  matrix_free(target);
+  matrix_transpose(b);
+  target = matrix_copy(b);
+  matrix_trsm(target, MATRIX_RIGHT, MATRIX_UPPER, MATRIX_NO_TRANS, MATRIX_UNIT,
+              2.0, a);
+  cb = matrix_copy_order(b, MATRIX_COL_MAJOR);
+  matrix_trsm(cb, MATRIX_RIGHT, MATRIX_UPPER, MATRIX_NO_TRANS, MATRIX_UNIT,
+              2.0, ca);
+  ASSERT_TRUE(matrix_equal(cb, target, 1e-12));
+  matrix_free(cb);
+  matrix_free(target);
+  // Symmetric rank-k update.
+  target = matrix_new(n, n);
+  matrix_syrk(target, MATRIX_LOWER, MATRIX_TRANS, 1.0, a, 0.0, true);
+  c = matrix_new_col_major(n, n);
+  matrix_syrk(c, MATRIX_LOWER, MATRIX_TRANS, 1.0, ca, 0.0, true);
+  ASSERT_TRUE(matrix_equal(c, target, 1e-9));
+  matrix_free(c);
+  matrix_free(target);
+  // Cholesky factorization.
+  target = matrix_copy(spd);
+  ASSERT_TRUE(matrix_cholesky_tiled(target, 8));
+  c = matrix_copy_order(spd, MATRIX_COL_MAJOR);
+  ASSERT_TRUE(matrix_cholesky_tiled(c, 8));
+  ASSERT_EQ(c->order, MATRIX_COL_MAJOR);
+  ASSERT_TRUE(matrix_equal(c, target, 1e-12));
+  matrix_free(c);
+  matrix_free(target);
+  matrix_free(a);
+  matrix_free(b);
+  matrix_free(ca);
+  matrix_free(spd);
+  vector_free(x);
+  vector_free(y);
+}
@@ -0,0 +1,104 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "linalg_matrix.h"
+#include "linalg_memory.h"
+#include "linalg_tile.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+UTEST(memory_tests, test_memory_live_and_peak) {
+  memory_stats_t before, during, after;
+  vector_t* v;
+  memory_stats_reset();
+  memory_stats(&before);
+  v = vector_zeros(100);
+  memory_stats(&during);
+  ASSERT_EQ(during.live_objects, before.live_objects + 1);
+  ASSERT_EQ(during.live_bytes,
+            before.live_bytes + sizeof(vector_t) + 100 * sizeof(double));
+  ASSERT_EQ(during.allocations, (size_t)1);
+  vector_free(v);
+  memory_stats(&after);
+  ASSERT_EQ(after.live_objects, before.live_objects);
+  ASSERT_EQ(after.live_bytes, before.live_bytes);
+  ASSERT_EQ(after.peak_bytes, during.live_bytes);
+}
+
+UTEST(memory_tests, test_memory_views_count_header_only) {
+  memory_stats_t before, during;
+  vector_t* v = vector_zeros(10);
+  vector_t* s;
+  memory_stats(&before);
+  s = vector_slice(v, 2, 5);
+  memory_stats(&during);
+  ASSERT_EQ(during.live_bytes, before.live_bytes + sizeof(vector_t));
+  vector_free(s);
+  vector_free(v);
+}
+
+UTEST(memory_tests, test_memory_thread_stats) {
+  memory_thread_stats_t before, after;
+  vector_t* v;
+  memory_thread_stats(&before);
+  v = vector_ones(4);
+  vector_free(v);
+  memory_thread_stats(&after);
+  ASSERT_EQ(after.allocations, before.allocations + 1);
+  ASSERT_EQ(after.frees, before.frees + 1);
+  ASSERT_EQ(after.bytes_allocated - before.bytes_allocated,
+            after.bytes_freed - before.bytes_freed);
+}
+
+UTEST(memory_tests, test_memory_leak_report) {
+  FILE* f = tmpfile();
+  char line[256];
+  vector_t* v;
+  memory_enable_leak_report();
+  ASSERT_EQ(memory_report_leaks(f), (size_t)0);
+  v = LINALG_TRACKED(vector_zeros(2));
+  ASSERT_EQ(memory_report_leaks(f), (size_t)1);
+  rewind(f);
+  ASSERT_TRUE(fgets(line, sizeof(line), f) != NULL);
+  ASSERT_TRUE(fgets(line, sizeof(line), f) != NULL);
+  ASSERT_TRUE(strstr(line, "vector of") != NULL);
+  ASSERT_TRUE(strstr(line, "tests/memory.c") != NULL);
+  fclose(f);
+  vector_free(v);
+  ASSERT_EQ(memory_report_leaks(stderr), (size_t)0);
+}
+
+UTEST(memory_tests, test_memory_huge_pages) {
+  size_t threshold = memory_set_huge_page_threshold(MEMORY_MMAP_THRESHOLD);
+  memory_stats_t before, during, after;
+  matrix_t* m;
+  vector_t* small;
+  tile_matrix_t* t;
+  memory_stats(&before);
+  m = matrix_constant(600, 700, 1.0);
+  small = vector_ones(10);
+  memory_stats(&during);
+  ASSERT_EQ((uintptr_t)DATA(m) % MEMORY_HUGE_PAGE_SIZE, (uintptr_t)0);
+  ASSERT_GE(during.huge_page_bytes - before.huge_page_bytes,
+            sizeof(double) * 600 * m->ld);
+  ASSERT_EQ(during.huge_page_bytes % MEMORY_HUGE_PAGE_SIZE, (size_t)0);
+  ASSERT_LE(during.huge_page_resident, during.huge_page_bytes);
+  // Moving to a new buffer frees the old one through the same path.
+  matrix_transpose(m);
+  ASSERT_EQ(MATRIX_IDX_INTO(m, 699, 599), 1.0);
+  matrix_free(m);
+  vector_free(small);
+  // Tile matrices take the same path and still start zeroed.
+  t = tile_matrix_zeros(600, 700, 64);
+  memory_stats(&during);
+  ASSERT_GT(during.huge_page_bytes, before.huge_page_bytes);
+  ASSERT_EQ(TILE_MATRIX_IDX_INTO(t, 599, 699), 0.0);
+  tile_matrix_free(t);
+  memory_stats(&after);
+  ASSERT_EQ(after.huge_page_bytes, before.huge_page_bytes);
+  ASSERT_EQ(memory_set_huge_page_threshold(threshold),
+            (size_t)MEMORY_MMAP_THRESHOLD);
+}
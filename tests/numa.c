@@ -0,0 +1,102 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <stdatomic.h>
+
+#include "linalg_matrix.h"
+#include "linalg_memory.h"
+#include "linalg_numa.h"
+#include "linalg_parallel.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+UTEST(numa_tests, test_numa_policy_is_per_thread_setting) {
+  numa_policy_t policy = numa_set_policy(NUMA_INTERLEAVE);
+  int node = numa_set_node(0);
+  ASSERT_EQ(numa_policy(), NUMA_INTERLEAVE);
+  ASSERT_EQ(numa_set_policy(policy), NUMA_INTERLEAVE);
+  ASSERT_EQ(numa_policy(), policy);
+  ASSERT_EQ(numa_set_node(node), 0);
+  ASSERT_GE(numa_node_count(), (size_t)1);
+}
+
+UTEST(numa_tests, test_numa_policies_place_large_buffers) {
+  numa_policy_t policies[] = {NUMA_DEFAULT, NUMA_INTERLEAVE,
+                              NUMA_FIRST_TOUCH, NUMA_BIND};
+  size_t n = 2 * MEMORY_MMAP_THRESHOLD / sizeof(double) + 5;
+  numa_policy_t policy;
+  parallel_policy_t parallel;
+  vector_t* v;
+  matrix_t* m;
+  size_t p;
+  parallel_set_threads(4);
+  parallel = parallel_set_policy(PARALLEL_ALWAYS);
+  for (p = 0; p < 4; p++) {
+    policy = numa_set_policy(policies[p]);
+    v = vector_constant(n, 2.0);
+    ASSERT_EQ(VECTOR_IDX_INTO(v, 0), 2.0);
+    ASSERT_EQ(VECTOR_IDX_INTO(v, n - 1), 2.0);
+    vector_free(v);
+    // A non-square transpose moves the data to a new buffer.
+    m = matrix_constant(700, 600, 3.0);
+    MATRIX_IDX_INTO(m, 699, 0) = 1.0;
+    matrix_transpose(m);
+    ASSERT_EQ(MATRIX_IDX_INTO(m, 0, 699), 1.0);
+    ASSERT_EQ(MATRIX_IDX_INTO(m, 599, 0), 3.0);
+    matrix_free(m);
+    numa_set_policy(policy);
+  }
+  parallel_set_policy(parallel);
+  parallel_set_threads(0);
+}
+
+static void alloc_range(void* ctx, size_t begin, size_t end) {
+  atomic_int* zeroed = ctx;
+  size_t rows = 600, ld = 513, i;
+  numa_policy_t policy = numa_set_policy(NUMA_FIRST_TOUCH);
+  double* data;
+  for (i = begin; i < end; i++) {
+    // Falls back to interleaving, since the pool is busy with this loop.
+    data = memory_alloc_data(rows, ld);
+    if (data != NULL && data[0] == 0.0 && data[rows * ld - 1] == 0.0) {
+      atomic_fetch_add(zeroed, 1);
+    }
+    memory_free_data(data, rows * ld);
+  }
+  numa_set_policy(policy);
+}
+
+UTEST(numa_tests, test_numa_first_touch_nested) {
+  atomic_int zeroed = 0;
+  parallel_set_threads(3);
+  parallel_for(6, alloc_range, &zeroed);
+  ASSERT_EQ(atomic_load(&zeroed), 6);
+  parallel_set_threads(0);
+}
+
+UTEST(numa_tests, test_numa_first_touch_zeroes) {
+  size_t rows = 1000, ld = 513, i;
+  numa_policy_t policy = numa_set_policy(NUMA_FIRST_TOUCH);
+  double* data;
+  parallel_set_threads(3);
+  data = memory_alloc_data(rows, ld);
+  ASSERT_TRUE(data != NULL);
+  for (i = 0; i < rows * ld; i += 4099) {
+    ASSERT_EQ(data[i], 0.0);
+  }
+  ASSERT_EQ(data[rows * ld - 1], 0.0);
+  // Buffers are freed by how they were allocated, not by the policy in
+  // force when they are freed.
+  numa_set_policy(NUMA_DEFAULT);
+  memory_free_data(data, rows * ld);
+  data = memory_alloc_data(rows, ld);
+  numa_set_policy(NUMA_INTERLEAVE);
+  memory_free_data(data, rows * ld);
+  numa_set_policy(NUMA_FIRST_TOUCH);
+  // Small buffers come from malloc whatever the policy.
+  data = memory_alloc_data(10, 10);
+  ASSERT_TRUE(data != NULL);
+  memory_free_data(data, 100);
+  parallel_set_threads(0);
+  numa_set_policy(policy);
+}
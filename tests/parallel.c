@@ -0,0 +1,84 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <stdatomic.h>
+
+#include "linalg_parallel.h"
+#include "utest.h"
+
+static void mark_range(void* ctx, size_t begin, size_t end) {
+  int* marks = ctx;
+  size_t i;
+  for (i = begin; i < end; i++) {
+    marks[i] += 1;
+  }
+}
+
+UTEST(parallel_tests, test_parallel_chunk) {
+  size_t begin, end;
+  parallel_chunk(10, 3, 0, &begin, &end);
+  ASSERT_EQ(begin, (size_t)0);
+  ASSERT_EQ(end, (size_t)4);
+  parallel_chunk(10, 3, 2, &begin, &end);
+  ASSERT_EQ(begin, (size_t)7);
+  ASSERT_EQ(end, (size_t)10);
+}
+
+UTEST(parallel_tests, test_parallel_for) {
+  int marks[1000] = {0};
+  size_t i;
+  parallel_set_threads(4);
+  ASSERT_EQ(parallel_threads(), (size_t)4);
+  parallel_for(1000, mark_range, marks);
+  parallel_for_dynamic(1000, 7, mark_range, marks);
+  parallel_set_threads(1);
+  parallel_for(1000, mark_range, marks);
+  for (i = 0; i < 1000; i++) {
+    ASSERT_EQ(marks[i], 3);
+  }
+  parallel_set_threads(0);
+}
+
+static void nested_range(void* ctx, size_t begin, size_t end) {
+  atomic_int* count = ctx;
+  int marks[10] = {0};
+  size_t i;
+  for (i = begin; i < end; i++) {
+    parallel_for(10, mark_range, marks);
+    atomic_fetch_add(count, marks[9]);
+    marks[9] = 0;
+  }
+}
+
+UTEST(parallel_tests, test_parallel_for_nested) {
+  atomic_int count = 0;
+  parallel_set_threads(3);
+  parallel_for(50, nested_range, &count);
+  ASSERT_EQ(atomic_load(&count), 50);
+  parallel_set_threads(0);
+}
+
+static void try_nested_range(void* ctx, size_t begin, size_t end) {
+  atomic_int* refused = ctx;
+  int marks[10] = {0};
+  size_t i;
+  for (i = begin; i < end; i++) {
+    if (!parallel_try_for(10, mark_range, marks) && marks[9] == 0) {
+      atomic_fetch_add(refused, 1);
+    }
+  }
+}
+
+UTEST(parallel_tests, test_parallel_try_for) {
+  int marks[100] = {0};
+  atomic_int refused = 0;
+  parallel_set_threads(3);
+  ASSERT_TRUE(parallel_try_for(100, mark_range, marks));
+  ASSERT_EQ(marks[99], 1);
+  parallel_for(20, try_nested_range, &refused);
+  ASSERT_EQ(atomic_load(&refused), 20);
+  parallel_set_threads(1);
+  ASSERT_FALSE(parallel_try_for(100, mark_range, marks));
+  ASSERT_EQ(marks[99], 1);
+  parallel_set_threads(0);
+}
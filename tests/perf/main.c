@@ -0,0 +1,6 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include "utest.h"
+
+UTEST_MAIN();
@@ -0,0 +1,95 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include "linalg_matrix.h"
+#include "linalg_random.h"
+#include "perf.h"
+#include "utest.h"
+
+typedef struct {
+  matrix_t* dst;
+  matrix_t* m1;
+  matrix_t* m2;
+  vector_t* v;
+} perf_matrix_t;
+
+static void perf_matrix_mul_into(void* ctx) {
+  perf_matrix_t* op = ctx;
+  matrix_mul_into(op->dst, op->m1, op->m2);
+}
+
+static void perf_matrix_transpose(void* ctx) {
+  perf_matrix_t* op = ctx;
+  matrix_transpose(op->m1);
+}
+
+static void perf_matrix_vector_mul(void* ctx) {
+  perf_matrix_t* op = ctx;
+  vector_free(matrix_vector_mul(op->m1, op->v));
+}
+
+static void perf_matrix_syrk(void* ctx) {
+  perf_matrix_t* op = ctx;
+  matrix_syrk(op->dst, MATRIX_LOWER, MATRIX_TRANS, 1.0, op->m1, 0.0, false);
+}
+
+UTEST(perf_tests, matrix_mul_into) {
+  size_t n = 256;
+  perf_matrix_t op;
+  perf_result_t result;
+  op.dst = matrix_new(n, n);
+  op.m1 = matrix_random_uniform(n, n, -1.0, 1.0, 1);
+  op.m2 = matrix_random_uniform(n, n, -1.0, 1.0, 2);
+  result = perf_measure(perf_matrix_mul_into, &op, 2.0e-9 * n * n * n);
+  ASSERT_TRUE(perf_check("matrix_mul_into", "GFLOP/s", result, 0));
+  matrix_free(op.dst);
+  matrix_free(op.m1);
+  matrix_free(op.m2);
+}
+
+UTEST(perf_tests, matrix_transpose_square) {
+  size_t n = 1024;
+  perf_matrix_t op;
+  perf_result_t result;
+  op.m1 = matrix_random_uniform(n, n, -1.0, 1.0, 3);
+  result = perf_measure(perf_matrix_transpose, &op,
+                        2.0e-9 * sizeof(double) * n * n);
+  ASSERT_TRUE(perf_check("matrix_transpose_square", "GB/s", result, 0));
+  matrix_free(op.m1);
+}
+
+UTEST(perf_tests, matrix_transpose_rect) {
+  size_t m = 512, n = 1536;
+  perf_matrix_t op;
+  perf_result_t result;
+  op.m1 = matrix_random_uniform(m, n, -1.0, 1.0, 4);
+  // A non-square transpose moves into a new buffer on every call.
+  result = perf_measure(perf_matrix_transpose, &op,
+                        2.0e-9 * sizeof(double) * m * n);
+  ASSERT_TRUE(perf_check("matrix_transpose_rect", "GB/s", result, 1));
+  matrix_free(op.m1);
+}
+
+UTEST(perf_tests, matrix_vector_mul) {
+  size_t m = 512, n = 4096;
+  perf_matrix_t op;
+  perf_result_t result;
+  op.m1 = matrix_random_uniform(m, n, -1.0, 1.0, 5);
+  op.v = vector_random_uniform(n, -1.0, 1.0, 6);
+  result = perf_measure(perf_matrix_vector_mul, &op, 2.0e-9 * m * n);
+  ASSERT_TRUE(perf_check("matrix_vector_mul", "GFLOP/s", result, 1));
+  matrix_free(op.m1);
+  vector_free(op.v);
+}
+
+UTEST(perf_tests, matrix_syrk) {
+  size_t n = 256, k = 256;
+  perf_matrix_t op;
+  perf_result_t result;
+  op.dst = matrix_new(n, n);
+  op.m1 = matrix_random_uniform(k, n, -1.0, 1.0, 7);
+  result = perf_measure(perf_matrix_syrk, &op, 1.0e-9 * n * (n + 1) * k);
+  ASSERT_TRUE(perf_check("matrix_syrk", "GFLOP/s", result, 0));
+  matrix_free(op.dst);
+  matrix_free(op.m1);
+}
@@ -0,0 +1,144 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include "perf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "linalg_memory.h"
+#include "linalg_tune.h"
+
+/** Longest line of the baseline file. */
+#define PERF_LINE 512
+/** Number of timing trials per kernel. */
+#define PERF_TRIALS 3
+
+static double perf_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1.0e-9;
+}
+
+perf_result_t perf_measure(perf_fn_t fn, void* ctx, double work) {
+  perf_result_t result = {0, 0};
+  memory_thread_stats_t before, after;
+  double t0, elapsed, throughput;
+  size_t calls, total = 0;
+  int trial;
+  fn(ctx);
+  memory_thread_stats(&before);
+  for (trial = 0; trial < PERF_TRIALS; trial++) {
+    calls = 0;
+    t0 = perf_seconds();
+    do {
+      fn(ctx);
+      calls++;
+      elapsed = perf_seconds() - t0;
+    } while (elapsed < PERF_TRIAL_SECONDS);
+    throughput = work * calls / elapsed;
+    if (throughput > result.throughput) {
+      result.throughput = throughput;
+    }
+    total += calls;
+  }
+  memory_thread_stats(&after);
+  result.allocations = (double)(after.allocations - before.allocations) / total;
+  return result;
+}
+
+static const char* perf_path(void) {
+  const char* path = getenv("LINALG_PERF_BASELINES");
+  return path != NULL ? path : PERF_BASELINES;
+}
+
+/** Reads the baseline of `name` from the entry `section`. */
+static bool perf_lookup(const char* section, const char* name,
+                        double* baseline, double* tolerance) {
+  char line[PERF_LINE], key[PERF_LINE], header[PERF_LINE];
+  bool in_entry = false, found = false;
+  double value, tol;
+  int fields;
+  FILE* f = fopen(perf_path(), "r");
+  if (f == NULL) {
+    return false;
+  }
+  snprintf(header, sizeof(header), "[%s]", section);
+  while (fgets(line, sizeof(line), f) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    if (line[0] == '[') {
+      in_entry = strcmp(line, header) == 0;
+    } else if (in_entry &&
+               (fields = sscanf(line, "%s %lf %lf", key, &value, &tol)) >= 2 &&
+               strcmp(key, name) == 0) {
+      *baseline = value;
+      *tolerance = fields == 3 ? tol : PERF_TOLERANCE;
+      found = true;
+    }
+  }
+  fclose(f);
+  return found;
+}
+
+/** Writes `name value` into this CPU's entry, replacing an older line. */
+static bool perf_update(const char* name, double value) {
+  const char* path = perf_path();
+  char line[PERF_LINE], key[PERF_LINE], header[PERF_LINE];
+  char tmp[PERF_LINE];
+  bool in_entry = false, written = false;
+  FILE *in, *out;
+  snprintf(header, sizeof(header), "[%s]", tune_cpu_model());
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  out = fopen(tmp, "w");
+  if (out == NULL) {
+    return false;
+  }
+  in = fopen(path, "r");
+  while (in != NULL && fgets(line, sizeof(line), in) != NULL) {
+    if (line[0] == '[') {
+      if (in_entry && !written) {
+        fprintf(out, "%s %.3g\n", name, value);
+        written = true;
+      }
+      in_entry = strncmp(line, header, strlen(header)) == 0;
+    } else if (in_entry && sscanf(line, "%s", key) == 1 &&
+               strcmp(key, name) == 0) {
+      fprintf(out, "%s %.3g\n", name, value);
+      written = true;
+      continue;
+    }
+    fputs(line, out);
+  }
+  if (in != NULL) {
+    fclose(in);
+  }
+  if (!written) {
+    if (!in_entry) {
+      fprintf(out, "%s\n", header);
+    }
+    fprintf(out, "%s %.3g\n", name, value);
+  }
+  return fclose(out) == 0 && rename(tmp, path) == 0;
+}
+
+bool perf_check(const char* name, const char* unit, perf_result_t result,
+                double max_allocations) {
+  double baseline, tolerance;
+  bool ok = result.allocations <= max_allocations;
+  printf("[ PERF     ] %-28s %10.3g %-7s %5.2f allocations/call", name,
+         result.throughput, unit, result.allocations);
+  if (getenv("LINALG_PERF_UPDATE") != NULL) {
+    printf(" (baseline updated)\n");
+    return perf_update(name, result.throughput) && ok;
+  }
+  if (perf_lookup(tune_cpu_model(), name, &baseline, &tolerance) ||
+      perf_lookup("default", name, &baseline, &tolerance)) {
+    printf(" (baseline %.3g, %+.0f%%)", baseline,
+           100 * (result.throughput / baseline - 1));
+    ok = ok && result.throughput >= baseline * (1 - tolerance);
+  }
+  printf("\n");
+  return ok;
+}
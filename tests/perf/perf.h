@@ -0,0 +1,55 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#ifndef LINALG_PERF_H
+#define LINALG_PERF_H
+
+#include <stdbool.h>  // bool
+#include <stddef.h>   // size_t
+
+/** Baseline file read when `LINALG_PERF_BASELINES` is not set. */
+#ifndef PERF_BASELINES
+#define PERF_BASELINES "tests/perf/baselines.txt"
+#endif
+
+/** Fraction below its baseline a kernel may fall before failing, unless
+ *  the baseline sets its own. */
+#ifndef PERF_TOLERANCE
+#define PERF_TOLERANCE 0.5
+#endif
+
+/** Seconds each timing trial runs the kernel for. */
+#ifndef PERF_TRIAL_SECONDS
+#define PERF_TRIAL_SECONDS 0.1
+#endif
+
+/** A kernel call under measurement. */
+typedef void (*perf_fn_t)(void* ctx);
+
+/** Outcome of timing one kernel. */
+typedef struct {
+  /** Best throughput over the trials, in units of `work` per second. */
+  double throughput;
+  /** Vectors and matrices created per call. */
+  double allocations;
+} perf_result_t;
+
+/** Times `fn` over several trials, each doing `work` units per call.
+ *
+ *  The first call is a warm-up. Allocations are counted with
+ *  `memory_thread_stats` and averaged over every timed call.
+ */
+perf_result_t perf_measure(perf_fn_t fn, void* ctx, double work);
+
+/** Reports `result` and compares it with the baseline of `name`.
+ *
+ *  Baselines come from the `[cpu model]` entry of the baseline file, or
+ *  from its `[default]` entry. Each line is `name throughput [tolerance]`.
+ *  Returns false if the throughput is below the band or the call allocated
+ *  more than `max_allocations` objects. With `LINALG_PERF_UPDATE` set the
+ *  measured throughput is written back as this CPU's baseline instead.
+ */
+bool perf_check(const char* name, const char* unit, perf_result_t result,
+                double max_allocations);
+
+#endif
@@ -0,0 +1,90 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <stdio.h>
+
+#include "linalg_vector.h"
+#include "perf.h"
+#include "utest.h"
+
+#define PERF_VECTOR_LENGTH (1 << 20)
+
+typedef struct {
+  vector_t* dst;
+  vector_t* v1;
+  vector_t* v2;
+  double result;
+} perf_vector_t;
+
+static void perf_vector_setup(perf_vector_t* op) {
+  op->dst = vector_zeros(PERF_VECTOR_LENGTH);
+  op->v1 = vector_linspace(PERF_VECTOR_LENGTH, -1.0, 1.0);
+  op->v2 = vector_ones(PERF_VECTOR_LENGTH);
+}
+
+static void perf_vector_teardown(perf_vector_t* op) {
+  vector_free(op->dst);
+  vector_free(op->v1);
+  vector_free(op->v2);
+}
+
+static void perf_vector_dot(void* ctx) {
+  perf_vector_t* op = ctx;
+  op->result += vector_dot(op->v1, op->v2);
+}
+
+static void perf_vector_dot_reproducible(void* ctx) {
+  perf_vector_t* op = ctx;
+  op->result += vector_dot_reproducible(op->v1, op->v2);
+}
+
+static void perf_vector_add_into(void* ctx) {
+  perf_vector_t* op = ctx;
+  vector_add_into(op->dst, op->v1, op->v2);
+}
+
+static void perf_vector_norm(void* ctx) {
+  perf_vector_t* op = ctx;
+  op->result += vector_norm(op->v1);
+}
+
+UTEST(perf_tests, vector_dot) {
+  perf_vector_t op;
+  perf_result_t result;
+  perf_vector_setup(&op);
+  result = perf_measure(perf_vector_dot, &op, 2.0e-9 * PERF_VECTOR_LENGTH);
+  ASSERT_TRUE(perf_check("vector_dot", "GFLOP/s", result, 0));
+  perf_vector_teardown(&op);
+}
+
+UTEST(perf_tests, vector_dot_reproducible) {
+  perf_vector_t op;
+  perf_result_t fast, result;
+  perf_vector_setup(&op);
+  fast = perf_measure(perf_vector_dot, &op, 2.0e-9 * PERF_VECTOR_LENGTH);
+  result = perf_measure(perf_vector_dot_reproducible, &op,
+                        2.0e-9 * PERF_VECTOR_LENGTH);
+  printf("[ PERF     ] reproducible dot runs at %.2fx the default\n",
+         result.throughput / fast.throughput);
+  ASSERT_TRUE(perf_check("vector_dot_reproducible", "GFLOP/s", result, 0));
+  perf_vector_teardown(&op);
+}
+
+UTEST(perf_tests, vector_add_into) {
+  perf_vector_t op;
+  perf_result_t result;
+  perf_vector_setup(&op);
+  result = perf_measure(perf_vector_add_into, &op,
+                        3.0e-9 * sizeof(double) * PERF_VECTOR_LENGTH);
+  ASSERT_TRUE(perf_check("vector_add_into", "GB/s", result, 0));
+  perf_vector_teardown(&op);
+}
+
+UTEST(perf_tests, vector_norm) {
+  perf_vector_t op;
+  perf_result_t result;
+  perf_vector_setup(&op);
+  result = perf_measure(perf_vector_norm, &op, 2.0e-9 * PERF_VECTOR_LENGTH);
+  ASSERT_TRUE(perf_check("vector_norm", "GFLOP/s", result, 0));
+  perf_vector_teardown(&op);
+}
@@ -0,0 +1,118 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <math.h>
+
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_random.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+UTEST(random_tests, test_random_philox4x32) {
+  // Known-answer vectors from the Random123 distribution.
+  uint32_t zero[4] = {0, 0, 0, 0};
+  uint32_t ones[4] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu};
+  uint32_t pi[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u};
+  uint32_t pi_key[2] = {0xa4093822u, 0x299f31d0u};
+  uint32_t out[4];
+  random_philox4x32(zero, zero, out);
+  ASSERT_EQ(out[0], 0x6627e8d5u);
+  ASSERT_EQ(out[1], 0xe169c58du);
+  ASSERT_EQ(out[2], 0xbc57ac4cu);
+  ASSERT_EQ(out[3], 0x9b00dbd8u);
+  random_philox4x32(ones, ones, out);
+  ASSERT_EQ(out[0], 0x408f276du);
+  ASSERT_EQ(out[1], 0x41c83b0eu);
+  ASSERT_EQ(out[2], 0xa20bc7c6u);
+  ASSERT_EQ(out[3], 0x6d5451fdu);
+  random_philox4x32(pi, pi_key, out);
+  ASSERT_EQ(out[0], 0xd16cfe09u);
+  ASSERT_EQ(out[1], 0x94fdccebu);
+  ASSERT_EQ(out[2], 0x5001e420u);
+  ASSERT_EQ(out[3], 0x24126ea1u);
+}
+
+UTEST(random_tests, test_random_uniform) {
+  size_t n = 100001;
+  vector_t* v = vector_random_uniform(n, -2.0, 6.0, 42);
+  vector_t* w = vector_random_uniform(n, -2.0, 6.0, 43);
+  double mean, variance;
+  ASSERT_TRUE(vector_min(v) >= -2.0);
+  ASSERT_TRUE(vector_max(v) < 6.0);
+  vector_mean_variance(v, &mean, &variance);
+  ASSERT_TRUE(fabs(mean - 2.0) < 0.05);
+  ASSERT_TRUE(fabs(variance - 64.0 / 12) < 0.05);
+  ASSERT_FALSE(vector_equal(v, w, 0.0));
+  vector_free(v);
+  vector_free(w);
+}
+
+UTEST(random_tests, test_random_normal) {
+  size_t n = 100001;
+  vector_t* v = vector_random_normal(n, 1.0, 3.0, 7);
+  double mean, variance;
+  vector_mean_variance(v, &mean, &variance);
+  ASSERT_TRUE(fabs(mean - 1.0) < 0.05);
+  ASSERT_TRUE(fabs(variance - 9.0) < 0.15);
+  ASSERT_TRUE(isfinite(vector_norm(v)));
+  vector_free(v);
+}
+
+UTEST(random_tests, test_random_thread_independent) {
+  size_t threads[3] = {1, 2, 5};
+  vector_t* serial = vector_random_normal(50001, 0.0, 1.0, 2024);
+  vector_t* v;
+  matrix_t* m;
+  parallel_policy_t policy = parallel_set_policy(PARALLEL_ALWAYS);
+  size_t t, i, j;
+  for (t = 0; t < 3; t++) {
+    parallel_set_threads(threads[t]);
+    v = vector_random_normal(50001, 0.0, 1.0, 2024);
+    ASSERT_TRUE(vector_equal(v, serial, 0.0));
+    vector_free(v);
+  }
+  // Padded rows draw the same stream as the flat vector.
+  m = matrix_random_normal(3, 64, 0.0, 1.0, 2024);
+  ASSERT_TRUE(m->ld > m->ncols);
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 64; j++) {
+      ASSERT_EQ(MATRIX_IDX_INTO(m, i, j), VECTOR_IDX_INTO(serial, i * 64 + j));
+    }
+  }
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  vector_free(serial);
+  matrix_free(m);
+}
+
+UTEST(random_tests, test_random_blocks) {
+  // Element 2q + h is half h of Philox block q, converted with libm.
+  size_t n = 1001;
+  vector_t* u = vector_random_uniform(n, -1.0, 3.0, 99);
+  vector_t* z = vector_random_normal(n, 0.5, 2.0, 99);
+  uint32_t counter[4] = {0, 0, 0, 0};
+  uint32_t key[2] = {99, 0};
+  uint32_t bits[4];
+  double turn = 2 * 3.14159265358979323846;
+  double u0, u1, radius, x;
+  size_t q;
+  for (q = 0; q < (n + 1) / 2; q++) {
+    counter[0] = (uint32_t)q;
+    random_philox4x32(counter, key, bits);
+    u0 = ldexp((double)((((uint64_t)bits[0] << 32) | bits[1]) >> 11), -53);
+    u1 = ldexp((double)((((uint64_t)bits[2] << 32) | bits[3]) >> 11), -53);
+    radius = 2.0 * sqrt(-2 * log(1 - u0));
+    ASSERT_EQ(VECTOR_IDX_INTO(u, 2 * q), -1.0 + 4.0 * u0);
+    x = 0.5 + radius * cos(turn * u1);
+    ASSERT_TRUE(fabs(VECTOR_IDX_INTO(z, 2 * q) - x) < 1e-13 * (1 + fabs(x)));
+    if (2 * q + 1 < n) {
+      ASSERT_EQ(VECTOR_IDX_INTO(u, 2 * q + 1), -1.0 + 4.0 * u1);
+      x = 0.5 + radius * sin(turn * u1);
+      ASSERT_TRUE(fabs(VECTOR_IDX_INTO(z, 2 * q + 1) - x) <
+                  1e-13 * (1 + fabs(x)));
+    }
+  }
+  vector_free(u);
+  vector_free(z);
+}
@@ -0,0 +1,94 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include "linalg_matrix.h"
+#include "linalg_stream.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+UTEST(stream_tests, test_stream_in_order) {
+  stream_t* s = stream_new();
+  vector_t* a = vector_ones(1000);
+  vector_t* b = vector_constant(1000, 2.0);
+  vector_t* c = vector_zeros(1000);
+  vector_t* target = vector_constant(1000, 18.0);
+  future_t* futures[4];
+  size_t i;
+  // Each operation consumes the result of the one before it.
+  futures[0] = stream_vector_add_into(s, c, a, b);
+  futures[1] = stream_vector_scalar_mul_into(s, c, c, 4.0);
+  futures[2] = stream_vector_add_into(s, c, c, c);
+  futures[3] = stream_vector_sub_into(s, c, c, target);
+  ASSERT_TRUE(future_wait(futures[3]) == c);
+  for (i = 0; i < 4; i++) {
+    ASSERT_TRUE(future_poll(futures[i]));
+    future_free(futures[i]);
+  }
+  for (i = 0; i < 1000; i++) {
+    ASSERT_EQ(VECTOR_IDX_INTO(c, i), 6.0);
+  }
+  stream_free(s);
+  vector_free(a);
+  vector_free(b);
+  vector_free(c);
+  vector_free(target);
+}
+
+UTEST(stream_tests, test_stream_concurrent) {
+  stream_t* streams[3];
+  matrix_t* m1 = matrix_ones(60, 40);
+  matrix_t* m2 = matrix_ones(40, 50);
+  matrix_t* dst[3];
+  matrix_t* target = matrix_constant(60, 50, 40.0);
+  vector_t* v = vector_ones(40);
+  vector_t* mv;
+  future_t *f, *fv;
+  size_t i;
+  for (i = 0; i < 3; i++) {
+    streams[i] = stream_new();
+    dst[i] = matrix_new(60, 50);
+    future_free(stream_matrix_mul_into(streams[i], dst[i], m1, m2));
+  }
+  fv = stream_matrix_vector_mul(streams[0], m1, v);
+  f = stream_matrix_mul_into(streams[1], dst[1], m1, m2);
+  mv = future_wait(fv);
+  ASSERT_EQ(VECTOR_IDX_INTO(mv, 59), 40.0);
+  ASSERT_TRUE(future_wait(f) == dst[1]);
+  future_free(f);
+  future_free(fv);
+  for (i = 0; i < 3; i++) {
+    stream_synchronize(streams[i]);
+    ASSERT_TRUE(matrix_equal(dst[i], target, 0.0));
+    stream_free(streams[i]);
+    matrix_free(dst[i]);
+  }
+  matrix_free(m1);
+  matrix_free(m2);
+  matrix_free(target);
+  vector_free(v);
+  vector_free(mv);
+}
+
+static void* stream_test_count(void* ctx) {
+  int** counter = ctx;
+  (**counter)++;
+  return NULL;
+}
+
+UTEST(stream_tests, test_stream_free_drains) {
+  stream_t* s = stream_new();
+  int counter = 0;
+  int* ptr = &counter;
+  future_t* last = NULL;
+  int i;
+  for (i = 0; i < 100; i++) {
+    if (last != NULL) {
+      future_free(last);
+    }
+    last = stream_submit(s, stream_test_count, &ptr, sizeof(ptr));
+  }
+  stream_free(s);
+  ASSERT_EQ(counter, 100);
+  ASSERT_TRUE(future_poll(last));
+  future_free(last);
+}
@@ -0,0 +1,73 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <stdatomic.h>
+
+#include "linalg_parallel.h"
+#include "linalg_task.h"
+#include "utest.h"
+
+typedef struct {
+  atomic_int* clock;
+  int* stamp;
+} stamp_task_t;
+
+static void stamp(void* ctx) {
+  stamp_task_t* t = ctx;
+  *t->stamp = atomic_fetch_add(t->clock, 1);
+}
+
+UTEST(task_tests, test_task_graph_dependencies) {
+  atomic_int clock = 0;
+  int stamps[4];
+  int key;
+  stamp_task_t args;
+  task_t* tasks[4];
+  task_graph_t* g = task_graph_new();
+  size_t i;
+  args.clock = &clock;
+  for (i = 0; i < 4; i++) {
+    args.stamp = &stamps[i];
+    tasks[i] = task_graph_add(g, stamp, &args, sizeof(args));
+  }
+  /* 0 writes, 1 and 2 read, 3 writes again. */
+  task_writes(g, tasks[0], &key);
+  task_reads(g, tasks[1], &key);
+  task_reads(g, tasks[2], &key);
+  task_writes(g, tasks[3], &key);
+  ASSERT_EQ(task_graph_size(g), (size_t)4);
+  parallel_set_threads(4);
+  task_graph_run(g);
+  parallel_set_threads(0);
+  task_graph_free(g);
+  ASSERT_EQ(stamps[0], 0);
+  ASSERT_TRUE(stamps[1] > stamps[0]);
+  ASSERT_TRUE(stamps[2] > stamps[0]);
+  ASSERT_EQ(stamps[3], 3);
+}
+
+UTEST(task_tests, test_task_graph_chain) {
+  atomic_int clock = 0;
+  int stamps[100];
+  stamp_task_t args;
+  task_t* prev = NULL;
+  task_t* t;
+  task_graph_t* g = task_graph_new();
+  size_t i;
+  args.clock = &clock;
+  for (i = 0; i < 100; i++) {
+    args.stamp = &stamps[i];
+    t = task_graph_add(g, stamp, &args, sizeof(args));
+    if (prev != NULL) {
+      task_depend(prev, t);
+    }
+    prev = t;
+  }
+  parallel_set_threads(3);
+  task_graph_run(g);
+  parallel_set_threads(0);
+  task_graph_free(g);
+  for (i = 0; i < 100; i++) {
+    ASSERT_EQ(stamps[i], (int)i);
+  }
+}
@@ -0,0 +1,116 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_tile.h"
+#include "utest.h"
+
+static matrix_t* tile_test_pattern(size_t nrows, size_t ncols) {
+  matrix_t* m = matrix_new(nrows, ncols);
+  size_t i, j;
+  for (i = 0; i < nrows; i++) {
+    for (j = 0; j < ncols; j++) {
+      MATRIX_IDX_INTO(m, i, j) = (double)((i * 5 + j * 3) % 7) - 3.0;
+    }
+  }
+  return m;
+}
+
+UTEST(tile_tests, test_tile_matrix_round_trip) {
+  matrix_t* m = tile_test_pattern(11, 7);
+  tile_matrix_t* t = tile_matrix_from_matrix(m, 4);
+  matrix_t* back = tile_matrix_to_matrix(t);
+  ASSERT_EQ(t->tile_rows, (size_t)3);
+  ASSERT_EQ(t->tile_cols, (size_t)2);
+  ASSERT_EQ(TILE_MATRIX_IDX_INTO(t, 9, 5), MATRIX_IDX_INTO(m, 9, 5));
+  ASSERT_EQ(tile_matrix_tile(t, 2, 1)[1 * 4 + 1], MATRIX_IDX_INTO(m, 9, 5));
+  ASSERT_TRUE(matrix_equal(m, back, 0.0));
+  matrix_free(m);
+  matrix_free(back);
+  tile_matrix_free(t);
+}
+
+UTEST(tile_tests, test_tile_matrix_mul) {
+  matrix_t* m1 = tile_test_pattern(13, 10);
+  matrix_t* m2 = tile_test_pattern(10, 9);
+  matrix_t* target = matrix_mul(m1, m2);
+  tile_matrix_t* t1 = tile_matrix_from_matrix(m1, 4);
+  tile_matrix_t* t2 = tile_matrix_from_matrix(m2, 4);
+  tile_matrix_t* dst = tile_matrix_zeros(13, 9, 4);
+  tile_matrix_t* t_target = tile_matrix_from_matrix(target, 4);
+  parallel_set_threads(3);
+  tile_matrix_mul_into(dst, t1, t2);
+  parallel_set_threads(0);
+  ASSERT_TRUE(tile_matrix_equal(dst, t_target, 1.0e-9));
+  matrix_free(m1);
+  matrix_free(m2);
+  matrix_free(target);
+  tile_matrix_free(t1);
+  tile_matrix_free(t2);
+  tile_matrix_free(dst);
+  tile_matrix_free(t_target);
+}
+
+UTEST(tile_tests, test_tile_matrix_transpose) {
+  matrix_t* m = tile_test_pattern(6, 9);
+  tile_matrix_t* t = tile_matrix_from_matrix(m, 4);
+  tile_matrix_t* tt = tile_matrix_zeros(9, 6, 4);
+  tile_matrix_t* target;
+  tile_matrix_transpose_into(tt, t);
+  matrix_transpose(m);
+  target = tile_matrix_from_matrix(m, 4);
+  ASSERT_TRUE(tile_matrix_equal(tt, target, 0.0));
+  matrix_free(m);
+  tile_matrix_free(t);
+  tile_matrix_free(tt);
+  tile_matrix_free(target);
+}
+
+UTEST(tile_tests, test_tile_matrix_cholesky) {
+  double arr[] = {4.0, 2.0, 2.0, 2.0, 5.0, 3.0, 2.0, 3.0, 6.0};
+  matrix_t* m = matrix_from_array(arr, 3, 3);
+  tile_matrix_t* t = tile_matrix_from_matrix(m, 2);
+  matrix_t* l;
+  ASSERT_TRUE(matrix_cholesky_tiled(m, 2));
+  ASSERT_TRUE(tile_matrix_cholesky(t));
+  l = tile_matrix_to_matrix(t);
+  ASSERT_TRUE(matrix_equal(l, m, 1.0e-12));
+  matrix_free(m);
+  matrix_free(l);
+  tile_matrix_free(t);
+}
+
+UTEST(tile_tests, test_tile_matrix_mismatch) {
+  tile_matrix_t* a = tile_matrix_zeros(10, 12, 4);
+  tile_matrix_t* b = tile_matrix_zeros(12, 10, 8);
+  tile_matrix_t* c = tile_matrix_zeros(10, 10, 4);
+  int status, k;
+  pid_t pid;
+  // Mismatched tiles or shapes are an error instead of an access past the
+  // end of a buffer.
+  for (k = 0; k < 3; k++) {
+    fflush(stdout);
+    pid = fork();
+    ASSERT_TRUE(pid >= 0);
+    if (pid == 0) {
+      if (k == 0) {
+        tile_matrix_mul_into(c, a, b);
+      } else if (k == 1) {
+        tile_matrix_transpose_into(c, a);
+      } else {
+        tile_matrix_cholesky(a);
+      }
+      _exit(EXIT_SUCCESS);
+    }
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), EXIT_FAILURE);
+  }
+  tile_matrix_free(a);
+  tile_matrix_free(b);
+  tile_matrix_free(c);
+}
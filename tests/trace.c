@@ -0,0 +1,87 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "linalg_trace.h"
+#include "utest.h"
+
+UTEST(trace_tests, test_trace_disabled_by_default) {
+  trace_reset();
+  ASSERT_FALSE(trace_enabled());
+  trace_begin("ignored", 1, 1);
+  trace_end("ignored");
+  ASSERT_EQ(trace_event_count(), (size_t)0);
+}
+
+UTEST(trace_tests, test_trace_begin_end) {
+  trace_reset();
+  trace_enable();
+  trace_begin("op", 3, 4);
+  trace_end("op");
+  trace_disable();
+  ASSERT_EQ(trace_event_count(), (size_t)2);
+  trace_reset();
+  ASSERT_EQ(trace_event_count(), (size_t)0);
+}
+
+UTEST(trace_tests, test_trace_ring_wraps) {
+  size_t i;
+  trace_reset();
+  trace_enable();
+  for (i = 0; i < TRACE_BUFFER_CAPACITY; i++) {
+    trace_begin("op", 1, 1);
+    trace_end("op");
+  }
+  trace_disable();
+  ASSERT_EQ(trace_event_count(), (size_t)TRACE_BUFFER_CAPACITY);
+  trace_reset();
+}
+
+UTEST(trace_tests, test_trace_flush) {
+  char buf[512];
+  size_t n;
+  const char* path = "bin/trace_test.json";
+  FILE* f;
+  trace_reset();
+  trace_enable();
+  trace_begin("matrix_mul", 2, 3);
+  trace_end("matrix_mul");
+  trace_disable();
+  ASSERT_TRUE(trace_flush(path));
+  f = fopen(path, "r");
+  ASSERT_TRUE(f != NULL);
+  n = fread(buf, 1, sizeof(buf) - 1, f);
+  buf[n] = '\0';
+  fclose(f);
+  remove(path);
+  ASSERT_TRUE(strstr(buf, "\"traceEvents\"") != NULL);
+  ASSERT_TRUE(strstr(buf, "\"name\":\"matrix_mul\",\"ph\":\"B\"") != NULL);
+  ASSERT_TRUE(strstr(buf, "\"args\":{\"rows\":2,\"cols\":3}") != NULL);
+  ASSERT_TRUE(strstr(buf, "\"ph\":\"E\"") != NULL);
+  trace_reset();
+}
+
+static void* trace_test_thread(void* arg) {
+  (void)arg;
+  trace_begin("thread", 1, 1);
+  trace_end("thread");
+  return NULL;
+}
+
+UTEST(trace_tests, test_trace_thread_exit) {
+  pthread_t thread;
+  int i;
+  trace_reset();
+  trace_enable();
+  // Each thread hands its ring to the next one without losing events.
+  for (i = 0; i < 3; i++) {
+    ASSERT_EQ(pthread_create(&thread, NULL, trace_test_thread, NULL), 0);
+    pthread_join(thread, NULL);
+  }
+  trace_disable();
+  ASSERT_EQ(trace_event_count(), (size_t)6);
+  trace_reset();
+}
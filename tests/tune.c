@@ -0,0 +1,120 @@
+// linalg - C89 linear algebra library
+// Copyright (C) Seaton Ullberg and contributors -- MIT license
+
+#include <stdio.h>
+#include <string.h>
+
+#include "linalg_matrix.h"
+#include "linalg_parallel.h"
+#include "linalg_tune.h"
+#include "linalg_vector.h"
+#include "utest.h"
+
+UTEST(tune_tests, test_tune_defaults) {
+  tune_params_t params;
+  tune_defaults(&params);
+  ASSERT_TRUE(params.gemm_kc >= 64);
+  ASSERT_TRUE(params.gemm_nc >= 64 && params.gemm_nc <= 2048);
+  ASSERT_TRUE(params.transpose_block >= 8 && params.transpose_block <= 128);
+  ASSERT_TRUE(params.gemv_block >= 256);
+  ASSERT_EQ(params.vector_thresholds[VECTOR_OP_ADD],
+            vector_parallel_threshold(VECTOR_OP_ADD));
+  ASSERT_TRUE(strlen(tune_cpu_model()) > 0);
+}
+
+UTEST(tune_tests, test_tune_profile) {
+  const char* path = "bin/tune-test.profile";
+  tune_params_t saved, loaded;
+  FILE* f;
+  char line[512];
+  size_t headers = 0;
+  remove(path);
+  tune_defaults(&saved);
+  ASSERT_FALSE(tune_load(path, &loaded));
+  // Another machine's entry survives saving this one twice.
+  f = fopen(path, "w");
+  ASSERT_TRUE(f != NULL);
+  fputs("[Some Other CPU]\ngemm_kc 7\n", f);
+  fclose(f);
+  saved.gemm_kc = 96;
+  saved.vector_thresholds[VECTOR_OP_SUB] = 12345;
+  ASSERT_TRUE(tune_save(path, &saved));
+  saved.gemm_nc = 320;
+  ASSERT_TRUE(tune_save(path, &saved));
+  tune_defaults(&loaded);
+  ASSERT_TRUE(tune_load(path, &loaded));
+  ASSERT_EQ(loaded.gemm_kc, 96);
+  ASSERT_EQ(loaded.gemm_nc, 320);
+  ASSERT_EQ(loaded.transpose_block, saved.transpose_block);
+  ASSERT_EQ(loaded.vector_thresholds[VECTOR_OP_SUB], 12345);
+  f = fopen(path, "r");
+  while (fgets(line, sizeof(line), f) != NULL) {
+    headers += line[0] == '[';
+  }
+  fclose(f);
+  ASSERT_EQ(headers, 2);
+  remove(path);
+}
+
+UTEST(tune_tests, test_tune_set_params) {
+  matrix_t* m1 = matrix_ones(40, 300);
+  matrix_t* m2 = matrix_ones(300, 50);
+  matrix_t* m = matrix_new(40, 50);
+  matrix_t* target = matrix_constant(40, 50, 300.0);
+  matrix_t* sq = matrix_new(37, 37);
+  vector_t* v = vector_ones(300);
+  vector_t* mv;
+  tune_params_t saved = *tune_params();
+  tune_params_t params = saved;
+  size_t i, j;
+  for (i = 0; i < 37; i++) {
+    for (j = 0; j < 37; j++) {
+      MATRIX_IDX_INTO(sq, i, j) = (double)(i * 37 + j);
+    }
+  }
+  params.gemm_kc = 16;
+  params.gemm_nc = 24;
+  params.transpose_block = 5;
+  params.gemv_block = 7;
+  tune_set_params(&params);
+  ASSERT_EQ(tune_params()->gemm_nc, 24);
+  matrix_mul_into(m, m1, m2);
+  ASSERT_TRUE(matrix_equal(m, target, 0.0));
+  matrix_transpose(sq);
+  mv = matrix_vector_mul(m1, v);
+  tune_set_params(&saved);
+  for (i = 0; i < 37; i++) {
+    for (j = 0; j < 37; j++) {
+      ASSERT_EQ(MATRIX_IDX_INTO(sq, i, j), (double)(j * 37 + i));
+    }
+  }
+  for (i = 0; i < 40; i++) {
+    ASSERT_EQ(VECTOR_IDX_INTO(mv, i), 300.0);
+  }
+  matrix_free(m1);
+  matrix_free(m2);
+  matrix_free(m);
+  matrix_free(target);
+  matrix_free(sq);
+  vector_free(v);
+  vector_free(mv);
+}
+
+static void tune_test_nested(void* ctx, size_t begin, size_t end) {
+  bool* refused = ctx;
+  tune_params_t params;
+  size_t i;
+  for (i = begin; i < end; i++) {
+    refused[i] = parallel_nested() && !tune_run(&params);
+  }
+}
+
+UTEST(tune_tests, test_tune_run_nested) {
+  bool refused[2] = {false, false};
+  // Inside the pool every loop runs serially, so tuning must not run.
+  parallel_set_threads(2);
+  parallel_for(2, tune_test_nested, refused);
+  parallel_set_threads(0);
+  ASSERT_TRUE(refused[0]);
+  ASSERT_TRUE(refused[1]);
+}
@@ -2,9 +2,11 @@
 // Copyright (C) Seaton Ullberg and contributors -- MIT license
 
 #include <math.h>
+#include <pthread.h>
 #include <string.h>
 
 #include "linalg_base.h"
+#include "linalg_parallel.h"
 #include "linalg_vector.h"
 #include "utest.h"
 
@@ -56,6 +58,30 @@ UTEST(vector_tests, test_vector_slice) {
   vector_free(parent);
 }
 
+static void* slice_repeatedly(void* parent) {
+  vector_t* child;
+  int i;
+  for (i = 0; i < 10000; i++) {
+    child = vector_slice((vector_t*)parent, 0, 2);
+    vector_free(child);
+  }
+  return NULL;
+}
+
+UTEST(vector_tests, test_vector_slice_concurrent) {
+  vector_t* parent = vector_zeros(3);
+  pthread_t threads[4];
+  int i;
+  for (i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, slice_repeatedly, parent);
+  }
+  for (i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  ASSERT_EQ(REF_COUNT(parent), 0);
+  vector_free(parent);
+}
+
 UTEST(vector_tests, test_vector_add) {
   double arr1[] = {0.0, 1.0, 1.0};
   vector_t* v1 = vector_from_array(arr1, 3);
@@ -140,4 +166,341 @@ UTEST(vector_tests, test_vector_to_string) {
   ASSERT_EQ(strcmp(res, target), 0);
   vector_free(v);
   free(res);
-}
\ No newline at end of file
+}
+
+UTEST(vector_tests, test_vector_copy_on_write) {
+  double arr[] = {1.0, 2.0, 3.0};
+  vector_t* v = vector_from_array(arr, 3);
+  vector_t* copy;
+  vector_t* twice;
+  linalg_set_copy_on_write(true);
+  copy = vector_copy(v);
+  twice = vector_copy(copy);
+  linalg_set_copy_on_write(false);
+  ASSERT_TRUE(DATA(copy) == DATA(v));
+  ASSERT_TRUE(DATA(twice) == DATA(v));
+  ASSERT_TRUE(MEMORY_OWNER(copy) == MEMORY_OWNER(v));
+  ASSERT_EQ(REF_COUNT(MEMORY_OWNER(v)), 3);
+  vector_scalar_mul_into(copy, copy, 2.0);
+  ASSERT_TRUE(DATA(copy) != DATA(v));
+  ASSERT_EQ(REF_COUNT(MEMORY_OWNER(v)), 2);
+  ASSERT_EQ(VECTOR_IDX_INTO(copy, 2), 6.0);
+  ASSERT_EQ(VECTOR_AT(v, 2), 3.0);
+  // Writing the source detaches the source, not its copies.
+  vector_scalar_mul_into(v, v, 5.0);
+  ASSERT_EQ(VECTOR_AT(v, 2), 15.0);
+  ASSERT_EQ(VECTOR_AT(twice, 2), 3.0);
+  // The source may be freed first; the last holder keeps the buffer.
+  vector_free(v);
+  v = vector_from_array(arr, 3);
+  ASSERT_TRUE(vector_equal(v, twice, 0.0));
+  linalg_set_copy_on_write(true);
+  vector_free(copy);
+  copy = vector_copy(v);
+  linalg_set_copy_on_write(false);
+  vector_free(v);
+  v = copy;
+  VECTOR_IDX_INTO(v, 0) = -1.0;
+  ASSERT_TRUE(OWNS_MEMORY(v));
+  ASSERT_EQ(VECTOR_AT(twice, 0), 1.0);
+  vector_free(twice);
+  vector_free(v);
+}
+
+UTEST(vector_tests, test_vector_copy_on_write_views) {
+  vector_t* v = vector_linspace(8, 0.0, 7.0);
+  vector_t* copy;
+  vector_t* slice;
+  linalg_set_copy_on_write(true);
+  copy = vector_copy(v);
+  linalg_set_copy_on_write(false);
+  // Writing through a view of the source leaves the copy intact.
+  slice = vector_slice(v, 2, 4);
+  VECTOR_IDX_INTO(slice, 0) = -1.0;
+  ASSERT_EQ(VECTOR_AT(v, 2), -1.0);
+  ASSERT_EQ(VECTOR_AT(copy, 2), 2.0);
+  vector_free(copy);
+  // A source that views point into is copied eagerly.
+  linalg_set_copy_on_write(true);
+  copy = vector_copy(v);
+  linalg_set_copy_on_write(false);
+  ASSERT_TRUE(DATA(copy) != DATA(v));
+  VECTOR_IDX_INTO(slice, 1) = -2.0;
+  ASSERT_EQ(VECTOR_AT(copy, 3), 3.0);
+  vector_free(slice);
+  vector_free(copy);
+  vector_free(v);
+}
+
+UTEST(vector_tests, test_vector_parallel_ops) {
+  size_t n = 1001;
+  vector_t* a;
+  vector_t* b;
+  vector_t* sum;
+  vector_t* target;
+  parallel_policy_t policy;
+  size_t i;
+  parallel_set_threads(4);
+  policy = parallel_set_policy(PARALLEL_ALWAYS);
+  a = vector_linspace(n, 0.0, 1000.0);
+  b = vector_constant(n, 2.0);
+  sum = vector_add(a, b);
+  vector_scalar_mul_into(sum, sum, 2.0);
+  vector_sub_into(sum, sum, b);
+  target = vector_copy(sum);
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  for (i = 0; i < n; i++) {
+    ASSERT_EQ(VECTOR_IDX_INTO(target, i), 2.0 * i + 2.0);
+  }
+  vector_free(a);
+  vector_free(b);
+  vector_free(sum);
+  vector_free(target);
+}
+
+UTEST(vector_tests, test_vector_parallel_threshold) {
+  size_t previous = vector_parallel_threshold(VECTOR_OP_ADD);
+  vector_set_parallel_threshold(VECTOR_OP_ADD, 10);
+  ASSERT_EQ(vector_parallel_threshold(VECTOR_OP_ADD), (size_t)10);
+  vector_set_parallel_threshold(VECTOR_OP_ADD, previous);
+}
+
+/** Returns the distance between `x` and `ref` in units of ref's last place. */
+static double ulp_error(double x, double ref) {
+  double ulp = nextafter(fabs(ref), INFINITY) - fabs(ref);
+  return fabs(x - ref) / ulp;
+}
+
+UTEST(vector_tests, test_vector_map_accuracy) {
+  size_t n = 20001;
+  vector_t* wide = vector_linspace(n, -700.0, 700.0);
+  vector_t* narrow = vector_linspace(n, -20.0, 20.0);
+  vector_t* positive = vector_linspace(n, 1.0e-3, 1.0e3);
+  vector_t* res = vector_new(n);
+  size_t i;
+  vector_map_exp_into(res, wide);
+  for (i = 0; i < n; i++) {
+    ASSERT_TRUE(ulp_error(VECTOR_IDX_INTO(res, i),
+                          exp(VECTOR_IDX_INTO(wide, i))) <= 2.5);
+  }
+  vector_map_log_into(res, positive);
+  for (i = 0; i < n; i++) {
+    ASSERT_TRUE(ulp_error(VECTOR_IDX_INTO(res, i),
+                          log(VECTOR_IDX_INTO(positive, i))) <= 2.0);
+  }
+  vector_map_sqrt_into(res, positive);
+  for (i = 0; i < n; i++) {
+    ASSERT_EQ(VECTOR_IDX_INTO(res, i), sqrt(VECTOR_IDX_INTO(positive, i)));
+  }
+  vector_map_tanh_into(res, narrow);
+  for (i = 0; i < n; i++) {
+    ASSERT_TRUE(ulp_error(VECTOR_IDX_INTO(res, i),
+                          tanh(VECTOR_IDX_INTO(narrow, i))) <= 3.5);
+  }
+  vector_map_sigmoid_into(res, narrow);
+  for (i = 0; i < n; i++) {
+    ASSERT_TRUE(
+        ulp_error(VECTOR_IDX_INTO(res, i),
+                  1.0 / (1.0 + exp(-VECTOR_IDX_INTO(narrow, i)))) <= 3.5);
+  }
+  vector_free(wide);
+  vector_free(narrow);
+  vector_free(positive);
+  vector_free(res);
+}
+
+UTEST(vector_tests, test_vector_map_special_values) {
+  double arr[] = {0.0, -1.0, INFINITY, 1000.0, -1000.0};
+  vector_t* v = vector_from_array(arr, 5);
+  vector_t* res = vector_new(5);
+  vector_map_log_into(res, v);
+  ASSERT_TRUE(isinf(VECTOR_IDX_INTO(res, 0)) && VECTOR_IDX_INTO(res, 0) < 0);
+  ASSERT_TRUE(isnan(VECTOR_IDX_INTO(res, 1)));
+  ASSERT_TRUE(isinf(VECTOR_IDX_INTO(res, 2)));
+  vector_map_exp_into(res, v);
+  ASSERT_EQ(VECTOR_IDX_INTO(res, 0), 1.0);
+  ASSERT_TRUE(isinf(VECTOR_IDX_INTO(res, 3)));
+  ASSERT_EQ(VECTOR_IDX_INTO(res, 4), 0.0);
+  vector_map_tanh_into(res, v);
+  ASSERT_EQ(VECTOR_IDX_INTO(res, 4), -1.0);
+  vector_free(v);
+  vector_free(res);
+}
+
+UTEST(vector_tests, test_vector_map_selects) {
+  // The maps compute every case and select; check each selected lane.
+  double arr[] = {NAN, -0.0, 709.7, -708.0, 4.9e-324, 1e-310, 25.0, -0.1};
+  vector_t* v = vector_from_array(arr, 8);
+  vector_t* res = vector_new(8);
+  size_t i;
+  vector_map_exp_into(res, v);
+  ASSERT_TRUE(isnan(VECTOR_AT(res, 0)));
+  ASSERT_EQ(VECTOR_AT(res, 1), 1.0);
+  ASSERT_TRUE(fabs(VECTOR_AT(res, 2) / exp(709.7) - 1) < 1e-15);
+  ASSERT_TRUE(fabs(VECTOR_AT(res, 3) / exp(-708.0) - 1) < 1e-15);
+  vector_map_log_into(res, v);
+  ASSERT_TRUE(isnan(VECTOR_AT(res, 0)));
+  ASSERT_TRUE(isinf(VECTOR_AT(res, 1)) && VECTOR_AT(res, 1) < 0);
+  for (i = 4; i < 6; i++) {
+    ASSERT_TRUE(fabs(VECTOR_AT(res, i) / log(arr[i]) - 1) < 1e-15);
+  }
+  vector_map_tanh_into(res, v);
+  ASSERT_TRUE(isnan(VECTOR_AT(res, 0)));
+  ASSERT_TRUE(signbit(VECTOR_AT(res, 1)));
+  ASSERT_EQ(VECTOR_AT(res, 6), 1.0);
+  ASSERT_TRUE(fabs(VECTOR_AT(res, 7) - tanh(-0.1)) < 1e-16);
+  vector_free(v);
+  vector_free(res);
+}
+
+UTEST(vector_tests, test_vector_map_into) {
+  vector_t* v = vector_linspace(5000, 0.0, 1.0);
+  vector_t* res = vector_new(5000);
+  parallel_policy_t policy;
+  size_t i;
+  parallel_set_threads(3);
+  policy = parallel_set_policy(PARALLEL_ALWAYS);
+  vector_map_into(res, v, cos);
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  for (i = 0; i < 5000; i++) {
+    ASSERT_EQ(VECTOR_IDX_INTO(res, i), cos(VECTOR_IDX_INTO(v, i)));
+  }
+  vector_free(v);
+  vector_free(res);
+}
+
+UTEST(vector_tests, test_vector_reductions) {
+  double arr[5] = {3.0, -7.0, 2.0, 9.0, -7.0};
+  vector_t* v = vector_from_array(arr, 5);
+  ASSERT_EQ(vector_sum(v), 0.0);
+  ASSERT_EQ(vector_prod(v), 2646.0);
+  ASSERT_EQ(vector_min(v), -7.0);
+  ASSERT_EQ(vector_max(v), 9.0);
+  ASSERT_EQ(vector_argmin(v), 1);
+  ASSERT_EQ(vector_argmax(v), 3);
+  ASSERT_EQ(vector_norm_l1(v), 28.0);
+  ASSERT_EQ(vector_norm_inf(v), 9.0);
+  ASSERT_TRUE(fabs(vector_mean(v)) < 1e-15);
+  ASSERT_TRUE(fabs(vector_variance(v) - 192.0 / 5) < 1e-12);
+  vector_free(v);
+}
+
+UTEST(vector_tests, test_vector_parallel_reductions) {
+  size_t n = 100003;
+  vector_t* v = vector_new(n);
+  double mean, variance, serial_mean, serial_variance;
+  parallel_policy_t policy;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    VECTOR_IDX_INTO(v, i) = 1e9 + (double)((i * 37) % 1001);
+  }
+  VECTOR_IDX_INTO(v, 77777) = 2e9;
+  VECTOR_IDX_INTO(v, 12345) = -1.0;
+  vector_mean_variance(v, &serial_mean, &serial_variance);
+  parallel_set_threads(4);
+  policy = parallel_set_policy(PARALLEL_ALWAYS);
+  vector_mean_variance(v, &mean, &variance);
+  ASSERT_EQ(vector_argmax(v), 77777);
+  ASSERT_EQ(vector_argmin(v), 12345);
+  ASSERT_EQ(vector_max(v), 2e9);
+  ASSERT_EQ(vector_min(v), -1.0);
+  ASSERT_TRUE(fabs(vector_sum(v) / n - mean) < 1e-3);
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  ASSERT_TRUE(fabs(mean - serial_mean) < 1e-6);
+  ASSERT_TRUE(fabs(variance - serial_variance) < 1e-6 * serial_variance);
+  vector_free(v);
+}
+
+UTEST(vector_tests, test_vector_reductions_nan) {
+  size_t n = 100003;
+  size_t at[4] = {0, 13, 50001, 100002};
+  size_t threads[2] = {1, 4};
+  vector_t* v = vector_linspace(n, -1.0, 1.0);
+  parallel_policy_t policy = parallel_set_policy(PARALLEL_ALWAYS);
+  size_t i, t;
+  for (t = 0; t < 2; t++) {
+    parallel_set_threads(threads[t]);
+    for (i = 0; i < 4; i++) {
+      VECTOR_IDX_INTO(v, at[i]) = NAN;
+      ASSERT_TRUE(isnan(vector_min(v)));
+      ASSERT_TRUE(isnan(vector_max(v)));
+      ASSERT_TRUE(isnan(vector_norm_inf(v)));
+      ASSERT_TRUE(isnan(vector_norm(v)));
+      ASSERT_EQ(vector_argmin(v), at[i]);
+      ASSERT_EQ(vector_argmax(v), at[i]);
+      VECTOR_IDX_INTO(v, at[i]) = 0.5;
+    }
+  }
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  // Ties go to the first occurrence.
+  VECTOR_IDX_INTO(v, 70000) = -1.0;
+  VECTOR_IDX_INTO(v, 90000) = 2.0;
+  VECTOR_IDX_INTO(v, 95000) = 2.0;
+  ASSERT_EQ(vector_min(v), -1.0);
+  ASSERT_EQ(vector_argmin(v), 70000);
+  ASSERT_EQ(vector_argmax(v), 90000);
+  ASSERT_EQ(vector_norm_inf(v), 2.0);
+  vector_free(v);
+}
+
+UTEST(vector_tests, test_vector_norm_scaled) {
+  double big[3] = {3e200, 4e200, 0.0};
+  double tiny[2] = {3e-200, 4e-200};
+  double mixed[3] = {1e300, 1e-300, 1.0};
+  vector_t* v = vector_from_array(big, 3);
+  ASSERT_TRUE(fabs(vector_norm(v) / 5e200 - 1) < 1e-15);
+  vector_free(v);
+  v = vector_from_array(tiny, 2);
+  ASSERT_TRUE(fabs(vector_norm(v) / 5e-200 - 1) < 1e-15);
+  vector_free(v);
+  v = vector_from_array(mixed, 3);
+  ASSERT_TRUE(fabs(vector_norm_scaled(v) / 1e300 - 1) < 1e-15);
+  vector_free(v);
+  v = vector_linspace(10, 1.0, 10.0);
+  ASSERT_TRUE(fabs(vector_norm_scaled(v) - sqrt(385.0)) < 1e-12);
+  vector_free(v);
+  // Chunks of plain squares next to chunks that need scaling.
+  v = vector_constant(5000, 1e-200);
+  ASSERT_TRUE(fabs(vector_norm(v) / (1e-200 * sqrt(5000.0)) - 1) < 1e-12);
+  VECTOR_IDX_INTO(v, 3000) = 1e300;
+  VECTOR_IDX_INTO(v, 4000) = 1.0;
+  ASSERT_TRUE(fabs(vector_norm(v) / 1e300 - 1) < 1e-15);
+  vector_free(v);
+}
+
+UTEST(vector_tests, test_vector_reproducible) {
+  size_t n = 300007;
+  size_t threads[4] = {1, 2, 3, 7};
+  vector_t* v = vector_new(n);
+  vector_t* w = vector_new(n);
+  double dot, sum, norm;
+  parallel_policy_t policy;
+  size_t i;
+  for (i = 0; i < n; i++) {
+    VECTOR_IDX_INTO(v, i) = sin((double)i) * (double)(i % 97);
+    VECTOR_IDX_INTO(w, i) = cos((double)i) / (double)(1 + i % 13);
+  }
+  vector_set_reproducible(true);
+  policy = parallel_set_policy(PARALLEL_ALWAYS);
+  parallel_set_threads(1);
+  dot = vector_dot(v, w);
+  sum = vector_sum(v);
+  norm = vector_norm(v);
+  for (i = 1; i < 4; i++) {
+    parallel_set_threads(threads[i]);
+    ASSERT_EQ(vector_dot(v, w), dot);
+    ASSERT_EQ(vector_sum(v), sum);
+    ASSERT_EQ(vector_norm(v), norm);
+  }
+  parallel_set_policy(policy);
+  parallel_set_threads(0);
+  vector_set_reproducible(false);
+  ASSERT_TRUE(fabs(vector_dot(v, w) - dot) < 1e-9 * fabs(dot));
+  ASSERT_EQ(vector_dot_reproducible(v, w), dot);
+  vector_free(v);
+  vector_free(w);
+}